@@ -0,0 +1,164 @@
+#include "arena.h"
+
+static inline size_t align_up(size_t size) {
+  return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static ArenaBlock *arena_block_new(size_t cap) {
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) + cap);
+  if (!block) {
+    return NULL;
+  }
+
+  block->next = NULL;
+  block->cap = cap;
+  block->used = 0;
+
+  return block;
+}
+
+Arena *arena_new(size_t block_size) {
+  Arena *arena = malloc(sizeof(Arena));
+  if (!arena) {
+    return NULL;
+  }
+
+  arena->head = NULL;
+  arena->block_size = block_size ? align_up(block_size) : ARENA_BLOCK_SIZE;
+  arena->reserved = 0;
+  arena->last = NULL;
+
+  return arena;
+}
+
+static void arena_release_blocks(Arena *arena) {
+  ArenaBlock *block = arena->head;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  arena->head = NULL;
+  arena->reserved = 0;
+  arena->last = NULL;
+}
+
+void arena_free(Arena *arena) {
+  if (!arena) {
+    return;
+  }
+
+  arena_release_blocks(arena);
+  free(arena);
+}
+
+void arena_reset(Arena *arena) {
+  if (!arena->head) {
+    return;
+  }
+
+  // a document that needed several blocks gets a single block big enough for
+  // all of them, so the next document of the same size does not malloc
+  if (arena->head->next) {
+    size_t reserved = arena->reserved;
+    arena_release_blocks(arena);
+
+    arena->head = arena_block_new(reserved);
+    if (arena->head) {
+      arena->reserved = reserved;
+    }
+    return;
+  }
+
+  arena->head->used = 0;
+  arena->last = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = align_up(size ? size : 1);
+
+  ArenaBlock *block = arena->head;
+  if (!block || block->cap - block->used < size) {
+    size_t cap = size > arena->block_size ? size : arena->block_size;
+    block = arena_block_new(cap);
+    if (!block) {
+      return NULL;
+    }
+
+    block->next = arena->head;
+    arena->head = block;
+    arena->reserved += cap;
+  }
+
+  void *ptr = block->data + block->used;
+  block->used += size;
+  arena->last = ptr;
+
+  return ptr;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+  if (!ptr) {
+    return arena_alloc(arena, new_size);
+  }
+
+  // the most recent allocation can grow without moving
+  ArenaBlock *block = arena->head;
+  if (ptr == arena->last) {
+    size_t start = (char *)ptr - block->data;
+    size_t size = align_up(new_size);
+    if (block->cap - start >= size) {
+      block->used = start + size;
+      return ptr;
+    }
+  }
+
+  if (new_size <= old_size) {
+    return ptr;
+  }
+
+  void *new_ptr = arena_alloc(arena, new_size);
+  if (new_ptr) {
+    memcpy(new_ptr, ptr, old_size);
+  }
+
+  return new_ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+  char *copy = arena_alloc(arena, len + 1);
+  if (!copy) {
+    return NULL;
+  }
+
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+void arena_adopt(Arena *arena, Arena *other) {
+  if (!other->head) {
+    return;
+  }
+
+  // the adopted blocks go behind the head, which keeps serving allocations
+  ArenaBlock *tail = other->head;
+  while (tail->next) {
+    tail = tail->next;
+  }
+
+  if (arena->head) {
+    tail->next = arena->head->next;
+    arena->head->next = other->head;
+  } else {
+    arena->head = other->head;
+    arena->last = NULL;
+  }
+
+  arena->reserved += other->reserved;
+  other->head = NULL;
+  other->reserved = 0;
+  other->last = NULL;
+}
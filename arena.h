@@ -0,0 +1,100 @@
+#include "pool.h"
+#include "stats.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t cap;
+  size_t used;
+  _Alignas(max_align_t) char data[];
+} ArenaBlock;
+
+/**
+ * Bump allocator. Every allocation is carved out of the current block and
+ * released all at once by `arena_reset' or `arena_free'.
+ */
+typedef struct {
+  ArenaBlock *head;
+  size_t block_size;
+  // total capacity of every block, used to coalesce them on reset
+  size_t reserved;
+  // start of the most recent allocation, so it can grow in place
+  void *last;
+} Arena;
+
+Arena *arena_new(size_t block_size);
+void arena_free(Arena *arena);
+void arena_reset(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+
+// moves every block of `other' into `arena', so what was allocated from
+// `other' is released with `arena'. `other' is left empty
+void arena_adopt(Arena *arena, Arena *other);
+
+// helpers used by the containers: fall back to the per-thread pools when no
+// arena is given, and never release arena memory individually. Memory from
+// either side must be released by `mem_free', not `free'
+static inline void *mem_alloc(Arena *arena, size_t size) {
+  JSON_STATS_ADD(allocs, 1);
+  JSON_STATS_ADD(alloc_bytes, size);
+  return arena ? arena_alloc(arena, size) : pool_alloc(size);
+}
+
+static inline void *mem_calloc(Arena *arena, size_t count, size_t size) {
+  JSON_STATS_ADD(allocs, 1);
+  JSON_STATS_ADD(alloc_bytes, count * size);
+  if (!arena) {
+    return pool_calloc(count, size);
+  }
+
+  void *ptr = arena_alloc(arena, count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+
+  return ptr;
+}
+
+static inline void *mem_realloc(Arena *arena, void *ptr, size_t old_size,
+                                size_t new_size) {
+  // only what the block grows by counts as new bytes
+  JSON_STATS_ADD(allocs, 1);
+  JSON_STATS_ADD(alloc_bytes, new_size > old_size ? new_size - old_size : 0);
+  return arena ? arena_realloc(arena, ptr, old_size, new_size)
+               : pool_realloc(ptr, new_size);
+}
+
+static inline void mem_free(Arena *arena, void *ptr) {
+  if (!arena && ptr) {
+    JSON_STATS_ADD(frees, 1);
+    pool_free(ptr);
+  }
+}
+
+static inline char *mem_strndup(Arena *arena, const char *str, size_t len) {
+  JSON_STATS_ADD(allocs, 1);
+  JSON_STATS_ADD(alloc_bytes, len + 1);
+  if (arena) {
+    return arena_strndup(arena, str, len);
+  }
+
+  char *copy = pool_alloc(len + 1);
+  if (copy) {
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+  }
+
+  return copy;
+}
+
+#endif
@@ -0,0 +1,557 @@
+#include "batch.h"
+#include "thread.h"
+#include <stdatomic.h>
+
+#ifndef BATCH_WINDOW
+#define BATCH_WINDOW (16 * 1024 * 1024)
+#endif
+// documents a worker claims at a time
+#define BATCH_GRAIN 16
+
+typedef struct {
+  // index entries of the document
+  uint32_t first;
+  uint32_t last;
+  // offset its last token ends before
+  uint32_t end;
+} BatchDoc;
+
+DEFINE_VECTOR(BatchDoc, doc, BatchDoc, NULL)
+
+// elements of an array parsed in one go by a worker
+typedef struct {
+  // index entries of the first element and of the comma or bracket after the
+  // last one
+  size_t first;
+  size_t last;
+  // slot of the first element in the result
+  size_t base;
+  size_t count;
+} ParallelRun;
+
+DEFINE_VECTOR(ParallelRun, run, ParallelRun, NULL)
+
+typedef struct {
+  const char *window;
+  const StructuralIndex *index;
+  const BatchDoc *docs;
+  size_t len;
+  JSON *results;
+  unsigned flags;
+  atomic_size_t next;
+} BatchWork;
+
+typedef struct {
+  BatchWork *work;
+  Arena *arena;
+  JSONStats stats;
+} BatchWorker;
+
+static void batch_parse(BatchWork *w, Arena *arena, size_t d) {
+  BatchDoc doc = w->docs[d];
+
+  // every document walks its own slice of the window's index
+  Parser p = {
+      .source = w->window,
+      .len = doc.end,
+      .index = {.positions = w->index->positions, .len = doc.last},
+      .index_pos = doc.first,
+      .keys = vector_tok_new_in(arena),
+      .vec_ctx = vector_json_new_in(arena),
+      .arena = arena,
+      .flags = w->flags,
+      .result = {.ok = true},
+  };
+
+  w->results[d] = json_parse_indexed(&p);
+}
+
+static void batch_worker(void *arg) {
+  BatchWorker *worker = arg;
+  BatchWork *w = worker->work;
+
+  for (;;) {
+    size_t d = atomic_fetch_add(&w->next, BATCH_GRAIN);
+    if (d >= w->len) {
+      JSON_STATS_TAKE(worker->stats);
+      return;
+    }
+
+    size_t end = d + BATCH_GRAIN < w->len ? d + BATCH_GRAIN : w->len;
+    for (; d < end; d++) {
+      batch_parse(w, worker->arena, d);
+    }
+  }
+}
+
+// splits the index of a window into top-level documents. Returns the offset
+// of the first incomplete document, or `len' when there is none. With
+// `final' an incomplete document is split off too, to fail when parsed.
+static size_t batch_split(const char *window, size_t len,
+                          const StructuralIndex *index,
+                          struct VectorBatchDoc *docs, bool final) {
+  size_t depth = 0;
+  size_t first = 0;
+  bool open = false;
+
+  docs->len = 0;
+  for (size_t k = 0; k < index->len; k++) {
+    char c = window[index->positions[k]];
+    if (!open) {
+      first = k;
+      open = true;
+    }
+
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && depth > 0) {
+      depth--;
+    }
+
+    if (depth == 0 && c != ',' && c != ':') {
+      uint32_t end = k + 1 < index->len ? index->positions[k + 1] : len;
+      vector_doc_push(docs, (BatchDoc){(uint32_t)first, (uint32_t)k + 1, end});
+      open = false;
+    }
+  }
+
+  if (open && final) {
+    vector_doc_push(docs, (BatchDoc){(uint32_t)first, (uint32_t)index->len,
+                                     (uint32_t)len});
+    open = false;
+  }
+
+  return open ? index->positions[first] : len;
+}
+
+static const char *last_newline(const char *start, size_t len) {
+  for (const char *c = start + len; c > start; c--) {
+    if (c[-1] == '\n') {
+      return c - 1;
+    }
+  }
+
+  return NULL;
+}
+
+// doubles a window too small for the document at `offset', which fails once
+// the window outgrows the 32-bit offsets of the index
+static size_t batch_grow(size_t window, size_t offset, JSONError *error) {
+  window *= 2;
+  if (window > UINT32_MAX) {
+    *error = (JSONError){JSON_ERROR_TOO_LARGE, offset};
+  }
+
+  return window;
+}
+
+size_t json_parse_many(const char *source, size_t len, size_t threads,
+                       unsigned flags, JSONBatchCallback callback, void *ctx) {
+  if (!threads) {
+    threads = thread_cpu_count();
+  }
+
+  JSON_STATS_BEGIN();
+  BatchWorker *workers = calloc(threads, sizeof(BatchWorker));
+  Thread *ids = calloc(threads, sizeof(Thread));
+  struct VectorBatchDoc *docs = vector_doc_new();
+  StructuralIndex index = {0};
+  JSON *results = NULL;
+  size_t results_cap = 0;
+  size_t count = 0;
+  // why the input could not be parsed to its end
+  JSONError error = {JSON_OK, 0};
+
+  bool ok = workers && ids && docs;
+  for (size_t i = 0; ok && i < threads; i++) {
+    workers[i].arena = arena_new(0);
+    ok = workers[i].arena != NULL;
+  }
+  if (!ok) {
+    error = (JSONError){JSON_ERROR_MEMORY, 0};
+  }
+
+  size_t window = BATCH_WINDOW;
+  size_t offset = 0;
+  while (error.code == JSON_OK && offset < len) {
+    size_t end = len - offset > window ? offset + window : len;
+
+    // valid JSON never has a raw newline inside a string, so a window cut
+    // after one is never cut inside a string either
+    if (end < len) {
+      const char *nl = last_newline(source + offset, end - offset);
+      if (!nl) {
+        window = batch_grow(window, offset, &error);
+        continue;
+      }
+      end = nl - source + 1;
+    }
+
+    const char *base = source + offset;
+    size_t wlen = end - offset;
+    bool final = end == len;
+
+    bool indexed = scanner_index(&index, base, wlen);
+    size_t rest = indexed ? batch_split(base, wlen, &index, docs, final) : 0;
+
+    // a string or the first document does not fit in the window, any other
+    // scanner error is in the input itself
+    bool cut = !indexed && index.error.code == JSON_ERROR_UNTERMINATED_STRING;
+    if (!final && (cut || (indexed && rest == 0 && docs->len == 0))) {
+      window = batch_grow(window, offset, &error);
+      continue;
+    }
+
+    // a bad string or byte only fails its own document, which is skipped up
+    // to the end of its line. The documents before it are parsed as usual:
+    // they end before the opening quote of the bad string, or else before
+    // the line with the bad byte
+    size_t skip = 0;
+    if (!indexed && index.error.code != JSON_ERROR_MEMORY) {
+      size_t bad = index.error.offset < wlen ? index.error.offset : wlen;
+      const char *next = memchr(base + bad, '\n', wlen - bad);
+      skip = next ? (size_t)(next - base) + 1 : wlen;
+
+      size_t good;
+      if (!scanner_index(&index, base, bad) &&
+          index.error.code == JSON_ERROR_UNTERMINATED_STRING) {
+        good = index.error.offset;
+      } else {
+        const char *nl = last_newline(base, bad);
+        good = nl ? (size_t)(nl - base) + 1 : 0;
+      }
+
+      indexed = scanner_index(&index, base, good);
+      rest = indexed ? batch_split(base, good, &index, docs, false) : 0;
+    }
+
+    if (!indexed) {
+      error = (JSONError){index.error.code, offset + index.error.offset};
+      break;
+    }
+
+    if (results_cap < docs->len) {
+      free(results);
+      results_cap = docs->len;
+      results = malloc(results_cap * sizeof(JSON));
+      if (!results) {
+        error = (JSONError){JSON_ERROR_MEMORY, offset};
+        break;
+      }
+    }
+
+    BatchWork work = {
+        .window = base,
+        .index = &index,
+        .docs = docs->items,
+        .len = docs->len,
+        .results = results,
+        .flags = flags,
+    };
+    atomic_init(&work.next, 0);
+
+    size_t n = (docs->len + BATCH_GRAIN - 1) / BATCH_GRAIN;
+    n = n < threads ? n : threads;
+    for (size_t i = 0; i < threads; i++) {
+      arena_reset(workers[i].arena);
+      workers[i].work = &work;
+    }
+
+    // the calling thread is always one of the workers
+    size_t started = 1;
+    for (; started < n; started++) {
+      if (!thread_start(&ids[started], batch_worker, &workers[started])) {
+        break;
+      }
+    }
+    batch_worker(&workers[0]);
+    for (size_t i = 1; i < started; i++) {
+      thread_join(ids[i]);
+    }
+    for (size_t i = 0; i < started; i++) {
+      JSON_STATS_MERGE(workers[i].stats);
+    }
+
+    for (size_t d = 0; d < docs->len; d++) {
+      callback(ctx, count++, results[d]);
+    }
+
+    if (skip) {
+      callback(ctx, count++, (JSON){.ok = false});
+      rest = skip;
+    }
+    offset += rest;
+  }
+
+  // the rest of the input is one last document that failed
+  if (error.code != JSON_OK) {
+    callback(ctx, count++, (JSON){.ok = false});
+  }
+  json_set_last_error(error);
+
+  for (size_t i = 0; workers && i < threads; i++) {
+    arena_free(workers[i].arena);
+  }
+  free(workers);
+  free(ids);
+  free(results);
+  vector_doc_free(docs);
+  scanner_index_free(&index);
+
+  JSON_STATS_ADD(documents, count);
+  JSON_STATS_END();
+  return count;
+}
+
+// runs a worker claims are about this many times smaller than its share
+#define PARALLEL_RUNS_PER_THREAD 8
+
+typedef struct {
+  const char *source;
+  const StructuralIndex *index;
+  const ParallelRun *runs;
+  size_t len;
+  JSON *items;
+  unsigned flags;
+  atomic_size_t next;
+  atomic_bool failed;
+} ParallelWork;
+
+typedef struct {
+  ParallelWork *work;
+  Arena *arena;
+  JSONStats stats;
+} ParallelWorker;
+
+// parses the elements of `run' into their slots
+static bool parallel_run(ParallelWork *w, Parser *p, const ParallelRun *run) {
+  const uint32_t *positions = w->index->positions;
+  JSON *item = w->items + run->base;
+  size_t first = run->first;
+  size_t depth = 0;
+
+  for (size_t k = first; k <= run->last; k++) {
+    if (k < run->last) {
+      char c = w->source[positions[k]];
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+      }
+      if (depth != 0 || c != ',') {
+        continue;
+      }
+    }
+
+    // one element per parse, an empty one is rejected by its validator
+    p->index = (StructuralIndex){.positions = w->index->positions, .len = k};
+    p->index_pos = first;
+    p->len = positions[k];
+    p->result = (JSON){.ok = true};
+
+    JSON value = json_parse_indexed(p);
+    if (!value.ok) {
+      return false;
+    }
+
+    *item++ = value;
+    first = k + 1;
+  }
+
+  return true;
+}
+
+static void parallel_worker(void *arg) {
+  ParallelWorker *worker = arg;
+  ParallelWork *w = worker->work;
+
+  Parser p = {
+      .source = w->source,
+      .keys = vector_tok_new_in(worker->arena),
+      .vec_ctx = vector_json_new_in(worker->arena),
+      .arena = worker->arena,
+      .flags = w->flags,
+      // the elements are nested in the array
+      .max_depth = JSON_MAX_DEPTH - 1,
+  };
+
+  bool ok = p.keys && p.vec_ctx;
+  while (ok && !atomic_load(&w->failed)) {
+    size_t r = atomic_fetch_add(&w->next, 1);
+    if (r >= w->len) {
+      break;
+    }
+
+    ok = parallel_run(w, &p, &w->runs[r]);
+  }
+
+  if (!ok) {
+    atomic_store(&w->failed, true);
+  }
+
+  while (p.vec_ctx && p.vec_ctx->len > 0) {
+    json_free(*vector_json_pop(p.vec_ctx));
+  }
+  vector_tok_free(p.keys);
+  vector_json_free(p.vec_ctx);
+  JSON_STATS_TAKE(worker->stats);
+}
+
+// splits the elements of the top-level array into runs of about `target'
+// index entries. False when the index is not one array, for `json_parse_n'
+// to tell why
+static bool parallel_split(const char *source, const StructuralIndex *index,
+                           size_t target, struct VectorParallelRun *runs) {
+  const uint32_t *positions = index->positions;
+  size_t n = index->len;
+  if (n < 2 || source[positions[0]] != '[' || source[positions[n - 1]] != ']') {
+    return false;
+  }
+
+  ParallelRun run = {.first = 1};
+  size_t depth = 1;
+  size_t k = 1;
+  for (; k < n; k++) {
+    char c = source[positions[k]];
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) {
+        break;
+      }
+    } else if (c == ',' && depth == 1) {
+      run.count++;
+      if (k - run.first >= target) {
+        run.last = k;
+        vector_run_push(runs, run);
+        run = (ParallelRun){.first = k + 1, .base = run.base + run.count};
+      }
+    }
+  }
+
+  // the closing bracket has to be the last entry
+  if (k != n - 1) {
+    return false;
+  }
+
+  run.last = k;
+  run.count++;
+  vector_run_push(runs, run);
+  return true;
+}
+
+JSON json_parse_parallel(const char *source, size_t len, Arena *arena,
+                         unsigned flags, size_t threads) {
+  if (!threads) {
+    threads = thread_cpu_count();
+  }
+
+  size_t start = 0;
+  while (start < len && (source[start] == ' ' || source[start] == '\t' ||
+                         source[start] == '\n' || source[start] == '\r')) {
+    start++;
+  }
+  if (threads < 2 || len < JSON_PARALLEL_MIN || start == len ||
+      source[start] != '[') {
+    return json_parse_n(source, len, arena, flags);
+  }
+
+  JSON_STATS_BEGIN();
+  StructuralIndex index = {0};
+  struct VectorParallelRun *runs = vector_run_new();
+  ParallelWorker *workers = calloc(threads, sizeof(ParallelWorker));
+  Thread *ids = calloc(threads, sizeof(Thread));
+  struct VectorJSON *vec = NULL;
+
+  bool ok = runs && workers && ids && scanner_index(&index, source, len);
+  if (ok) {
+    size_t target = index.len / (threads * PARALLEL_RUNS_PER_THREAD);
+    ok = parallel_split(source, &index, target, runs);
+  }
+
+  // the result is laid out up front, the workers fill in its slots
+  size_t count = 0;
+  if (ok) {
+    ParallelRun *last = &runs->items[runs->len - 1];
+    count = last->base + last->count;
+    vec = mem_alloc(arena, sizeof(struct VectorJSON));
+    JSON *items = mem_calloc(arena, count, sizeof(JSON));
+    if (vec && items) {
+      *vec = (struct VectorJSON){count, count, arena, items};
+    } else {
+      mem_free(arena, vec);
+      mem_free(arena, items);
+      vec = NULL;
+      ok = false;
+    }
+  }
+
+  // the calling thread works in `arena', the others in arenas of their own
+  for (size_t i = 0; ok && i < threads; i++) {
+    workers[i].arena = i > 0 && arena ? arena_new(0) : arena;
+    ok = !arena || workers[i].arena;
+  }
+
+  if (ok) {
+    ParallelWork work = {
+        .source = source,
+        .index = &index,
+        .runs = runs->items,
+        .len = runs->len,
+        .items = vec->items,
+        .flags = flags,
+    };
+    atomic_init(&work.next, 0);
+    atomic_init(&work.failed, false);
+
+    size_t n = runs->len < threads ? runs->len : threads;
+    size_t started = 1;
+    for (size_t i = 0; i < n; i++) {
+      workers[i].work = &work;
+    }
+    for (; started < n; started++) {
+      if (!thread_start(&ids[started], parallel_worker, &workers[started])) {
+        break;
+      }
+    }
+    parallel_worker(&workers[0]);
+    for (size_t i = 1; i < started; i++) {
+      thread_join(ids[i]);
+    }
+    for (size_t i = 0; i < started; i++) {
+      JSON_STATS_MERGE(workers[i].stats);
+    }
+
+    ok = !atomic_load(&work.failed);
+  }
+
+  for (size_t i = 1; workers && arena && i < threads; i++) {
+    if (workers[i].arena) {
+      arena_adopt(arena, workers[i].arena);
+      arena_free(workers[i].arena);
+    }
+  }
+  free(workers);
+  free(ids);
+  vector_run_free(runs);
+  scanner_index_free(&index);
+
+  if (!ok) {
+    // slots that were never filled are zeroed, which `json_free' skips
+    if (vec && !arena) {
+      vector_json_free(vec);
+    }
+    return json_parse_n(source, len, arena, flags);
+  }
+
+  json_set_last_error((JSONError){JSON_OK, 0});
+  // the workers only see the tokens of the elements, and count their depth
+  // from them
+  JSON_STATS_ADD(tokens[TOK_BRACKET_LEFT], 1);
+  JSON_STATS_ADD(tokens[TOK_BRACKET_RIGHT], 1);
+  JSON_STATS_ADD(tokens[TOK_COMMA], vec->len ? vec->len - 1 : 0);
+  JSON_STATS_ADD(max_depth, 1);
+  JSON_STATS_ADD(documents, 1);
+  JSON_STATS_END();
+  return (JSON){.ok = true, .type = ARRAY, .vec = vec};
+}
@@ -0,0 +1,51 @@
+#include "json.h"
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/**
+ * Receives the documents of a batch in input order. `index' counts documents
+ * from 0, an invalid document has `ok' unset. A bad string or byte fails the
+ * document it is in up to the end of its line, the documents around it are
+ * parsed as usual. The value lives in an arena that is reused once the
+ * callback returns.
+ */
+typedef void (*JSONBatchCallback)(void *ctx, size_t index, JSON value);
+
+/**
+ * Parses every document of the `len' bytes at `source', either newline
+ * delimited or simply concatenated. The input is indexed a window at a time,
+ * the documents of a window are parsed on `threads' workers with one arena
+ * each (0 uses every CPU) and then handed to `callback' in order. `flags' are
+ * `JSONFlags'. Returns the number of documents.
+ *
+ * A document that does not fit in 4GB of window, or an allocation that
+ * fails, stops the batch: the rest of the input is handed to `callback' as
+ * one last failed document and `json_last_error' tells why. It is `JSON_OK'
+ * when the whole input was parsed, whatever the documents held.
+ */
+size_t json_parse_many(const char *source, size_t len, size_t threads,
+                       unsigned flags, JSONBatchCallback callback, void *ctx);
+
+// documents smaller than this are parsed on the calling thread alone
+#ifndef JSON_PARALLEL_MIN
+#define JSON_PARALLEL_MIN (1024 * 1024)
+#endif
+
+/**
+ * Same as `json_parse_n' for a document that is one large array, with its
+ * elements parsed on `threads' workers (0 uses every CPU). The structural
+ * index is built once, then split into runs of whole elements at the commas
+ * of the array, which is exact since strings never appear in the index. Each
+ * worker parses its runs straight into their slots of the result, into an
+ * arena of its own that `arena' adopts at the end. Without an arena the
+ * result is released with `json_free' as usual.
+ *
+ * Any other document, or one below `JSON_PARALLEL_MIN' bytes, is parsed by
+ * `json_parse_n'. So is a document one of the workers rejects, which gives
+ * the same result and `json_last_error' in every case.
+ */
+JSON json_parse_parallel(const char *source, size_t len, Arena *arena,
+                         unsigned flags, size_t threads);
+
+#endif
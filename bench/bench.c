@@ -0,0 +1,443 @@
+// Parse, serialize, lookup and free throughput over the generated corpus or
+// the JSON files given on the command line. Built and run by `make bench'.
+//
+//   bench [--scale N] [--perf] [--save FILE] [--compare FILE]
+//         [--tolerance PCT] [FILE...]
+//
+// `--save' writes the results as a baseline and `--compare' checks them
+// against one, failing when any throughput dropped by more than the
+// tolerance, 5% by default.
+#include "../stringify.h"
+#include "../validate.h"
+#include "corpus.h"
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// each measurement runs for at least this long, the best of `BENCH_RUNS' is
+// kept
+#define BENCH_MIN_TIME 0.1
+#define BENCH_RUNS 5
+
+#define BENCH_MAX_DOCS 64
+
+// malloc, calloc and realloc calls, counted when the Makefile links with
+// `--wrap'
+static size_t allocations;
+
+#ifdef BENCH_WRAP
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  allocations++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  allocations++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  allocations++;
+  return __real_realloc(ptr, size);
+}
+#endif
+
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifdef __linux__
+static const struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+} COUNTERS[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+#define COUNTERS_LEN (sizeof(COUNTERS) / sizeof(*COUNTERS))
+#else
+#define COUNTERS_LEN 0
+#endif
+
+typedef struct {
+  int fds[COUNTERS_LEN + 1];
+  bool ok;
+} Counters;
+
+// counters that are never started unless `enable' is set
+static Counters counters_open(bool enable) {
+  Counters c = {.ok = false};
+  for (size_t i = 0; i < COUNTERS_LEN + 1; i++) {
+    c.fds[i] = -1;
+  }
+  if (!enable) {
+    return c;
+  }
+
+#ifdef __linux__
+  c.ok = true;
+  for (size_t i = 0; i < COUNTERS_LEN; i++) {
+    struct perf_event_attr attr = {
+        .type = COUNTERS[i].type,
+        .size = sizeof(attr),
+        .config = COUNTERS[i].config,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    c.fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    c.ok = c.ok && c.fds[i] >= 0;
+  }
+#endif
+  return c;
+}
+
+static void counters_start(Counters *c) {
+#ifdef __linux__
+  for (size_t i = 0; c->ok && i < COUNTERS_LEN; i++) {
+    ioctl(c->fds[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+// prints every counter per byte of input
+static void counters_stop(Counters *c, size_t bytes) {
+#ifdef __linux__
+  for (size_t i = 0; c->ok && i < COUNTERS_LEN; i++) {
+    uint64_t value = 0;
+    ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(c->fds[i], &value, sizeof(value)) == sizeof(value)) {
+      printf("  %-14s %10.3f/byte\n", COUNTERS[i].name, (double)value / bytes);
+    }
+  }
+#else
+  (void)c;
+  (void)bytes;
+#endif
+}
+
+static void counters_close(Counters *c) {
+#ifdef __linux__
+  for (size_t i = 0; i < COUNTERS_LEN; i++) {
+    if (c->fds[i] >= 0) {
+      close(c->fds[i]);
+    }
+  }
+#else
+  (void)c;
+#endif
+}
+
+typedef enum {
+  OP_PARSE,
+  OP_SERIALIZE,
+  OP_LOOKUP,
+  OP_VALIDATE,
+  // parsed without an arena and released with `json_free'
+  OP_RECYCLE,
+  OP_FREE,
+  OP_LEN
+} Op;
+
+// a reset arena frees a document in constant time, which is too short to
+// compare against a baseline
+#define OP_COMPARED OP_FREE
+
+static const char *OP_NAMES[OP_LEN] = {"parse",    "serialize", "lookup",
+                                       "validate", "recycle",   "free"};
+
+typedef struct {
+  const Document *doc;
+  // reused like on a connection that parses one document after another
+  JSONParser *parser;
+  Arena *arena;
+  JSON json;
+  JSONBuffer out;
+  size_t lookups;
+  JSONError error;
+} Run;
+
+static size_t lookup_all(JSON json) {
+  size_t found = 0;
+  if (json.type == OBJECT) {
+    for (size_t i = 0; i < json.map->cap; i++) {
+      BucketJSON *b = &json.map->values[i];
+      if (b->key) {
+        found += hashmap_json_find_n(json.map, b->key, b->key_len) != NULL;
+        found += lookup_all(b->value);
+      }
+    }
+  } else if (json.type == ARRAY) {
+    for (size_t i = 0; i < json.vec->len; i++) {
+      found += lookup_all(json.vec->items[i]);
+    }
+  }
+
+  return found;
+}
+
+// one iteration of `op', the document stays parsed between them
+static void run_op(Run *r, Op op) {
+  switch (op) {
+  case OP_PARSE:
+    arena_reset(r->arena);
+    r->json =
+        json_parser_parse(r->parser, r->doc->data, r->doc->len, r->arena, 0);
+    break;
+  case OP_SERIALIZE:
+    r->out.len = 0;
+    json_stringify(&r->out, r->json, 0);
+    break;
+  case OP_LOOKUP:
+    r->lookups = lookup_all(r->json);
+    break;
+  case OP_VALIDATE:
+    r->error = json_validate(r->doc->data, r->doc->len);
+    break;
+  case OP_RECYCLE:
+    json_free(
+        json_parser_parse(r->parser, r->doc->data, r->doc->len, NULL, 0));
+    break;
+  case OP_FREE:
+    arena_reset(r->arena);
+    break;
+  case OP_LEN:
+    break;
+  }
+}
+
+// seconds per iteration of `op', the best of `BENCH_RUNS'
+static double measure(Run *r, Op op) {
+  double best = 0;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    size_t iterations = 0;
+    double elapsed = 0, begin = now();
+    // wall time, since what is timed may be a small part of an iteration
+    while (now() - begin < BENCH_MIN_TIME) {
+      // an arena document is freed by resetting the arena, so there has to
+      // be a new one each time
+      if (op == OP_FREE) {
+        run_op(r, OP_PARSE);
+      }
+
+      double start = now();
+      run_op(r, op);
+      elapsed += now() - start;
+      iterations++;
+    }
+
+    double per = elapsed / iterations;
+    best = run == 0 || per < best ? per : best;
+  }
+
+  // leave the document parsed for the next operation
+  run_op(r, OP_PARSE);
+  return best;
+}
+
+typedef struct {
+  char name[64];
+  double mbps[OP_LEN];
+} Result;
+
+static bool save(const char *path, const Result *results, size_t len) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    for (int op = 0; op < OP_COMPARED; op++) {
+      fprintf(f, "%s %s %.3f\n", results[i].name, OP_NAMES[op],
+              results[i].mbps[op]);
+    }
+  }
+
+  return fclose(f) == 0;
+}
+
+// prints every change against the baseline, false when one is a regression
+// beyond `tolerance' percent
+static bool compare(const char *path, const Result *results, size_t len,
+                    double tolerance) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "[ERROR]: Could not read baseline %s\n", path);
+    return false;
+  }
+
+  bool ok = true;
+  char name[64], op_name[16];
+  double baseline;
+  printf("\n%-14s %-10s %10s %10s %8s\n", "document", "op", "baseline",
+         "MB/s", "change");
+  while (fscanf(f, "%63s %15s %lf", name, op_name, &baseline) == 3) {
+    for (size_t i = 0; i < len; i++) {
+      for (int op = 0; op < OP_COMPARED; op++) {
+        if (strcmp(results[i].name, name) != 0 ||
+            strcmp(OP_NAMES[op], op_name) != 0) {
+          continue;
+        }
+
+        double change = (results[i].mbps[op] / baseline - 1) * 100;
+        bool regressed = change < -tolerance;
+        ok = ok && !regressed;
+        printf("%-14s %-10s %10.1f %10.1f %+7.1f%%%s\n", name, op_name,
+               baseline, results[i].mbps[op], change,
+               regressed ? "  REGRESSION" : "");
+      }
+    }
+  }
+
+  fclose(f);
+  return ok;
+}
+
+static size_t peak_rss_kb(void) {
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return (size_t)usage.ru_maxrss;
+  }
+#endif
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned scale = 1;
+  bool perf = false;
+  const char *save_path = NULL, *compare_path = NULL;
+  double tolerance = 5;
+
+  Document docs[BENCH_MAX_DOCS];
+  size_t len = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+      scale = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--perf") == 0) {
+      perf = true;
+    } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+      compare_path = argv[++i];
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else if (len < BENCH_MAX_DOCS && corpus_load(&docs[len], argv[i])) {
+      len++;
+    } else {
+      fprintf(stderr, "[ERROR]: Could not read %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (len == 0) {
+    len = corpus_generate(docs, scale);
+  }
+
+  Counters counters = counters_open(perf);
+  if (perf && !counters.ok) {
+    fprintf(stderr, "[WARN]: Performance counters are unavailable\n");
+  }
+
+  Result results[BENCH_MAX_DOCS];
+  printf("%-14s %9s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+         "document", "size", "parse", "docs/s", "allocs", "serialize", "lookup",
+         "validate", "recycle", "allocs", "free");
+  printf("%-14s %9s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "", "KB",
+         "MB/s", "", "/parse", "MB/s", "Mkeys/s", "MB/s", "MB/s", "/recycle",
+         "us");
+
+  bool ok = true;
+  for (size_t i = 0; i < len; i++) {
+    Run r = {.doc = &docs[i],
+             .parser = json_parser_new(0),
+             .arena = arena_new(0),
+             .out = json_buffer_new(0)};
+    Result *result = &results[i];
+    snprintf(result->name, sizeof(result->name), "%s", docs[i].name);
+
+    // counted once the parser and arena have settled on the document: the
+    // arena merges its blocks on the first reset after they spilled over
+    run_op(&r, OP_PARSE);
+    run_op(&r, OP_PARSE);
+    size_t before = allocations;
+    run_op(&r, OP_PARSE);
+    size_t parse_allocs = allocations - before;
+    // the pools fill up on the first document freed
+    run_op(&r, OP_RECYCLE);
+    before = allocations;
+    run_op(&r, OP_RECYCLE);
+    size_t recycle_allocs = allocations - before;
+    if (!r.json.ok) {
+      fprintf(stderr, "[ERROR]: Could not parse %s\n", docs[i].name);
+      ok = false;
+    }
+
+    double seconds[OP_LEN];
+    for (int op = 0; op < OP_LEN; op++) {
+      seconds[op] = measure(&r, op);
+      result->mbps[op] = docs[i].len / seconds[op] / 1e6;
+    }
+    run_op(&r, OP_LOOKUP);
+
+    if (r.error.code != JSON_OK) {
+      fprintf(stderr, "[ERROR]: %s does not validate: %s at offset %zu\n",
+              docs[i].name, json_error_string(r.error.code), r.error.offset);
+      ok = false;
+    }
+
+    printf("%-14s %9zu %10.1f %10.0f %10zu %10.1f %10.1f %10.1f %10.1f %10zu "
+           "%10.1f\n",
+           docs[i].name, docs[i].len / 1024, result->mbps[OP_PARSE],
+           1 / seconds[OP_PARSE], parse_allocs, result->mbps[OP_SERIALIZE],
+           r.lookups / seconds[OP_LOOKUP] / 1e6, result->mbps[OP_VALIDATE],
+           result->mbps[OP_RECYCLE], recycle_allocs, seconds[OP_FREE] * 1e6);
+
+    if (counters.ok) {
+      counters_start(&counters);
+      run_op(&r, OP_PARSE);
+      counters_stop(&counters, docs[i].len);
+    }
+
+    json_buffer_free(&r.out);
+    arena_free(r.arena);
+    json_parser_free(r.parser);
+  }
+
+  printf("\npeak RSS %zu KB\n", peak_rss_kb());
+#ifndef BENCH_WRAP
+  printf("allocation counts need the Makefile's --wrap link flags\n");
+#endif
+
+  if (save_path && !save(save_path, results, len)) {
+    fprintf(stderr, "[ERROR]: Could not write baseline %s\n", save_path);
+    ok = false;
+  }
+  if (compare_path && !compare(compare_path, results, len, tolerance)) {
+    ok = false;
+  }
+
+  counters_close(&counters);
+  corpus_free(docs, len);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// Decoding fixed-schema messages into structs: through the `JSON' tree and
+// hashmap lookups, and straight from the index with `json_parser_bind'.
+// Built and run by `make bench'.
+#include "bind.h"
+#include <stdio.h>
+#include <time.h>
+
+#define MESSAGES 256
+#define ROUNDS 200
+
+typedef struct {
+  double lat, lon;
+} Location;
+
+DEFINE_SCHEMA(Location, location, JSON_FIELD(Location, lat, JSON_BIND_DOUBLE),
+              JSON_FIELD(Location, lon, JSON_BIND_DOUBLE))
+
+typedef struct {
+  int64_t id;
+  uint64_t user;
+  StringView symbol;
+  StringView side;
+  double price;
+  int64_t quantity;
+  bool urgent;
+  Location origin;
+} Order;
+
+DEFINE_SCHEMA(Order, order, JSON_FIELD(Order, id, JSON_BIND_INT64),
+              JSON_FIELD(Order, user, JSON_BIND_UINT64),
+              JSON_FIELD(Order, symbol, JSON_BIND_STRING),
+              JSON_FIELD(Order, side, JSON_BIND_STRING),
+              JSON_FIELD(Order, price, JSON_BIND_DOUBLE),
+              JSON_FIELD(Order, quantity, JSON_BIND_INT64),
+              JSON_FIELD(Order, urgent, JSON_BIND_BOOL),
+              JSON_FIELD_OBJECT(Order, origin, location))
+
+static char messages[MESSAGES][512];
+static size_t lens[MESSAGES];
+
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// a few fields the schema does not know about, like real messages have
+static void make_messages(void) {
+  static const char *SYMBOLS[] = {"ACME", "INITECH", "UMBRELLA", "HOOLI"};
+  for (int i = 0; i < MESSAGES; i++) {
+    lens[i] = (size_t)snprintf(
+        messages[i], sizeof(messages[i]),
+        "{\"id\": %d, \"user\": %u, \"symbol\": \"%s\", \"side\": \"%s\", "
+        "\"price\": %d.%02d, \"quantity\": %d, \"urgent\": %s, "
+        "\"origin\": {\"lat\": 52.%d, \"lon\": 13.%d}, "
+        "\"client\": {\"version\": \"4.2.%d\", \"features\": [1, 2, 3]}, "
+        "\"note\": \"no rush\\nthanks\", \"tags\": [\"retail\", \"eu\"]}",
+        i * 7919, 100000u + i, SYMBOLS[i % 4], i % 2 ? "buy" : "sell",
+        i % 500, i % 100, 1 + i % 1000, i % 7 ? "false" : "true", i, i * 3,
+        i % 10);
+  }
+}
+
+static double number_of(JSON json) {
+  switch (json.type) {
+  case INTEGER:
+    return (double)json.i;
+  case UNSIGNED:
+    return (double)json.u;
+  case NUMBER:
+    return json.d;
+  default:
+    return 0;
+  }
+}
+
+static StringView string_of(JSON json) {
+  return json.type == STRING ? (StringView){json.str, json.len}
+                             : (StringView){0};
+}
+
+// the usual way: build the tree, then copy every field out of it
+static bool decode_dom(JSONParser *parser, Arena *arena, size_t i,
+                       Order *order) {
+  JSON json =
+      json_parser_parse(parser, messages[i], lens[i], arena, JSON_ZERO_COPY);
+  if (!json.ok || json.type != OBJECT) {
+    return false;
+  }
+
+  struct HashMapJSON *map = json.map;
+  order->id = hashmap_json_get(map, "id").i;
+  order->user = (uint64_t)hashmap_json_get(map, "user").i;
+  order->symbol = string_of(hashmap_json_get(map, "symbol"));
+  order->side = string_of(hashmap_json_get(map, "side"));
+  order->price = number_of(hashmap_json_get(map, "price"));
+  order->quantity = hashmap_json_get(map, "quantity").i;
+  order->urgent = hashmap_json_get(map, "urgent").b;
+  JSON origin = hashmap_json_get(map, "origin");
+  if (origin.type == OBJECT) {
+    order->origin.lat = number_of(hashmap_json_get(origin.map, "lat"));
+    order->origin.lon = number_of(hashmap_json_get(origin.map, "lon"));
+  }
+  return true;
+}
+
+static bool decode_bind(JSONParser *parser, Arena *arena, size_t i,
+                        Order *order) {
+  return json_parser_bind(parser, &order_schema, order, messages[i], lens[i],
+                          arena)
+             .code == JSON_OK;
+}
+
+typedef bool (*DecodeFn)(JSONParser *parser, Arena *arena, size_t i,
+                         Order *order);
+
+// nanoseconds per message, the best of three runs
+static double bench_decode(DecodeFn decode, int64_t *checksum) {
+  JSONParser *parser = json_parser_new(0);
+  Arena *arena = arena_new(0);
+  double best = 0;
+  for (int run = 0; run < 3; run++) {
+    *checksum = 0;
+    double start = now();
+    for (size_t r = 0; r < ROUNDS; r++) {
+      for (size_t i = 0; i < MESSAGES; i++) {
+        Order order = {0};
+        arena_reset(arena);
+        if (!decode(parser, arena, i, &order)) {
+          printf("message %zu failed\n", i);
+        }
+        *checksum += order.id + order.quantity + (int64_t)order.symbol.len +
+                     order.urgent + (int64_t)order.origin.lon;
+      }
+    }
+    double ns = (now() - start) * 1e9 / ((double)ROUNDS * MESSAGES);
+    best = run == 0 || ns < best ? ns : best;
+  }
+
+  arena_free(arena);
+  json_parser_free(parser);
+  return best;
+}
+
+int main(void) {
+  make_messages();
+
+  int64_t dom_sum, bind_sum;
+  double dom = bench_decode(decode_dom, &dom_sum);
+  double bind = bench_decode(decode_bind, &bind_sum);
+
+  printf("%-22s %10s %10s\n", "decode", "ns/msg", "speedup");
+  printf("%-22s %10.1f %10s\n", "parse + hashmap_get", dom, "1.00x");
+  printf("%-22s %10.1f %9.2fx\n", "json_parser_bind", bind, dom / bind);
+  if (dom_sum != bind_sum) {
+    printf("decoders disagree\n");
+    return 1;
+  }
+
+  return 0;
+}
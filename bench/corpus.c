@@ -0,0 +1,247 @@
+#include "../stringify.h"
+#include "corpus.h"
+#include <stdarg.h>
+
+static uint64_t rng;
+
+static uint64_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static unsigned pick(unsigned n) { return (unsigned)(next_random() % n); }
+
+static void emit(JSONBuffer *buf, const char *fmt, ...) {
+  char text[1024];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+
+  // every format here expands to far less than the buffer
+  if (len > 0 && (size_t)len < sizeof(text)) {
+    json_buffer_write(buf, text, len);
+  }
+}
+
+// already escaped for a JSON string
+static const char *WORDS[] = {
+    "the",    "parser", "json",   "\\u3042\\u308a", "caf\xc3\xa9",
+    "stream", "fast",   "record", "line\\nbreak",  "\\\"quoted\\\"",
+    "https:\\/\\/t.co\\/x",   "\xe6\x97\xa5\xe6\x9c\xac",
+};
+
+// `words' random words joined by spaces, some with escapes or raw UTF-8
+static void emit_text(JSONBuffer *buf, unsigned words) {
+  json_buffer_write(buf, "\"", 1);
+  for (unsigned i = 0; i < words; i++) {
+    emit(buf, i ? " %s" : "%s", WORDS[pick(sizeof(WORDS) / sizeof(*WORDS))]);
+  }
+  json_buffer_write(buf, "\"", 1);
+}
+
+static void gen_user(JSONBuffer *buf, unsigned i) {
+  emit(buf,
+       "{\"id\":%u,\"id_str\":\"%u\",\"name\":\"user %u\","
+       "\"screen_name\":\"user_%u\",\"location\":\"\",\"description\":",
+       1000000 + i, 1000000 + i, i, i);
+  emit_text(buf, 4 + pick(12));
+  emit(buf,
+       ",\"url\":\"http:\\/\\/example.com\\/%u\",\"protected\":false,"
+       "\"followers_count\":%u,\"friends_count\":%u,\"listed_count\":%u,"
+       "\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\","
+       "\"favourites_count\":%u,\"utc_offset\":32400,"
+       "\"time_zone\":\"Tokyo\",\"verified\":%s,\"statuses_count\":%u,"
+       "\"lang\":\"ja\",\"profile_background_color\":\"C0DEED\","
+       "\"profile_image_url\":\"http:\\/\\/pbs.twimg.com\\/profile_images\\/"
+       "%u\\/normal.jpeg\"}",
+       i, pick(100000), pick(5000), pick(100), pick(20000),
+       pick(8) ? "false" : "true", pick(100000), pick(1u << 30));
+}
+
+static void gen_tweet(JSONBuffer *buf, unsigned i) {
+  emit(buf,
+       "{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":"
+       "\"ja\"},\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\","
+       "\"id\":%llu,\"id_str\":\"%llu\",\"text\":",
+       505874924095815681ull + i, 505874924095815681ull + i);
+  emit_text(buf, 8 + pick(16));
+  emit(buf, ",\"source\":\"<a href=\\\"https:\\/\\/twitter.com\\\" "
+            "rel=\\\"nofollow\\\">Twitter<\\/a>\",\"truncated\":false,"
+            "\"in_reply_to_status_id\":null,\"geo\":null,\"user\":");
+  gen_user(buf, i % 64);
+  emit(buf,
+       ",\"retweet_count\":%u,\"favorite_count\":%u,\"entities\":{"
+       "\"hashtags\":[],\"symbols\":[],\"urls\":[],\"user_mentions\":[",
+       pick(1000), pick(1000));
+  for (unsigned m = pick(3), j = 0; j < m; j++) {
+    emit(buf,
+         "%s{\"screen_name\":\"user_%u\",\"name\":\"user %u\",\"id\":%u,"
+         "\"id_str\":\"%u\",\"indices\":[%u,%u]}",
+         j ? "," : "", j, j, 1000000 + j, 1000000 + j, j * 10, j * 10 + 8);
+  }
+  emit(buf, "]},\"favorited\":false,\"retweeted\":false,\"lang\":\"ja\"}");
+}
+
+static void gen_twitter(JSONBuffer *buf, unsigned scale) {
+  emit(buf, "{\"statuses\":[");
+  for (unsigned i = 0; i < 200 * scale; i++) {
+    if (i) {
+      json_buffer_write(buf, ",", 1);
+    }
+    gen_tweet(buf, i);
+  }
+  emit(buf, "],\"search_metadata\":{\"completed_in\":0.087,\"max_id\":"
+            "505874924095815681,\"query\":\"%%E4%%B8%%80\",\"count\":100,"
+            "\"since_id\":0}}");
+}
+
+static void gen_citm(JSONBuffer *buf, unsigned scale) {
+  unsigned areas = 16, events = 180 * scale, performances = 240 * scale;
+
+  emit(buf, "{\"areaNames\":{");
+  for (unsigned i = 0; i < areas; i++) {
+    emit(buf, "%s\"%u\":\"Arri\\u00e8re-sc\\u00e8ne %u\"", i ? "," : "",
+         205705993 + i, i);
+  }
+
+  emit(buf, "},\"events\":{");
+  for (unsigned i = 0; i < events; i++) {
+    emit(buf,
+         "%s\"%u\":{\"description\":null,\"id\":%u,\"logo\":null,"
+         "\"name\":\"Event %u\",\"subTopicIds\":[337184269,337184283],"
+         "\"subjectCode\":\"\",\"subtitle\":null,\"topicIds\":[%u,%u]}",
+         i ? "," : "", 138586341 + i, 138586341 + i, i, 324846099 + pick(8),
+         107888604 + pick(8));
+  }
+
+  emit(buf, "},\"performances\":[");
+  for (unsigned i = 0; i < performances; i++) {
+    emit(buf,
+         "%s{\"eventId\":%u,\"id\":%u,\"logo\":\"\",\"name\":\"\","
+         "\"prices\":[",
+         i ? "," : "", 138586341 + pick(events), 339887544 + i);
+    for (unsigned p = 0, n = 1 + pick(4); p < n; p++) {
+      emit(buf,
+           "%s{\"amount\":%u,\"audienceSubCategoryId\":337100890,"
+           "\"seatCategoryId\":%u}",
+           p ? "," : "", 9000 + pick(90000), 338937295 + p);
+    }
+    emit(buf, "],\"seatCategories\":[");
+    for (unsigned s = 0, n = 1 + pick(4); s < n; s++) {
+      emit(buf, "%s{\"areas\":[", s ? "," : "");
+      for (unsigned a = 0, m = 1 + pick(6); a < m; a++) {
+        emit(buf, "%s{\"areaId\":%u,\"blockIds\":[]}", a ? "," : "",
+             205705993 + pick(areas));
+      }
+      emit(buf, "],\"seatCategoryId\":%u}", 338937295 + s);
+    }
+    emit(buf,
+         "],\"seatMapImage\":\"\",\"start\":%llu,"
+         "\"venueCode\":\"PLEYEL_PLEYEL\"}",
+         1372701600000ull + pick(100000000));
+  }
+  emit(buf, "],\"venueNames\":{\"PLEYEL_PLEYEL\":\"Salle Pleyel\"}}");
+}
+
+static void gen_canada(JSONBuffer *buf, unsigned scale) {
+  emit(buf, "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":"
+            "\"Feature\",\"properties\":{\"name\":\"Canada\"},\"geometry\":{"
+            "\"type\":\"Polygon\",\"coordinates\":[");
+  for (unsigned ring = 0; ring < 40 * scale; ring++) {
+    emit(buf, "%s[", ring ? "," : "");
+    for (unsigned i = 0; i < 1400; i++) {
+      double lon = -141.0 + pick(8000000) / 100000.0 + pick(1000000) * 1e-12;
+      double lat = 41.0 + pick(4000000) / 100000.0 + pick(1000000) * 1e-12;
+      emit(buf, "%s[%.15f,%.15f]", i ? "," : "", lon, lat);
+    }
+    emit(buf, "]");
+  }
+  emit(buf, "]}}]}");
+}
+
+// many small documents nested hundreds of levels deep
+static void gen_deep(JSONBuffer *buf, unsigned scale) {
+  emit(buf, "[");
+  for (unsigned n = 0; n < 200 * scale; n++) {
+    emit(buf, n ? "," : "");
+    for (unsigned d = 0; d < 256; d++) {
+      emit(buf, d % 2 ? "[%u," : "{\"level\":%u,\"next\":", d);
+    }
+    emit(buf, "\"bottom\"");
+    for (unsigned d = 256; d-- > 0;) {
+      emit(buf, d % 2 ? "]" : "}");
+    }
+  }
+  emit(buf, "]");
+}
+
+// one object with a hundred thousand members
+static void gen_wide(JSONBuffer *buf, unsigned scale) {
+  emit(buf, "{");
+  for (unsigned i = 0; i < 100000 * scale; i++) {
+    emit(buf, "%s\"member_%08x\":%u", i ? "," : "", i * 2654435761u,
+         pick(1000000));
+  }
+  emit(buf, "}");
+}
+
+static const struct {
+  const char *name;
+  void (*generate)(JSONBuffer *buf, unsigned scale);
+} GENERATORS[CORPUS_MAX] = {
+    {"twitter", gen_twitter}, {"citm_catalog", gen_citm},
+    {"canada", gen_canada},   {"deep", gen_deep},
+    {"wide", gen_wide},
+};
+
+size_t corpus_generate(Document docs[CORPUS_MAX], unsigned scale) {
+  size_t len = 0;
+  for (size_t i = 0; i < CORPUS_MAX; i++) {
+    rng = 0x9E3779B97F4A7C15ull + i;
+
+    JSONBuffer buf = json_buffer_new(1 << 20);
+    GENERATORS[i].generate(&buf, scale ? scale : 1);
+    if (!buf.ok) {
+      json_buffer_free(&buf);
+      continue;
+    }
+
+    docs[len++] = (Document){GENERATORS[i].name, buf.data, buf.len};
+  }
+
+  return len;
+}
+
+bool corpus_load(Document *doc, const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+
+  char *data = NULL;
+  long len = -1;
+  if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0 &&
+      fseek(f, 0, SEEK_SET) == 0) {
+    data = malloc(len + 1);
+  }
+
+  if (!data || fread(data, 1, len, f) != (size_t)len) {
+    free(data);
+    fclose(f);
+    return false;
+  }
+
+  fclose(f);
+  const char *name = strrchr(path, '/');
+  *doc = (Document){name ? name + 1 : path, data, (size_t)len};
+  return true;
+}
+
+void corpus_free(Document *docs, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    free(docs[i].data);
+  }
+}
@@ -0,0 +1,29 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+typedef struct {
+  const char *name;
+  char *data;
+  size_t len;
+} Document;
+
+#define CORPUS_MAX 5
+
+/**
+ * Fills `docs' with documents shaped like the usual parser corpus:
+ * twitter.json-style API responses, citm_catalog-style integer-keyed
+ * records, canada.json-style coordinate arrays, and generated deep and wide
+ * documents. They are the same on every run. `scale' multiplies their size.
+ * Returns how many there are.
+ */
+size_t corpus_generate(Document docs[CORPUS_MAX], unsigned scale);
+
+// reads a whole file as a document, false when it cannot be read
+bool corpus_load(Document *doc, const char *path);
+
+void corpus_free(Document *docs, size_t len);
+
+#endif
@@ -0,0 +1,125 @@
+// Hash function benchmark over key length distributions seen in JSON
+// documents. Built and run by `make bench'.
+#include "hash.h"
+#include "hashmap.h"
+#include <time.h>
+
+#define KEYS 4096
+#define ROUNDS 2000
+
+DEFINE_HASHMAP(Int, int, int, NULL)
+
+typedef struct {
+  const char *name;
+  size_t min, max;
+} Distribution;
+
+static const Distribution DISTRIBUTIONS[] = {
+    // `id', `text', `user', `created_at'
+    {"field names (2-12)", 2, 12},
+    // camelCase and snake_case names, uuids
+    {"identifiers (12-40)", 12, 40},
+    // urls and other long values used as keys
+    {"long keys (40-160)", 40, 160},
+};
+
+static const struct {
+  const char *name;
+  JSONHashKind kind;
+} HASHES[] = {
+    {"murmur3", JSON_HASH_MURMUR},
+    {"wyhash", JSON_HASH_WY},
+    {"crc32c", JSON_HASH_CRC32C},
+};
+
+static char keys[KEYS][160];
+static size_t lens[KEYS];
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+static uint64_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void make_keys(const Distribution *d) {
+  static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+  for (size_t i = 0; i < KEYS; i++) {
+    lens[i] = d->min + next_random() % (d->max - d->min + 1);
+    for (size_t j = 0; j < lens[i]; j++) {
+      keys[i][j] = ALPHABET[next_random() % (sizeof(ALPHABET) - 1)];
+    }
+  }
+}
+
+// nanoseconds per hash
+static double bench_hash(JSONHashFn fn) {
+  uint64_t sink = 0;
+  double start = now();
+  for (size_t r = 0; r < ROUNDS; r++) {
+    for (size_t i = 0; i < KEYS; i++) {
+      sink += fn(keys[i], lens[i], json_hasher.seed);
+    }
+  }
+  double elapsed = now() - start;
+
+  // keep the loop from being optimized away
+  if (sink == 42) {
+    printf(" ");
+  }
+  return elapsed * 1e9 / ((double)ROUNDS * KEYS);
+}
+
+// nanoseconds per lookup in a map holding every key
+static double bench_lookup(void) {
+  struct HashMapInt *map = hashmap_int_new();
+  for (size_t i = 0; i < KEYS; i++) {
+    hashmap_int_set_n(map, keys[i], lens[i], (int)i);
+  }
+
+  size_t found = 0;
+  double start = now();
+  for (size_t r = 0; r < ROUNDS / 4; r++) {
+    for (size_t i = 0; i < KEYS; i++) {
+      found += hashmap_int_find_n(map, keys[i], lens[i]) != NULL;
+    }
+  }
+  double elapsed = now() - start;
+
+  hashmap_int_free(map);
+  if (found != (size_t)ROUNDS / 4 * KEYS) {
+    printf("lookup lost keys\n");
+  }
+  return elapsed * 1e9 / ((double)ROUNDS / 4 * KEYS);
+}
+
+int main(void) {
+  printf("%-22s %-8s %10s %10s\n", "keys", "hash", "ns/hash", "ns/lookup");
+
+  for (size_t d = 0; d < sizeof(DISTRIBUTIONS) / sizeof(*DISTRIBUTIONS);
+       d++) {
+    make_keys(&DISTRIBUTIONS[d]);
+
+    for (size_t h = 0; h < sizeof(HASHES) / sizeof(*HASHES); h++) {
+      // no map is alive between runs, so switching is safe
+      if (!json_hash_select(HASHES[h].kind)) {
+        printf("%-22s %-8s %10s\n", DISTRIBUTIONS[d].name, HASHES[h].name,
+               "unsupported");
+        continue;
+      }
+
+      double ns = bench_hash(json_hasher.fn);
+      printf("%-22s %-8s %10.2f %10.2f\n", DISTRIBUTIONS[d].name,
+             HASHES[h].name, ns, bench_lookup());
+    }
+  }
+
+  return 0;
+}
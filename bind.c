@@ -0,0 +1,486 @@
+#include "bind.h"
+#include "hash.h"
+#include "validate.h"
+
+// tries per table size before a larger table is tried
+#define SCHEMA_SEED_TRIES 256
+
+// the length and the first and last 8 bytes of `key', which tell most field
+// names apart for a fraction of the cost of hashing them
+static inline uint64_t key_signature(const char *key, size_t len) {
+  uint64_t head = 0, tail = 0;
+  if (len >= 8) {
+    memcpy(&head, key, 8);
+    memcpy(&tail, key + len - 8, 8);
+  } else {
+    for (size_t i = 0; i < len; i++) {
+      head |= (uint64_t)(uint8_t)key[i] << 8 * i;
+    }
+  }
+
+  return (head ^ (tail << 7 | tail >> 57)) + len;
+}
+
+static inline size_t schema_slot(JSONSchemaLookup lookup, const char *key,
+                                 size_t len, uint64_t seed, size_t mask) {
+  if (lookup == JSON_SCHEMA_SIGNATURE) {
+    // folded first, the multiply only carries differences upwards
+    uint64_t x = key_signature(key, len) ^ seed * 0xD6E8FEB86659FD93ull;
+    x ^= x >> 32;
+    return (x * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+  }
+
+  return json_hash_wy(key, len, seed) & mask;
+}
+
+static bool schema_seed_fits(const JSONSchema *s, JSONSchemaLookup lookup,
+                             uint8_t *used, size_t cap, uint64_t seed) {
+  memset(used, 0, cap);
+  for (size_t i = 0; i < s->len; i++) {
+    const JSONField *f = &s->fields[i];
+    size_t slot = schema_slot(lookup, f->name, f->name_len, seed, cap - 1);
+    if (used[slot]) {
+      return false;
+    }
+    used[slot] = 1;
+  }
+
+  return true;
+}
+
+// finds a seed that gives every field name a slot of its own, through the
+// signature if possible. Only the thread that claims the schema builds the
+// table, the lookup it publishes is returned to every caller
+static JSONSchemaLookup schema_prepare(JSONSchema *s) {
+  JSONSchemaLookup claimed = JSON_SCHEMA_UNPREPARED;
+  if (!atomic_compare_exchange_strong(&s->lookup, &claimed,
+                                      JSON_SCHEMA_PREPARING)) {
+    return claimed;
+  }
+
+  uint8_t used[JSON_SCHEMA_SLOTS(UINT8_MAX)];
+  size_t min_cap = 2;
+  while (min_cap < 2 * s->len) {
+    min_cap *= 2;
+  }
+
+  for (JSONSchemaLookup lookup = JSON_SCHEMA_SIGNATURE;
+       lookup <= JSON_SCHEMA_HASH; lookup++) {
+    for (size_t cap = min_cap; cap <= s->slots_cap; cap *= 2) {
+      for (uint64_t seed = 1; seed <= SCHEMA_SEED_TRIES; seed++) {
+        if (!schema_seed_fits(s, lookup, used, cap, seed)) {
+          continue;
+        }
+
+        for (size_t i = 0; i < s->len; i++) {
+          const JSONField *f = &s->fields[i];
+          s->slots[schema_slot(lookup, f->name, f->name_len, seed, cap - 1)] =
+              (uint8_t)(i + 1);
+        }
+        s->seed = seed;
+        s->mask = cap - 1;
+        atomic_store_explicit(&s->lookup, lookup, memory_order_release);
+        return lookup;
+      }
+    }
+  }
+
+  atomic_store_explicit(&s->lookup, JSON_SCHEMA_LINEAR, memory_order_release);
+  return JSON_SCHEMA_LINEAR;
+}
+
+static const JSONField *schema_find(JSONSchema *s, const char *key,
+                                    size_t len) {
+  JSONSchemaLookup lookup =
+      atomic_load_explicit(&s->lookup, memory_order_acquire);
+  if (lookup == JSON_SCHEMA_UNPREPARED) {
+    lookup = schema_prepare(s);
+  }
+
+  if (lookup == JSON_SCHEMA_LINEAR || lookup == JSON_SCHEMA_PREPARING) {
+    for (size_t i = 0; i < s->len; i++) {
+      const JSONField *f = &s->fields[i];
+      if (f->name_len == len && !memcmp(f->name, key, len)) {
+        return f;
+      }
+    }
+    return NULL;
+  }
+
+  uint8_t slot = s->slots[schema_slot(lookup, key, len, s->seed, s->mask)];
+  if (!slot) {
+    return NULL;
+  }
+
+  const JSONField *f = &s->fields[slot - 1];
+  return f->name_len == len && !memcmp(f->name, key, len) ? f : NULL;
+}
+
+// first byte of the current entry, NUL past the last one
+static inline char bind_char(const Parser *p) {
+  return p->index_pos < p->index.len
+             ? p->source[p->index.positions[p->index_pos]]
+             : '\0';
+}
+
+static bool bind_fail(Parser *p, JSONErrorCode code, size_t pos) {
+  p->error = (JSONError){code, p->index.positions[pos]};
+  return false;
+}
+
+// the current entry is not what the grammar allows
+static bool bind_unexpected(Parser *p) {
+  if (p->index_pos >= p->index.len) {
+    p->error = (JSONError){JSON_ERROR_EOF, p->len};
+    return false;
+  }
+
+  return bind_fail(p, JSON_ERROR_UNEXPECTED, p->index_pos);
+}
+
+// the string at the current entry, which the scanner already checked ends
+// with a quote before the next entry
+static inline Token bind_string_token(Parser *p) {
+  size_t pos = p->index_pos++;
+  size_t open = p->index.positions[pos];
+  size_t end = pos + 1 < p->index.len ? p->index.positions[pos + 1] : p->len;
+  char c;
+  while ((c = p->source[end - 1]) == ' ' || c == '\n' || c == '\r' ||
+         c == '\t') {
+    end--;
+  }
+
+  const char *str = p->source + open + 1;
+  size_t len = end - open - 2;
+  return (Token){.type = TOK_STRING,
+                 .str = str,
+                 .len = len,
+                 .escaped = memchr(str, '\\', len) != NULL};
+}
+
+// index entry after the value at `pos' if its brackets match, the end of the
+// index if they do not
+static size_t bind_value_end(const Parser *p, size_t pos) {
+  size_t depth = 0;
+  for (; pos < p->index.len; pos++) {
+    char c = p->source[p->index.positions[pos]];
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && depth > 0) {
+      depth--;
+    }
+    if (depth == 0) {
+      return pos + 1;
+    }
+  }
+
+  return pos;
+}
+
+// moves past the value at the current entry, `depth' containers deep,
+// through the validator since nothing in it is bound
+static bool bind_skip(Parser *p, size_t depth) {
+  size_t start = p->index_pos;
+  size_t end = bind_value_end(p, start);
+
+  Validator v;
+  validate_begin(&v, p->source, p->len, true);
+  v.max_depth = parser_max_depth(p) - depth;
+  if (!validate_index(&v, p->index.positions, start, end)) {
+    p->error = v.error;
+    return false;
+  }
+  if (v.state != VALIDATE_END) {
+    p->error = (JSONError){JSON_ERROR_EOF, p->len};
+    return false;
+  }
+
+  p->index_pos = end;
+  return true;
+}
+
+static size_t bind_size(JSONBindType type, const JSONSchema *schema) {
+  switch (type) {
+  case JSON_BIND_BOOL:
+    return sizeof(bool);
+  case JSON_BIND_INT64:
+    return sizeof(int64_t);
+  case JSON_BIND_UINT64:
+    return sizeof(uint64_t);
+  case JSON_BIND_DOUBLE:
+    return sizeof(double);
+  case JSON_BIND_STRING:
+    return sizeof(StringView);
+  case JSON_BIND_OBJECT:
+    return schema->size;
+  case JSON_BIND_ARRAY:
+    return sizeof(JSONBindArray);
+  }
+
+  return 0;
+}
+
+static bool bind_value(Parser *p, JSONBindType type, JSONBindType item_type,
+                       JSONSchema *schema, void *dst, size_t depth);
+
+// the grammar of what is bound is checked on the way, anything skipped goes
+// through `bind_skip'
+static bool bind_object(Parser *p, JSONSchema *schema, void *dst,
+                        size_t depth) {
+  if (depth == parser_max_depth(p)) {
+    return bind_fail(p, JSON_ERROR_DEPTH, p->index_pos);
+  }
+
+  // past `{'
+  p->index_pos++;
+  if (bind_char(p) == '}') {
+    p->index_pos++;
+    return true;
+  }
+
+  for (;;) {
+    if (bind_char(p) != '"') {
+      return bind_unexpected(p);
+    }
+
+    Token key = bind_string_token(p);
+    const JSONField *f;
+    if (!key.escaped) {
+      f = schema_find(schema, key.str, key.len);
+    } else {
+      char small[256];
+      char *buf = key.len <= sizeof(small) ? small : mem_alloc(NULL, key.len);
+      if (!buf) {
+        return bind_fail(p, JSON_ERROR_MEMORY, p->index_pos - 1);
+      }
+      f = schema_find(schema, buf, json_unescape(buf, key.str, key.len));
+      if (buf != small) {
+        mem_free(NULL, buf);
+      }
+    }
+
+    if (bind_char(p) != ':') {
+      return bind_unexpected(p);
+    }
+    p->index_pos++;
+
+    if (!(f ? bind_value(p, f->type, f->item_type, f->schema,
+                         (char *)dst + f->offset, depth + 1)
+            : bind_skip(p, depth + 1))) {
+      return false;
+    }
+
+    char c = bind_char(p);
+    if (c != ',' && c != '}') {
+      return bind_unexpected(p);
+    }
+    p->index_pos++;
+    if (c == '}') {
+      return true;
+    }
+  }
+}
+
+static bool bind_array(Parser *p, JSONBindType type, JSONSchema *schema,
+                       JSONBindArray *dst, size_t depth) {
+  size_t start = p->index_pos;
+  if (depth == parser_max_depth(p)) {
+    return bind_fail(p, JSON_ERROR_DEPTH, start);
+  }
+
+  // counted first so the elements take a single allocation. Counting stops
+  // at anything that is not a separator, binding then fails there
+  size_t len = 0;
+  p->index_pos++;
+  if (bind_char(p) != ']') {
+    for (size_t pos = p->index_pos; pos < p->index.len;) {
+      len++;
+      pos = bind_value_end(p, pos);
+      if (pos >= p->index.len || p->source[p->index.positions[pos]] != ',') {
+        break;
+      }
+      pos++;
+    }
+  }
+
+  if (len == 0) {
+    if (bind_char(p) != ']') {
+      return bind_unexpected(p);
+    }
+    p->index_pos++;
+    *dst = (JSONBindArray){NULL, 0};
+    return true;
+  }
+
+  // arrays of arrays have no layout
+  if (type == JSON_BIND_ARRAY) {
+    return bind_fail(p, JSON_ERROR_TYPE, start);
+  }
+
+  size_t size = bind_size(type, schema);
+  char *items = p->arena ? mem_calloc(p->arena, len, size) : NULL;
+  if (!items) {
+    return bind_fail(p, JSON_ERROR_MEMORY, start);
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    if (!bind_value(p, type, 0, schema, items + i * size, depth + 1)) {
+      return false;
+    }
+    if (bind_char(p) != (i + 1 < len ? ',' : ']')) {
+      return bind_unexpected(p);
+    }
+    p->index_pos++;
+  }
+
+  *dst = (JSONBindArray){items, len};
+  return true;
+}
+
+static bool bind_string(Parser *p, Token t, StringView *dst) {
+  if (!t.escaped) {
+    *dst = (StringView){t.str, t.len};
+    return true;
+  }
+
+  char *str = p->arena ? mem_alloc(p->arena, t.len + 1) : NULL;
+  if (!str) {
+    return bind_fail(p, JSON_ERROR_MEMORY, p->index_pos - 1);
+  }
+
+  size_t len = json_unescape(str, t.str, t.len);
+  str[len] = '\0';
+  *dst = (StringView){str, len};
+  return true;
+}
+
+// a container of the wrong type still has to be well formed
+static bool bind_mismatch(Parser *p, size_t depth) {
+  size_t pos = p->index_pos;
+  return bind_skip(p, depth) && bind_fail(p, JSON_ERROR_TYPE, pos);
+}
+
+static bool bind_value(Parser *p, JSONBindType type, JSONBindType item_type,
+                       JSONSchema *schema, void *dst, size_t depth) {
+  size_t pos = p->index_pos;
+  if (pos >= p->index.len) {
+    return bind_unexpected(p);
+  }
+
+  switch (bind_char(p)) {
+  case '{':
+    if (type != JSON_BIND_OBJECT) {
+      return bind_mismatch(p, depth);
+    }
+    return bind_object(p, schema, dst, depth);
+  case '[':
+    if (type != JSON_BIND_ARRAY) {
+      return bind_mismatch(p, depth);
+    }
+    return bind_array(p, item_type, schema, dst, depth);
+  case '"':
+    if (type != JSON_BIND_STRING) {
+      return bind_fail(p, JSON_ERROR_TYPE, pos);
+    }
+    return bind_string(p, bind_string_token(p), dst);
+  case '}':
+  case ']':
+  case ':':
+  case ',':
+    return bind_unexpected(p);
+  default:
+    break;
+  }
+
+  Token t = scan_token(p);
+  switch (t.type) {
+  case TOK_NONE:
+    return bind_fail(p, JSON_ERROR_SCALAR, pos);
+  case TOK_NULL:
+    return true;
+  default:
+    break;
+  }
+
+  switch (type) {
+  case JSON_BIND_BOOL:
+    if (t.type == TOK_BOOLEAN) {
+      *(bool *)dst = t.b;
+      return true;
+    }
+    break;
+  case JSON_BIND_INT64:
+    if (t.type == TOK_INTEGER) {
+      *(int64_t *)dst = t.i;
+      return true;
+    }
+    break;
+  case JSON_BIND_UINT64:
+    if (t.type == TOK_UNSIGNED || (t.type == TOK_INTEGER && t.i >= 0)) {
+      *(uint64_t *)dst = t.type == TOK_UNSIGNED ? t.u : (uint64_t)t.i;
+      return true;
+    }
+    break;
+  case JSON_BIND_DOUBLE:
+    if (t.type == TOK_NUMBER || t.type == TOK_INTEGER ||
+        t.type == TOK_UNSIGNED) {
+      *(double *)dst = t.type == TOK_NUMBER    ? t.d
+                       : t.type == TOK_INTEGER ? (double)t.i
+                                               : (double)t.u;
+      return true;
+    }
+    break;
+  case JSON_BIND_STRING:
+  case JSON_BIND_OBJECT:
+  case JSON_BIND_ARRAY:
+    break;
+  }
+
+  return bind_fail(p, JSON_ERROR_TYPE, pos);
+}
+
+// indexes and binds the source `p' is set up for. There is no separate
+// validation pass: what is bound is checked while binding it
+static JSONError bind_document(Parser *p, JSONSchema *schema, void *out) {
+  if (!scanner_index(&p->index, p->source, p->len)) {
+    return p->index.error;
+  }
+
+  p->error = (JSONError){JSON_OK, 0};
+  if (bind_value(p, JSON_BIND_OBJECT, 0, schema, out, 0) &&
+      p->index_pos < p->index.len) {
+    bind_fail(p, JSON_ERROR_TRAILING, p->index_pos);
+  }
+
+  return p->error;
+}
+
+JSONError json_bind(JSONSchema *schema, void *out, const char *source,
+                    size_t len, Arena *arena) {
+  Parser p = {
+      .source = source,
+      .len = len,
+      .index = {.arena = arena},
+      .arena = arena,
+  };
+
+  JSONError error = bind_document(&p, schema, out);
+  scanner_index_free(&p.index);
+  return error;
+}
+
+JSONError json_parser_bind(JSONParser *parser, JSONSchema *schema, void *out,
+                           const char *source, size_t len, Arena *arena) {
+  Parser p = {
+      .source = source,
+      .len = len,
+      .index = parser->index,
+      .arena = arena,
+      .max_depth = parser->max_depth,
+  };
+
+  parser->error = bind_document(&p, schema, out);
+  // the index may have grown
+  parser->index = p.index;
+  return parser->error;
+}
@@ -0,0 +1,149 @@
+#include "json.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+#ifndef BIND_H
+#define BIND_H
+
+typedef enum {
+  // `bool'
+  JSON_BIND_BOOL,
+  // `int64_t', integers only
+  JSON_BIND_INT64,
+  // `uint64_t', non-negative integers only
+  JSON_BIND_UINT64,
+  // `double', any number
+  JSON_BIND_DOUBLE,
+  // `StringView'
+  JSON_BIND_STRING,
+  // a struct described by another schema
+  JSON_BIND_OBJECT,
+  // `JSONBindArray' of any of the above but arrays
+  JSON_BIND_ARRAY,
+} JSONBindType;
+
+typedef struct {
+  void *items;
+  size_t len;
+} JSONBindArray;
+
+typedef struct JSONSchema JSONSchema;
+
+// how a schema finds the field of a name
+typedef enum {
+  // the perfect hash is built on first use
+  JSON_SCHEMA_UNPREPARED,
+  // being built by another thread, names are compared one by one meanwhile
+  JSON_SCHEMA_PREPARING,
+  // perfect hash of the length and the first and last 8 bytes
+  JSON_SCHEMA_SIGNATURE,
+  // names only differ in the middle, perfect hash of all of their bytes
+  JSON_SCHEMA_HASH,
+  // no seed was found, names are compared one by one
+  JSON_SCHEMA_LINEAR,
+} JSONSchemaLookup;
+
+typedef struct {
+  const char *name;
+  size_t name_len;
+  size_t offset;
+  JSONBindType type;
+  // elements of an array
+  JSONBindType item_type;
+  // objects and arrays of objects
+  JSONSchema *schema;
+} JSONField;
+
+/**
+ * Layout of a C struct as a JSON object: which member each field name is
+ * decoded into. Field names are looked up through a perfect hash that is
+ * built on first use, see `DEFINE_SCHEMA'. The table is published through
+ * `lookup' with release and acquire, so a schema can be shared by threads
+ * from the start.
+ */
+struct JSONSchema {
+  const JSONField *fields;
+  size_t len;
+  // of the struct, to lay out arrays of it
+  size_t size;
+  // field index + 1 by the hash of its name, 0 for none
+  uint8_t *slots;
+  size_t slots_cap;
+  size_t mask;
+  uint64_t seed;
+  // set last, once the slots, the mask and the seed are
+  _Atomic(JSONSchemaLookup) lookup;
+};
+
+// slots a schema of `n' fields may need
+#define JSON_SCHEMA_SLOTS(n) (8 * (n))
+
+// the field named `key' is decoded into `member' of `Struct'
+#define JSON_FIELD_EX(Struct, member, key, type, item_type, schema)            \
+  {key, sizeof(key) - 1, offsetof(Struct, member), type, item_type, schema}
+
+#define JSON_FIELD_AS(Struct, member, key, type)                               \
+  JSON_FIELD_EX(Struct, member, key, type, 0, NULL)
+
+#define JSON_FIELD(Struct, member, type)                                       \
+  JSON_FIELD_AS(Struct, member, #member, type)
+
+// `member' is a struct of the schema defined as `name'
+#define JSON_FIELD_OBJECT(Struct, member, name)                                \
+  JSON_FIELD_EX(Struct, member, #member, JSON_BIND_OBJECT, 0, &name##_schema)
+
+#define JSON_FIELD_ARRAY(Struct, member, item_type)                            \
+  JSON_FIELD_EX(Struct, member, #member, JSON_BIND_ARRAY, item_type, NULL)
+
+// `member' is a `JSONBindArray' of structs of the schema defined as `name'
+#define JSON_FIELD_ARRAY_OF(Struct, member, name)                              \
+  JSON_FIELD_EX(Struct, member, #member, JSON_BIND_ARRAY, JSON_BIND_OBJECT,    \
+                &name##_schema)
+
+/**
+ * Defines `name_schema' for struct `Name' out of its `JSONField's, and
+ * `json_bind_name' to decode a document straight into one:
+ *
+ *   DEFINE_SCHEMA(Point, point, JSON_FIELD(Point, x, JSON_BIND_DOUBLE),
+ *                 JSON_FIELD(Point, y, JSON_BIND_DOUBLE))
+ *
+ * Nested schemas have to be defined before the ones that use them.
+ */
+#define DEFINE_SCHEMA(Name, name, ...)                                         \
+  static const JSONField name##_fields[] = {__VA_ARGS__};                      \
+  _Static_assert(sizeof(name##_fields) / sizeof(JSONField) <= UINT8_MAX,       \
+                 "too many fields");                                           \
+  static uint8_t name##_slots[JSON_SCHEMA_SLOTS(sizeof(name##_fields) /        \
+                                                sizeof(JSONField))];           \
+  static JSONSchema name##_schema = {                                          \
+      .fields = name##_fields,                                                 \
+      .len = sizeof(name##_fields) / sizeof(JSONField),                        \
+      .size = sizeof(Name),                                                    \
+      .slots = name##_slots,                                                   \
+      .slots_cap = sizeof(name##_slots),                                       \
+  };                                                                           \
+                                                                               \
+  static inline JSONError json_bind_##name(Name *out, const char *source,      \
+                                           size_t len, Arena *arena) {         \
+    return json_bind(&name##_schema, out, source, len, arena);                 \
+  }
+
+/**
+ * Decodes the object in the `len' bytes at `source' into `out', a struct laid
+ * out as `schema' says, without building a `JSON' tree. Unknown fields are
+ * skipped without allocating. Fields that are missing or `null' keep the
+ * value `out' had, so defaults can be set beforehand, and the last of
+ * duplicate fields wins. Strings point into `source' unless they have escape
+ * sequences, which are decoded into `arena' like array elements are. Without
+ * an arena those fail with `JSON_ERROR_MEMORY'. The whole document is
+ * validated, a value of the wrong type fails with `JSON_ERROR_TYPE'.
+ */
+JSONError json_bind(JSONSchema *schema, void *out, const char *source,
+                    size_t len, Arena *arena);
+
+// same as `json_bind', reusing the index of `parser' and honoring its depth
+// limit. Sets `parser->error'
+JSONError json_parser_bind(JSONParser *parser, JSONSchema *schema, void *out,
+                           const char *source, size_t len, Arena *arena);
+
+#endif
@@ -1,2 +1,3 @@
 @echo off
-mkdir build 2> NUL & gcc -Wall -pedantic json.c murmurhash.c -o .\build\json.exe
+mkdir build 2> NUL & gcc -Wall -pedantic json.c arena.c scanner.c tape.c stream.c batch.c file.c number.c stringify.c lazy.c query.c intern.c hash.c murmurhash.c validate.c pool.c bind.c snapshot.c stats.c frozen.c patch.c -lpthread -o .\build\json.exe
+gcc -Wall -pedantic -DJSON_NO_MAIN -I. tools\snapshot.c json.c arena.c scanner.c tape.c stream.c batch.c file.c number.c stringify.c lazy.c query.c intern.c hash.c murmurhash.c validate.c pool.c bind.c snapshot.c stats.c frozen.c patch.c -lpthread -o .\build\json_snapshot.exe
@@ -0,0 +1,53 @@
+#include <stddef.h>
+
+#ifndef ERROR_H
+#define ERROR_H
+
+typedef enum {
+  JSON_OK,
+  // the input ended inside a value, or there was no value at all
+  JSON_ERROR_EOF,
+  // a byte sequence that is not UTF-8
+  JSON_ERROR_UTF8,
+  // an unescaped control character inside a string
+  JSON_ERROR_CONTROL,
+  // a backslash not followed by one of `"\/bfnrt' or by `u' and four hex
+  // digits
+  JSON_ERROR_ESCAPE,
+  JSON_ERROR_UNTERMINATED_STRING,
+  // a bare word that is not a number or `true', `false' or `null'
+  JSON_ERROR_SCALAR,
+  // a token where the grammar does not allow it
+  JSON_ERROR_UNEXPECTED,
+  // anything after the end of the root value
+  JSON_ERROR_TRAILING,
+  // containers nested deeper than the parser allows, at most `JSON_MAX_DEPTH'
+  JSON_ERROR_DEPTH,
+  // inputs of 4GB and more are not indexed, nor tapes of 4G words and more
+  JSON_ERROR_TOO_LARGE,
+  JSON_ERROR_MEMORY,
+  // a value of another type than the schema it is bound to expects
+  JSON_ERROR_TYPE,
+  // a patch operation that is malformed or cannot apply to the document
+  JSON_ERROR_PATCH,
+  // a patch path to a member or element that is not there
+  JSON_ERROR_PATH,
+  // a JSON Patch `test' operation that did not match
+  JSON_ERROR_TEST,
+  // a file that cannot be opened, read or mapped
+  JSON_ERROR_IO,
+} JSONErrorCode;
+
+/**
+ * Why a document was rejected, and the offset of the first byte that was
+ * not accepted.
+ */
+typedef struct {
+  JSONErrorCode code;
+  size_t offset;
+} JSONError;
+
+// short English description of `code'
+const char *json_error_string(JSONErrorCode code);
+
+#endif
@@ -0,0 +1,139 @@
+#include "file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+JSONErrorCode json_map_file(JSONMap *map, const char *path, bool sequential) {
+#ifdef _WIN32
+  DWORD hint = sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+  HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, hint, NULL);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return JSON_ERROR_IO;
+  }
+
+  LARGE_INTEGER size;
+  JSONErrorCode code = JSON_OK;
+  if (!GetFileSizeEx(handle, &size)) {
+    code = JSON_ERROR_IO;
+  } else if (size.QuadPart == 0) {
+    code = JSON_ERROR_EOF;
+  } else if ((unsigned long long)size.QuadPart > SIZE_MAX) {
+    code = JSON_ERROR_TOO_LARGE;
+  }
+  if (code != JSON_OK) {
+    CloseHandle(handle);
+    return code;
+  }
+
+  HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(handle);
+  if (!mapping) {
+    return JSON_ERROR_IO;
+  }
+
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    code = GetLastError() == ERROR_NOT_ENOUGH_MEMORY ? JSON_ERROR_MEMORY
+                                                      : JSON_ERROR_IO;
+    CloseHandle(mapping);
+    return code;
+  }
+
+  map->handle = mapping;
+  size_t len = (size_t)size.QuadPart;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return JSON_ERROR_IO;
+  }
+
+  // an empty file cannot be mapped, and is no valid document either
+  struct stat st;
+  JSONErrorCode code = JSON_OK;
+  if (fstat(fd, &st) != 0) {
+    code = JSON_ERROR_IO;
+  } else if (st.st_size == 0) {
+    code = JSON_ERROR_EOF;
+  } else if ((unsigned long long)st.st_size > SIZE_MAX) {
+    code = JSON_ERROR_TOO_LARGE;
+  }
+  if (code != JSON_OK) {
+    close(fd);
+    return code;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  code = errno == ENOMEM ? JSON_ERROR_MEMORY : JSON_ERROR_IO;
+  close(fd);
+  if (data == MAP_FAILED) {
+    return code;
+  }
+
+  madvise(data, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  size_t len = (size_t)st.st_size;
+#endif
+
+  map->data = data;
+  map->len = len;
+  return JSON_OK;
+}
+
+void json_unmap_file(JSONMap *map) {
+  if (map->data) {
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->handle);
+#else
+    munmap((void *)map->data, map->len);
+#endif
+  }
+
+  *map = (JSONMap){0};
+}
+
+JSONFile json_parse_file(const char *path) {
+  JSONFile file = {0};
+
+  // the scanner reads the file front to back exactly once
+  JSONMap map;
+  JSONErrorCode code = json_map_file(&map, path, true);
+  if (code != JSON_OK) {
+    json_set_last_error((JSONError){code, 0});
+    return file;
+  }
+
+  file.data = map.data;
+  file.len = map.len;
+#ifdef _WIN32
+  file.mapping = map.handle;
+#endif
+
+  file.arena = arena_new(0);
+  if (!file.arena) {
+    json_file_close(&file);
+    json_set_last_error((JSONError){JSON_ERROR_MEMORY, 0});
+    return (JSONFile){0};
+  }
+
+  file.json = json_parse_n(file.data, file.len, file.arena, JSON_ZERO_COPY);
+  return file;
+}
+
+void json_file_close(JSONFile *file) {
+  JSONMap map = {.data = file->data, .len = file->len};
+#ifdef _WIN32
+  map.handle = file->mapping;
+#endif
+  json_unmap_file(&map);
+
+  arena_free(file->arena);
+  *file = (JSONFile){0};
+}
@@ -0,0 +1,52 @@
+#include "json.h"
+
+#ifndef FILE_H
+#define FILE_H
+
+// read-only mapping of a whole file
+typedef struct {
+  const char *data;
+  size_t len;
+#ifdef _WIN32
+  void *handle;
+#endif
+} JSONMap;
+
+/**
+ * Maps the file at `path'. Returns `JSON_OK', or why it failed:
+ * `JSON_ERROR_IO' when the file cannot be opened or mapped, `JSON_ERROR_EOF'
+ * when it is empty, `JSON_ERROR_TOO_LARGE' when it does not fit the address
+ * space and `JSON_ERROR_MEMORY' when the system is out of memory for the
+ * mapping. `sequential' tells the system the pages will be read front to
+ * back once, leave it unset for random lookups.
+ */
+JSONErrorCode json_map_file(JSONMap *map, const char *path, bool sequential);
+void json_unmap_file(JSONMap *map);
+
+/**
+ * A document parsed straight out of a read-only mapping of its file. Strings
+ * without escapes are views into the mapping and everything else lives in
+ * `arena', so both stay alive until `json_file_close'.
+ */
+typedef struct {
+  // `ok' is unset when the file cannot be mapped or is not valid JSON,
+  // `json_last_error' tells which, with the code of `json_map_file' when it
+  // could not be mapped
+  JSON json;
+  Arena *arena;
+  const char *data;
+  size_t len;
+#ifdef _WIN32
+  void *mapping;
+#endif
+} JSONFile;
+
+/**
+ * Maps the file at `path' and parses it in place. The mapping is never
+ * copied and needs no NUL terminator, so pages come straight from the page
+ * cache and are shared with any other process reading the same file.
+ */
+JSONFile json_parse_file(const char *path);
+void json_file_close(JSONFile *file);
+
+#endif
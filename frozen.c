@@ -0,0 +1,479 @@
+#include "frozen.h"
+#include "intern.h"
+#include <stdlib.h>
+
+// members per displacement, on average
+#define FROZEN_BUCKET_SIZE 4
+// a displacement with this bit set is the slot of the only key of its bucket
+#define FROZEN_DIRECT 0x80000000u
+// displacements tried for a bucket before the object is hashed again
+#define FROZEN_MAX_DISPLACEMENT (1u << 20)
+#define FROZEN_MAX_SEEDS 16
+#define FROZEN_SEED_STEP 0x9E3779B97F4A7C15ull
+
+typedef struct {
+  const char *key;
+  uint32_t key_len;
+  // low half of the key's hash
+  uint32_t hash;
+  JSONFrozenNode value;
+} FrozenMember;
+
+// the members in slot order, followed by a displacement per bucket
+struct FrozenObject {
+  uint64_t seed;
+  FrozenMember members[];
+};
+
+struct JSONFrozen {
+  size_t size;
+  JSONFrozenNode root;
+};
+
+static inline size_t frozen_align(size_t len) { return (len + 7) & ~(size_t)7; }
+
+static inline size_t frozen_buckets(size_t n) {
+  return (n + FROZEN_BUCKET_SIZE - 1) / FROZEN_BUCKET_SIZE;
+}
+
+static inline size_t frozen_object_size(size_t n) {
+  return frozen_align(sizeof(struct FrozenObject) + n * sizeof(FrozenMember) +
+                      frozen_buckets(n) * sizeof(uint32_t));
+}
+
+// `x' scaled to [0, n)
+static inline uint32_t frozen_range(uint32_t x, size_t n) {
+  return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline uint32_t frozen_bucket(uint64_t h, size_t n) {
+  return frozen_range((uint32_t)(h >> 32), frozen_buckets(n));
+}
+
+// slot of the key hashed to `h' in a bucket with displacement `d'
+static inline uint32_t frozen_slot(uint64_t h, uint32_t d, size_t n) {
+  if (d & FROZEN_DIRECT) {
+    return d & ~FROZEN_DIRECT;
+  }
+
+  uint32_t x = (uint32_t)h ^ (d * 0x9E3779B9u);
+  x ^= x >> 16;
+  x *= 0x85EBCA6Bu;
+  x ^= x >> 13;
+  x *= 0xC2B2AE35u;
+  x ^= x >> 16;
+  return frozen_range(x, n);
+}
+
+typedef struct {
+  // sizes of the two regions of the document, known after measuring it
+  size_t bodies_len;
+  size_t strings_len;
+  // where the next body and string go
+  char *body;
+  char *strings;
+  // keys repeat across objects, `keys' holds the copy of each by symbol id
+  JSONInterner *interner;
+  const char **keys;
+  uint64_t seed;
+  // scratch for placing the members of one object
+  uint64_t *hashes;
+  uint32_t *slots;
+  uint32_t *starts;
+  uint32_t *tried;
+  uint8_t *taken;
+  FrozenMember *members;
+  size_t scratch_cap;
+  bool ok;
+} Freezer;
+
+// sizes the document, interning every key on the way
+static void frozen_measure(Freezer *f, JSON json) {
+  switch (json.type) {
+  case OBJECT: {
+    struct HashMapJSON *map = json.map;
+    size_t n = map ? map->size : 0;
+    if (n > UINT32_MAX / 2) {
+      f->ok = false;
+      return;
+    }
+    if (n) {
+      f->bodies_len += frozen_object_size(n);
+    }
+
+    for (size_t b = 0, i = 0; f->ok && i < n && b < map->cap; b++) {
+      BucketJSON *bucket = &map->values[b];
+      if (!bucket->key) {
+        continue;
+      }
+
+      size_t before = f->interner->len;
+      if (!json_intern(f->interner, bucket->key, bucket->key_len)) {
+        f->ok = false;
+        return;
+      }
+      if (f->interner->len != before) {
+        f->strings_len += bucket->key_len + 1;
+      }
+
+      frozen_measure(f, bucket->value);
+      i++;
+    }
+    break;
+  }
+  case ARRAY: {
+    struct VectorJSON *vec = json.vec;
+    size_t n = vec ? vec->len : 0;
+    if (n > UINT32_MAX / 2) {
+      f->ok = false;
+      return;
+    }
+
+    f->bodies_len += n * sizeof(JSONFrozenNode);
+    for (size_t i = 0; f->ok && i < n; i++) {
+      frozen_measure(f, vec->items[i]);
+    }
+    break;
+  }
+  case STRING:
+    if (json.len > UINT32_MAX) {
+      f->ok = false;
+      return;
+    }
+
+    f->strings_len += json.len + 1;
+    break;
+  default:
+    break;
+  }
+}
+
+static const char *frozen_string(Freezer *f, const char *str, size_t len) {
+  char *copy = f->strings;
+  if (len) {
+    memcpy(copy, str, len);
+  }
+  copy[len] = '\0';
+  f->strings += len + 1;
+  return copy;
+}
+
+static const char *frozen_key(Freezer *f, const char *key, size_t len) {
+  const JSONSymbol *sym = json_interner_find(f->interner, key, len);
+  if (!f->keys[sym->id]) {
+    f->keys[sym->id] = frozen_string(f, key, len);
+  }
+
+  return f->keys[sym->id];
+}
+
+static bool frozen_scratch(Freezer *f, size_t n) {
+  if (n <= f->scratch_cap) {
+    return true;
+  }
+
+  free(f->hashes);
+  free(f->slots);
+  free(f->starts);
+  free(f->tried);
+  free(f->taken);
+  free(f->members);
+  f->hashes = malloc(n * sizeof(uint64_t));
+  f->slots = malloc(n * sizeof(uint32_t));
+  f->starts = malloc((n + 1) * sizeof(uint32_t));
+  f->tried = malloc(n * sizeof(uint32_t));
+  f->taken = malloc(n);
+  f->members = malloc(n * sizeof(FrozenMember));
+
+  bool ok = f->hashes && f->slots && f->starts && f->tried && f->taken &&
+            f->members;
+  f->scratch_cap = ok ? n : 0;
+  return ok;
+}
+
+/**
+ * Finds a displacement for every bucket of the `n' keys hashed into
+ * `f->hashes' such that no two keys share a slot, largest buckets first.
+ * The keys of a bucket are tried together, a bucket of one key simply takes
+ * the next free slot. Fills `f->slots' and `disp', false when some bucket
+ * found no displacement.
+ */
+static bool frozen_assign(Freezer *f, size_t n, uint32_t *disp) {
+  size_t buckets = frozen_buckets(n);
+  uint32_t *starts = f->starts;
+  // `slots' first holds the keys sorted by bucket
+  uint32_t *order = f->slots;
+
+  memset(starts, 0, (buckets + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < n; i++) {
+    starts[frozen_bucket(f->hashes[i], n) + 1]++;
+  }
+
+  size_t largest = 0;
+  for (size_t b = 0; b < buckets; b++) {
+    largest = starts[b + 1] > largest ? starts[b + 1] : largest;
+    starts[b + 1] += starts[b];
+  }
+
+  // `disp' counts how many keys of each bucket are sorted until it is set
+  memset(disp, 0, buckets * sizeof(uint32_t));
+  for (size_t i = 0; i < n; i++) {
+    uint32_t b = frozen_bucket(f->hashes[i], n);
+    order[starts[b] + disp[b]++] = (uint32_t)i;
+  }
+
+  // slots taken by the keys of the bucket being tried
+  uint32_t *tried = f->tried;
+  memset(f->taken, 0, n);
+  bool ok = true;
+  for (size_t size = largest; ok && size > 1; size--) {
+    for (size_t b = 0; ok && b < buckets; b++) {
+      if (starts[b + 1] - starts[b] != size) {
+        continue;
+      }
+
+      const uint32_t *bucket = order + starts[b];
+      uint32_t d = 0;
+      for (; d < FROZEN_MAX_DISPLACEMENT; d++) {
+        size_t k = 0;
+        for (; k < size; k++) {
+          uint32_t s = frozen_slot(f->hashes[bucket[k]], d, n);
+          if (f->taken[s]) {
+            break;
+          }
+          f->taken[s] = 1;
+          tried[k] = s;
+        }
+        if (k == size) {
+          break;
+        }
+
+        // a key collided, with another bucket or this one
+        while (k > 0) {
+          f->taken[tried[--k]] = 0;
+        }
+      }
+
+      ok = d < FROZEN_MAX_DISPLACEMENT;
+      disp[b] = d;
+    }
+  }
+
+  size_t next = 0;
+  for (size_t b = 0; ok && b < buckets; b++) {
+    if (starts[b + 1] - starts[b] == 1) {
+      while (f->taken[next]) {
+        next++;
+      }
+      f->taken[next] = 1;
+      disp[b] = FROZEN_DIRECT | (uint32_t)next;
+    } else if (starts[b + 1] == starts[b]) {
+      disp[b] = 0;
+    }
+  }
+
+  if (!ok) {
+    return false;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t h = f->hashes[i];
+    f->slots[i] = frozen_slot(h, disp[frozen_bucket(h, n)], n);
+  }
+
+  return true;
+}
+
+// moves the `n' members of `object' into their slots
+static void frozen_place(Freezer *f, struct FrozenObject *object, size_t n) {
+  uint32_t *disp = (uint32_t *)(object->members + n);
+
+  bool placed = false;
+  for (size_t seed = 0; !placed && seed < FROZEN_MAX_SEEDS; seed++) {
+    object->seed = f->seed + seed * FROZEN_SEED_STEP;
+    for (size_t i = 0; i < n; i++) {
+      const FrozenMember *m = &object->members[i];
+      f->hashes[i] = json_hash_wy(m->key, m->key_len, object->seed);
+    }
+
+    placed = frozen_assign(f, n, disp);
+  }
+
+  if (!placed) {
+    f->ok = false;
+    return;
+  }
+
+  memcpy(f->members, object->members, n * sizeof(FrozenMember));
+  for (size_t i = 0; i < n; i++) {
+    FrozenMember *m = &object->members[f->slots[i]];
+    *m = f->members[i];
+    m->hash = (uint32_t)f->hashes[i];
+  }
+}
+
+static void frozen_node(Freezer *f, JSON json, JSONFrozenNode *node) {
+  *node = (JSONFrozenNode){.type = json.type};
+
+  switch (json.type) {
+  case OBJECT: {
+    struct HashMapJSON *map = json.map;
+    size_t n = map ? map->size : 0;
+    if (!n) {
+      break;
+    }
+
+    struct FrozenObject *object = (struct FrozenObject *)f->body;
+    f->body += frozen_object_size(n);
+
+    for (size_t b = 0, i = 0; f->ok && i < n && b < map->cap; b++) {
+      BucketJSON *bucket = &map->values[b];
+      if (!bucket->key) {
+        continue;
+      }
+
+      FrozenMember *m = &object->members[i++];
+      m->key = frozen_key(f, bucket->key, bucket->key_len);
+      m->key_len = bucket->key_len;
+      frozen_node(f, bucket->value, &m->value);
+    }
+
+    if (f->ok && frozen_scratch(f, n)) {
+      frozen_place(f, object, n);
+    } else {
+      f->ok = false;
+    }
+
+    node->len = (uint32_t)n;
+    node->object = object;
+    break;
+  }
+  case ARRAY: {
+    struct VectorJSON *vec = json.vec;
+    size_t n = vec ? vec->len : 0;
+    if (!n) {
+      break;
+    }
+
+    JSONFrozenNode *items = (JSONFrozenNode *)f->body;
+    f->body += n * sizeof(JSONFrozenNode);
+    for (size_t i = 0; f->ok && i < n; i++) {
+      frozen_node(f, vec->items[i], &items[i]);
+    }
+
+    node->len = (uint32_t)n;
+    node->items = items;
+    break;
+  }
+  case STRING:
+    node->len = (uint32_t)json.len;
+    node->str = frozen_string(f, json.str, json.len);
+    break;
+  case NUMBER:
+    node->d = json.d;
+    break;
+  case INTEGER:
+  case UNSIGNED:
+    node->u = json.u;
+    break;
+  case BOOLEAN:
+    node->b = json.b;
+    break;
+  case NIL:
+    break;
+  }
+}
+
+JSONFrozen *json_freeze(JSON json) {
+  Freezer f = {
+      .interner = json_interner_new(),
+      .seed = json_hasher.seed,
+      .ok = json.ok,
+  };
+  if (!f.interner) {
+    f.ok = false;
+  }
+
+  if (f.ok) {
+    frozen_measure(&f, json);
+  }
+
+  size_t size = sizeof(JSONFrozen) + f.bodies_len + f.strings_len;
+  JSONFrozen *frozen = f.ok ? malloc(size) : NULL;
+  // one slot more, an empty document interns nothing
+  f.keys = f.ok ? calloc(f.interner->len + 1, sizeof(const char *)) : NULL;
+  if (frozen && f.keys) {
+    frozen->size = size;
+    f.body = (char *)(frozen + 1);
+    f.strings = f.body + f.bodies_len;
+    frozen_node(&f, json, &frozen->root);
+  } else {
+    f.ok = false;
+  }
+
+  free(f.hashes);
+  free(f.slots);
+  free(f.starts);
+  free(f.tried);
+  free(f.taken);
+  free(f.members);
+  free(f.keys);
+  json_interner_free(f.interner);
+
+  if (!f.ok) {
+    free(frozen);
+    return NULL;
+  }
+
+  return frozen;
+}
+
+void json_frozen_free(JSONFrozen *frozen) { free(frozen); }
+
+size_t json_frozen_size(const JSONFrozen *frozen) {
+  return frozen ? frozen->size : 0;
+}
+
+JSONFrozenValue json_frozen_root(const JSONFrozen *frozen) {
+  return (JSONFrozenValue){frozen ? &frozen->root : NULL};
+}
+
+JSONFrozenValue json_frozen_get_n(JSONFrozenValue v, const char *key,
+                                  size_t len) {
+  if (!v.node || v.node->type != OBJECT || !v.node->len) {
+    return (JSONFrozenValue){0};
+  }
+
+  const struct FrozenObject *object = v.node->object;
+  size_t n = v.node->len;
+  const uint32_t *disp = (const uint32_t *)(object->members + n);
+
+  uint64_t h = json_hash_wy(key, len, object->seed);
+  const FrozenMember *m =
+      &object->members[frozen_slot(h, disp[frozen_bucket(h, n)], n)];
+  if (m->hash != (uint32_t)h || m->key_len != len ||
+      memcmp(m->key, key, len) != 0) {
+    return (JSONFrozenValue){0};
+  }
+
+  return (JSONFrozenValue){&m->value};
+}
+
+JSONFrozenValue json_frozen_get(JSONFrozenValue v, const char *key) {
+  return json_frozen_get_n(v, key, strlen(key));
+}
+
+JSONFrozenValue json_frozen_member(JSONFrozenValue v, size_t index,
+                                   StringView *key) {
+  if (!v.node || v.node->type != OBJECT || index >= v.node->len) {
+    return (JSONFrozenValue){0};
+  }
+
+  const FrozenMember *m = &v.node->object->members[index];
+  if (key) {
+    key->str = m->key;
+    key->len = m->key_len;
+  }
+
+  return (JSONFrozenValue){&m->value};
+}
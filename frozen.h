@@ -0,0 +1,150 @@
+#include "json.h"
+#include <stdint.h>
+
+#ifndef FROZEN_H
+#define FROZEN_H
+
+/**
+ * Read-only copy of a `JSON' tree in a single block of memory, for documents
+ * parsed once and then read many times over, from any number of threads.
+ *
+ * - values are 16 bytes: the `JSONType', a 32-bit length and the number,
+ *   string or body inline
+ * - strings are NUL-terminated and every key is stored once
+ * - the members of an object are placed by a minimal perfect hash of their
+ *   keys, so a lookup hashes the key once and compares it with the one
+ *   member it can be. There are no empty slots, only a 32-bit displacement
+ *   for every 4 members or so
+ *
+ * Nothing in it is written after `json_freeze' returns, sharing one between
+ * threads needs no lock.
+ */
+typedef struct JSONFrozen JSONFrozen;
+
+typedef struct JSONFrozenNode {
+  uint32_t type;
+  uint32_t len;
+  union {
+    bool b;
+    double d;
+    int64_t i;
+    uint64_t u;
+    const char *str;
+    const struct JSONFrozenNode *items;
+    const struct FrozenObject *object;
+  };
+} JSONFrozenNode;
+
+// a value of a frozen document, a NULL `node' for a failed lookup
+typedef struct {
+  const JSONFrozenNode *node;
+} JSONFrozenValue;
+
+/**
+ * Freezes `json', which is left as it is. Fails for documents that are not
+ * ok, strings of 4G bytes or more and containers of 2G entries or more.
+ * Returns NULL on failure.
+ */
+JSONFrozen *json_freeze(JSON json);
+void json_frozen_free(JSONFrozen *frozen);
+
+// bytes held by `frozen'
+size_t json_frozen_size(const JSONFrozen *frozen);
+
+JSONFrozenValue json_frozen_root(const JSONFrozen *frozen);
+
+// value of member `key' of the object at `v'
+JSONFrozenValue json_frozen_get_n(JSONFrozenValue v, const char *key,
+                                  size_t len);
+JSONFrozenValue json_frozen_get(JSONFrozenValue v, const char *key);
+// value of member `index' of the object at `v', its key into `key' if set.
+// Members are in hash order
+JSONFrozenValue json_frozen_member(JSONFrozenValue v, size_t index,
+                                   StringView *key);
+
+static inline bool json_frozen_ok(JSONFrozenValue v) { return v.node != NULL; }
+
+// type of a value that is ok
+static inline enum JSONType json_frozen_type(JSONFrozenValue v) {
+  return (enum JSONType)v.node->type;
+}
+
+// members of an object, elements of an array, bytes of a string, 0 otherwise
+static inline size_t json_frozen_len(JSONFrozenValue v) {
+  if (!v.node || v.node->type > STRING) {
+    return 0;
+  }
+
+  return v.node->len;
+}
+
+// element `index' of the array at `v'
+static inline JSONFrozenValue json_frozen_at(JSONFrozenValue v, size_t index) {
+  if (!v.node || v.node->type != ARRAY || index >= v.node->len) {
+    return (JSONFrozenValue){0};
+  }
+
+  return (JSONFrozenValue){v.node->items + index};
+}
+
+// NUL-terminated contents of the string at `v', NULL when it is none
+static inline const char *json_frozen_string(JSONFrozenValue v, size_t *len) {
+  if (!v.node || v.node->type != STRING) {
+    return NULL;
+  }
+
+  if (len) {
+    *len = v.node->len;
+  }
+
+  return v.node->str;
+}
+
+// the number at `v', false when it is none or does not fit
+static inline bool json_frozen_double(JSONFrozenValue v, double *out) {
+  if (!v.node) {
+    return false;
+  }
+
+  switch (v.node->type) {
+  case NUMBER:
+    *out = v.node->d;
+    return true;
+  case INTEGER:
+    *out = (double)v.node->i;
+    return true;
+  case UNSIGNED:
+    *out = (double)v.node->u;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static inline bool json_frozen_int64(JSONFrozenValue v, int64_t *out) {
+  if (!v.node || v.node->type != INTEGER) {
+    return false;
+  }
+
+  *out = v.node->i;
+  return true;
+}
+
+static inline bool json_frozen_uint64(JSONFrozenValue v, uint64_t *out) {
+  if (!v.node) {
+    return false;
+  }
+  if (v.node->type != UNSIGNED &&
+      !(v.node->type == INTEGER && v.node->i >= 0)) {
+    return false;
+  }
+
+  *out = v.node->u;
+  return true;
+}
+
+static inline bool json_frozen_bool(JSONFrozenValue v) {
+  return v.node && v.node->type == BOOLEAN && v.node->b;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "hash.h"
+#include "murmurhash.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HASH_X86 1
+#include <immintrin.h>
+#endif
+
+static const uint64_t WYP0 = 0xa0761d6478bd642full;
+static const uint64_t WYP1 = 0xe7037ed1a0b428dbull;
+static const uint64_t WYP2 = 0x8ebc6af09c88c6e3ull;
+static const uint64_t WYP3 = 0x589965cc75374cc3ull;
+
+// the seed until the process start replaces it
+JSONHasher json_hasher = {json_hash_wy, 0xAFAFAF};
+
+static inline uint64_t read8(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t read4(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// 1 to 3 bytes, each of them read
+static inline uint64_t read_small(const uint8_t *p, size_t len) {
+  return (uint64_t)p[0] << 16 | (uint64_t)p[len >> 1] << 8 | p[len - 1];
+}
+
+// the two halves of the 128-bit product folded together
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 r = (unsigned __int128)a * b;
+  return (uint64_t)(r >> 64) ^ (uint64_t)r;
+#else
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+  uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return hi ^ (mid << 32 | (uint32_t)ll);
+#endif
+}
+
+// first and last 8 bytes, or overlapping 4-byte reads, of keys up to 16 bytes
+static inline void read_short(const uint8_t *p, size_t len, uint64_t *a,
+                              uint64_t *b) {
+  if (len >= 4) {
+    size_t mid = (len >> 3) << 2;
+    *a = read4(p) << 32 | read4(p + mid);
+    *b = read4(p + len - 4) << 32 | read4(p + len - 4 - mid);
+  } else if (len > 0) {
+    *a = read_small(p, len);
+    *b = 0;
+  } else {
+    *a = *b = 0;
+  }
+}
+
+uint64_t json_hash_wy(const void *key, size_t len, uint64_t seed) {
+  const uint8_t *p = key;
+  uint64_t a, b;
+  seed ^= mix(seed ^ WYP0, WYP1);
+
+  if (len <= 16) {
+    read_short(p, len, &a, &b);
+  } else {
+    size_t left = len;
+    if (left > 48) {
+      uint64_t s1 = seed, s2 = seed;
+      do {
+        seed = mix(read8(p) ^ WYP1, read8(p + 8) ^ seed);
+        s1 = mix(read8(p + 16) ^ WYP2, read8(p + 24) ^ s1);
+        s2 = mix(read8(p + 32) ^ WYP3, read8(p + 40) ^ s2);
+        p += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= s1 ^ s2;
+    }
+
+    for (; left > 16; left -= 16, p += 16) {
+      seed = mix(read8(p) ^ WYP1, read8(p + 8) ^ seed);
+    }
+
+    // the last 16 bytes, overlapping what was already mixed
+    a = read8(p + left - 16);
+    b = read8(p + left - 8);
+  }
+
+  return mix(WYP1 ^ len, mix(a ^ WYP1, b ^ seed));
+}
+
+#ifdef HASH_X86
+__attribute__((target("sse4.2"))) static uint64_t
+hash_crc32c_x86(const void *key, size_t len, uint64_t seed) {
+  const uint8_t *p = key;
+  uint64_t lo = seed, hi = ~seed;
+
+  // two independent lanes hide the latency of the crc instruction
+  size_t left = len;
+  for (; left > 16; left -= 16, p += 16) {
+    lo = _mm_crc32_u64(lo, read8(p));
+    hi = _mm_crc32_u64(hi, read8(p + 8));
+  }
+
+  uint64_t a, b;
+  if (len <= 16) {
+    read_short(p, left, &a, &b);
+  } else {
+    a = read8(p + left - 16);
+    b = read8(p + left - 8);
+  }
+  lo = _mm_crc32_u64(lo, a);
+  hi = _mm_crc32_u64(hi, b);
+
+  // crc only permutes bits, the multiply spreads them over the whole word
+  return mix((lo << 32 | hi) ^ seed, len ^ WYP0);
+}
+#endif
+
+uint64_t json_hash_crc32c(const void *key, size_t len, uint64_t seed) {
+#ifdef HASH_X86
+  if (__builtin_cpu_supports("sse4.2")) {
+    return hash_crc32c_x86(key, len, seed);
+  }
+#endif
+
+  return json_hash_wy(key, len, seed);
+}
+
+uint64_t json_hash_murmur(const void *key, size_t len, uint64_t seed) {
+  return murmurhash(key, (uint32_t)len, (uint32_t)seed);
+}
+
+bool json_hash_select(JSONHashKind kind) {
+  switch (kind) {
+  case JSON_HASH_WY:
+    json_hasher.fn = json_hash_wy;
+    return true;
+  case JSON_HASH_CRC32C:
+#ifdef HASH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+      json_hasher.fn = hash_crc32c_x86;
+      return true;
+    }
+#endif
+    return false;
+  case JSON_HASH_MURMUR:
+    json_hasher.fn = json_hash_murmur;
+    return true;
+  }
+
+  return false;
+}
+
+void json_hash_seed(uint64_t seed) { json_hasher.seed = seed; }
+
+// entropy from the system when it has any, mixed with the clock and the
+// address space layout
+static uint64_t hash_random_seed(void) {
+  uint64_t seed = 0;
+#ifndef _WIN32
+  FILE *f = fopen("/dev/urandom", "rb");
+  if (f) {
+    if (fread(&seed, sizeof(seed), 1, f) != 1) {
+      seed = 0;
+    }
+    fclose(f);
+  }
+#endif
+
+  uint64_t local = (uint64_t)(uintptr_t)&seed;
+  seed ^= mix((uint64_t)time(NULL) ^ WYP2, (uint64_t)clock() ^ WYP3);
+  return mix(seed ^ local, WYP0);
+}
+
+// runs before `main', so no map can exist yet and no lock is needed.
+// Without constructor support the fixed seed stays
+#ifdef __GNUC__
+__attribute__((constructor)) static void hash_init(void) {
+  json_hasher.seed = hash_random_seed();
+}
+#endif
@@ -0,0 +1,48 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HASH_H
+#define HASH_H
+
+typedef uint64_t (*JSONHashFn)(const void *key, size_t len, uint64_t seed);
+
+typedef enum {
+  // wyhash-style multiply-mix, the default: fast on short keys everywhere and
+  // seeded, so untrusted keys cannot be picked to collide
+  JSON_HASH_WY,
+  // hardware CRC32C on x86 with SSE4.2. Slightly faster on long keys, but
+  // CRC is linear and colliding keys collide for every seed: only use it
+  // for trusted input
+  JSON_HASH_CRC32C,
+  // MurmurHash3, for hashes that must match older builds
+  JSON_HASH_MURMUR,
+} JSONHashKind;
+
+typedef struct {
+  JSONHashFn fn;
+  uint64_t seed;
+} JSONHasher;
+
+/**
+ * The hash every map and interner uses. The seed is drawn at random when
+ * the process starts, so bucket order differs between runs.
+ */
+extern JSONHasher json_hasher;
+
+/**
+ * Switches the process to another hash function, returns false when this
+ * CPU does not support it. Hashes are stored in maps and interners, so this
+ * must happen before any of them is created.
+ */
+bool json_hash_select(JSONHashKind kind);
+
+// fixed seed for reproducible runs, with the same caveat as
+// `json_hash_select'
+void json_hash_seed(uint64_t seed);
+
+uint64_t json_hash_wy(const void *key, size_t len, uint64_t seed);
+uint64_t json_hash_crc32c(const void *key, size_t len, uint64_t seed);
+uint64_t json_hash_murmur(const void *key, size_t len, uint64_t seed);
+
+#endif
@@ -1,4 +1,6 @@
-#include "murmurhash.h"
+#include "arena.h"
+#include "hash.h"
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,138 +8,422 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
-uint32_t hash(const char *key) {
-  const uint32_t seed = 0xAFAFAF;
-  return murmurhash(key, (uint32_t)strlen(key), seed);
+#define HASHMAP_MIN_CAP 8
+
+// maps with up to this many keys are a plain array in insertion order,
+// searched linearly without hashing
+#ifndef HASHMAP_SMALL_MAX
+#define HASHMAP_SMALL_MAX 8
+#endif
+#define HASHMAP_SMALL_INIT (HASHMAP_SMALL_MAX < 4 ? HASHMAP_SMALL_MAX : 4)
+
+static inline uint32_t hash(const char *key, size_t len) {
+  return (uint32_t)json_hasher.fn(key, len, json_hasher.seed);
+}
+
+// smallest power of two table that holds `count' entries under the 3/4 load
+// factor
+static inline size_t hashmap_cap_for(size_t count) {
+  size_t cap = HASHMAP_MIN_CAP;
+  while (cap - cap / 4 < count) {
+    cap *= 2;
+  }
+
+  return cap;
+}
+
+// hashed tables always hold more than HASHMAP_SMALL_MAX buckets, so the
+// capacity tells the two representations apart
+static inline bool hashmap_is_small(size_t cap) {
+  return cap <= HASHMAP_SMALL_MAX;
+}
+
+static inline size_t hashmap_initial_cap(size_t count) {
+  if (count > HASHMAP_SMALL_MAX || HASHMAP_SMALL_INIT == 0) {
+    return hashmap_cap_for(count);
+  }
+
+  return count ? count : HASHMAP_SMALL_INIT;
 }
 
 #define DEFINE_HASHMAP(Name, name, type, free_func)                            \
   typedef struct {                                                             \
     const char *key;                                                           \
+    uint32_t key_len;                                                          \
+    uint32_t hash;                                                             \
     type value;                                                                \
   } Bucket##Name;                                                              \
                                                                                \
+  /* small maps fill `values' front to back, larger ones use open              \
+   * addressing with Robin Hood linear probing over a power of two table.      \
+   * Buckets are inline and empty ones have a NULL key. */                     \
   struct HashMap##Name {                                                       \
     size_t cap;                                                                \
     size_t size;                                                               \
-    Bucket##Name **values;                                                     \
+    Arena *arena;                                                              \
+    /* keys outlive the map (arena or source buffer), store them as given */   \
+    bool borrow_keys;                                                          \
+    Bucket##Name *values;                                                      \
   };                                                                           \
                                                                                \
-  struct HashMap##Name *hashmap_##name##_new() {                               \
-    struct HashMap##Name *hashmap = malloc(sizeof(struct HashMap##Name));      \
+  static inline struct HashMap##Name *hashmap_##name##_new_cap(Arena *arena,   \
+                                                               size_t count) { \
+    struct HashMap##Name *hashmap =                                            \
+        mem_alloc(arena, sizeof(struct HashMap##Name));                        \
     if (hashmap == NULL) {                                                     \
       return NULL;                                                             \
     }                                                                          \
                                                                                \
-    hashmap->cap = 64;                                                         \
+    hashmap->cap = hashmap_initial_cap(count);                                 \
+    JSON_STATS_ADD(maps, 1);                                                   \
+    JSON_STATS_ADD(map_slots, hashmap->cap);                                   \
     hashmap->size = 0;                                                         \
-    hashmap->values = calloc(hashmap->cap, sizeof(Bucket##Name *));            \
+    hashmap->arena = arena;                                                    \
+    hashmap->borrow_keys = false;                                              \
+    hashmap->values = mem_calloc(arena, hashmap->cap, sizeof(Bucket##Name));   \
     if (hashmap->values == NULL) {                                             \
-      free(hashmap);                                                           \
+      mem_free(arena, hashmap);                                                \
       return NULL;                                                             \
     }                                                                          \
                                                                                \
     return hashmap;                                                            \
   }                                                                            \
                                                                                \
-  void hashmap_##name##_free(struct HashMap##Name *hashmap) {                  \
+  static inline struct HashMap##Name *hashmap_##name##_new_in(Arena *arena) {  \
+    return hashmap_##name##_new_cap(arena, 0);                                 \
+  }                                                                            \
+                                                                               \
+  static inline struct HashMap##Name *hashmap_##name##_new() {                 \
+    return hashmap_##name##_new_in(NULL);                                      \
+  }                                                                            \
+                                                                               \
+  static inline void hashmap_##name##_free(struct HashMap##Name *hashmap) {    \
     if (hashmap == NULL) {                                                     \
       return;                                                                  \
     }                                                                          \
                                                                                \
+    Arena *arena = hashmap->arena;                                             \
     void (*free_fn)(type) = free_func;                                         \
     for (size_t i = 0; i < hashmap->cap; i++) {                                \
-      free((void *)hashmap->values[i]->key);                                   \
+      Bucket##Name *b = &hashmap->values[i];                                   \
+      if (b->key == NULL) {                                                    \
+        continue;                                                              \
+      }                                                                        \
+                                                                               \
       if (free_fn) {                                                           \
-        free_fn(hashmap->values[i]->value);                                    \
+        free_fn(b->value);                                                     \
+      }                                                                        \
+      if (!hashmap->borrow_keys) {                                             \
+        mem_free(arena, (void *)b->key);                                       \
       }                                                                        \
-      free(hashmap->values[i]);                                                \
     }                                                                          \
                                                                                \
-    free(hashmap->values);                                                     \
-    free(hashmap);                                                             \
+    mem_free(arena, hashmap->values);                                          \
+    mem_free(arena, hashmap);                                                  \
   }                                                                            \
                                                                                \
-  void hashmap_##name##_set(struct HashMap##Name *hashmap, const char *key,    \
-                            type value) {                                      \
-    if (hashmap->size >= hashmap->cap * 0.75) {                                \
-      size_t new_cap = hashmap->cap * 2;                                       \
-      Bucket##Name **new_values = calloc(new_cap, sizeof(Bucket##Name *));     \
-      if (new_values == NULL) {                                                \
+  /* a copy of `hashmap' in `arena' holding the same values. It borrows the    \
+   * keys of `hashmap', which must outlive it */                               \
+  static inline struct HashMap##Name *hashmap_##name##_clone(                  \
+      struct HashMap##Name *hashmap, Arena *arena) {                           \
+    struct HashMap##Name *copy =                                               \
+        mem_alloc(arena, sizeof(struct HashMap##Name));                        \
+    if (copy == NULL) {                                                        \
+      return NULL;                                                             \
+    }                                                                          \
+                                                                               \
+    *copy = *hashmap;                                                          \
+    copy->arena = arena;                                                       \
+    copy->borrow_keys = true;                                                  \
+    copy->values = mem_alloc(arena, hashmap->cap * sizeof(Bucket##Name));      \
+    if (copy->values == NULL) {                                                \
+      mem_free(arena, copy);                                                   \
+      return NULL;                                                             \
+    }                                                                          \
+                                                                               \
+    memcpy(copy->values, hashmap->values,                                      \
+           hashmap->cap * sizeof(Bucket##Name));                               \
+    JSON_STATS_ADD(maps, 1);                                                   \
+    JSON_STATS_ADD(map_slots, copy->cap);                                      \
+    return copy;                                                               \
+  }                                                                            \
+                                                                               \
+  /* places `bucket' without looking for its key, the table must have room */  \
+  static inline void hashmap_##name##_place(struct HashMap##Name *hashmap,     \
+                                            Bucket##Name bucket) {             \
+    size_t mask = hashmap->cap - 1;                                            \
+    size_t index = bucket.hash & mask;                                         \
+                                                                               \
+    for (size_t dist = 0;; index = (index + 1) & mask, dist++) {               \
+      Bucket##Name *b = &hashmap->values[index];                               \
+      if (b->key == NULL) {                                                    \
+        *b = bucket;                                                           \
         return;                                                                \
       }                                                                        \
                                                                                \
-      for (size_t i = 0; i < hashmap->cap; i++) {                              \
-        Bucket##Name *b = hashmap->values[i];                                  \
+      /* take the slot from an entry closer to its home */                     \
+      size_t b_dist = (index - b->hash) & mask;                                \
+      if (b_dist < dist) {                                                     \
+        Bucket##Name tmp = *b;                                                 \
+        *b = bucket;                                                           \
+        bucket = tmp;                                                          \
+        dist = b_dist;                                                         \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
                                                                                \
-        if (b == NULL) {                                                       \
-          continue;                                                            \
-        }                                                                      \
+  static inline bool hashmap_##name##_reserve(struct HashMap##Name *hashmap,   \
+                                              size_t count) {                  \
+    bool small = hashmap_is_small(hashmap->cap);                               \
+    if (small && count <= HASHMAP_SMALL_MAX) {                                 \
+      if (count <= hashmap->cap) {                                             \
+        return true;                                                           \
+      }                                                                        \
                                                                                \
-        size_t index = hash(b->key) % new_cap;                                 \
-        for (size_t j = 0; j < new_cap; j++) {                                 \
-          size_t new_index = (index + j * j) % new_cap;                        \
-          if (new_values[new_index] == NULL) {                                 \
-            new_values[new_index] = b;                                         \
-            break;                                                             \
-          }                                                                    \
-        }                                                                      \
+      size_t new_cap = hashmap->cap * 2 < count ? count : hashmap->cap * 2;    \
+      new_cap = new_cap < HASHMAP_SMALL_MAX ? new_cap : HASHMAP_SMALL_MAX;     \
+      Bucket##Name *new_values =                                               \
+          mem_realloc(hashmap->arena, hashmap->values,                         \
+                      hashmap->cap * sizeof(Bucket##Name),                     \
+                      new_cap * sizeof(Bucket##Name));                         \
+      if (new_values == NULL) {                                                \
+        return false;                                                          \
       }                                                                        \
                                                                                \
-      free(hashmap->values);                                                   \
+      memset(new_values + hashmap->cap, 0,                                     \
+             (new_cap - hashmap->cap) * sizeof(Bucket##Name));                 \
+      JSON_STATS_ADD(map_resizes, 1);                                          \
+      JSON_STATS_ADD(map_slots, new_cap - hashmap->cap);                       \
       hashmap->values = new_values;                                            \
       hashmap->cap = new_cap;                                                  \
+      return true;                                                             \
+    }                                                                          \
+                                                                               \
+    size_t new_cap = hashmap_cap_for(count);                                   \
+    if (new_cap <= hashmap->cap) {                                             \
+      return true;                                                             \
+    }                                                                          \
+                                                                               \
+    Bucket##Name *old_values = hashmap->values;                                \
+    size_t old_cap = hashmap->cap;                                             \
+    Bucket##Name *new_values =                                                 \
+        mem_calloc(hashmap->arena, new_cap, sizeof(Bucket##Name));             \
+    if (new_values == NULL) {                                                  \
+      return false;                                                            \
+    }                                                                          \
+                                                                               \
+    hashmap->values = new_values;                                              \
+    hashmap->cap = new_cap;                                                    \
+    JSON_STATS_ADD(map_resizes, 1);                                            \
+    JSON_STATS_ADD(map_slots, new_cap - old_cap);                              \
+    /* the stored hashes make rehashing a plain move, a small map is hashed    \
+     * once when it is promoted */                                             \
+    for (size_t i = 0; i < old_cap; i++) {                                     \
+      Bucket##Name b = old_values[i];                                          \
+      if (b.key == NULL) {                                                     \
+        continue;                                                              \
+      }                                                                        \
+                                                                               \
+      /* small maps skip hashing unless the caller supplied the hash, a        \
+       * real hash of 0 is just computed again */                              \
+      if (small && b.hash == 0) {                                              \
+        b.hash = hash(b.key, b.key_len);                                       \
+      }                                                                        \
+      hashmap_##name##_place(hashmap, b);                                      \
+    }                                                                          \
+                                                                               \
+    mem_free(hashmap->arena, old_values);                                      \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline type *hashmap_##name##_find_hashed(                            \
+      struct HashMap##Name *hashmap, const char *key, size_t len,              \
+      uint32_t h) {                                                            \
+    size_t mask = hashmap->cap - 1;                                            \
+    size_t index = h & mask;                                                   \
+                                                                               \
+    for (size_t dist = 0;; index = (index + 1) & mask, dist++) {               \
+      Bucket##Name *b = &hashmap->values[index];                               \
+                                                                               \
+      /* an empty slot or an entry closer to home ends the probe sequence */   \
+      if (b->key == NULL || ((index - b->hash) & mask) < dist) {               \
+        JSON_STATS_PROBE(dist);                                                \
+        return NULL;                                                           \
+      }                                                                        \
+                                                                               \
+      /* interned keys are equal by pointer */                                 \
+      if (b->hash == h && b->key_len == len &&                                 \
+          (b->key == key || memcmp(b->key, key, len) == 0)) {                  \
+        JSON_STATS_PROBE(dist);                                                \
+        return &b->value;                                                      \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static inline type *hashmap_##name##_find_small(                             \
+      struct HashMap##Name *hashmap, const char *key, size_t len) {            \
+    for (size_t i = 0; i < hashmap->size; i++) {                               \
+      Bucket##Name *b = &hashmap->values[i];                                   \
+      if (b->key_len == len &&                                                 \
+          (b->key == key ||                                                    \
+           ((len == 0 || b->key[0] == key[0]) &&                               \
+            memcmp(b->key, key, len) == 0))) {                                 \
+        return &b->value;                                                      \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    return NULL;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline type *hashmap_##name##_find_n(struct HashMap##Name *hashmap,   \
+                                              const char *key, size_t len) {   \
+    if (hashmap_is_small(hashmap->cap)) {                                      \
+      return hashmap_##name##_find_small(hashmap, key, len);                   \
+    }                                                                          \
+                                                                               \
+    return hashmap_##name##_find_hashed(hashmap, key, len, hash(key, len));    \
+  }                                                                            \
+                                                                               \
+  /* lookup by a key whose `hash' is already known, e.g. an interned one */    \
+  static inline type *hashmap_##name##_find_with_hash(                         \
+      struct HashMap##Name *hashmap, const char *key, size_t len,              \
+      uint32_t h) {                                                            \
+    if (hashmap_is_small(hashmap->cap)) {                                      \
+      return hashmap_##name##_find_small(hashmap, key, len);                   \
+    }                                                                          \
+                                                                               \
+    return hashmap_##name##_find_hashed(hashmap, key, len, h);                 \
+  }                                                                            \
+                                                                               \
+  /* inserts or replaces `key', whose hash is `h' or, in a small map, 0 when   \
+   * it has not been computed */                                               \
+  static inline void hashmap_##name##_set_with_hash(                           \
+      struct HashMap##Name *hashmap, const char *key, size_t len, uint32_t h,  \
+      type value) {                                                            \
+    bool small = hashmap_is_small(hashmap->cap);                               \
+    if (!small && h == 0) {                                                    \
+      h = hash(key, len);                                                      \
     }                                                                          \
                                                                                \
-    size_t index = hash(key) % hashmap->cap;                                   \
-    Bucket##Name *bucket = malloc(sizeof(Bucket##Name));                       \
-    if (bucket == NULL) {                                                      \
+    type *existing = small                                                     \
+                         ? hashmap_##name##_find_small(hashmap, key, len)      \
+                         : hashmap_##name##_find_hashed(hashmap, key, len, h); \
+    if (existing) {                                                            \
+      void (*free_fn)(type) = free_func;                                       \
+      if (free_fn) {                                                           \
+        free_fn(*existing);                                                    \
+      }                                                                        \
+      *existing = value;                                                       \
       return;                                                                  \
     }                                                                          \
                                                                                \
-    bucket->key = strdup(key);                                                 \
-    bucket->value = value;                                                     \
+    if (!hashmap_##name##_reserve(hashmap, hashmap->size + 1)) {               \
+      return;                                                                  \
+    }                                                                          \
                                                                                \
-    for (size_t i = 0; i < hashmap->cap; i++) {                                \
-      size_t new_index = (index + i * i) % hashmap->cap;                       \
-      if (hashmap->values[new_index] == NULL) {                                \
-        hashmap->values[new_index] = bucket;                                   \
-        hashmap->size++;                                                       \
+    const char *k = key;                                                       \
+    if (!hashmap->borrow_keys) {                                               \
+      k = mem_strndup(hashmap->arena, key, len);                               \
+      if (k == NULL) {                                                         \
         return;                                                                \
       }                                                                        \
     }                                                                          \
+                                                                               \
+    Bucket##Name bucket = {                                                    \
+        .key = k, .key_len = (uint32_t)len, .hash = h, .value = value};        \
+    JSON_STATS_ADD(map_entries, 1);                                            \
+    if (hashmap_is_small(hashmap->cap)) {                                      \
+      hashmap->values[hashmap->size++] = bucket;                               \
+      return;                                                                  \
+    }                                                                          \
+                                                                               \
+    /* the map may just have been promoted */                                  \
+    bucket.hash = h ? h : hash(key, len);                                      \
+    hashmap_##name##_place(hashmap, bucket);                                   \
+    hashmap->size++;                                                           \
   }                                                                            \
                                                                                \
-  type hashmap_##name##_get(struct HashMap##Name *hashmap, const char *key) {  \
-    size_t index = hash(key) % hashmap->cap;                                   \
+  static inline void hashmap_##name##_set_n(                                   \
+      struct HashMap##Name *hashmap, const char *key, size_t len,              \
+      type value) {                                                            \
+    uint32_t h = hashmap_is_small(hashmap->cap) ? 0 : hash(key, len);          \
+    hashmap_##name##_set_with_hash(hashmap, key, len, h, value);               \
+  }                                                                            \
                                                                                \
-    for (size_t i = 0; i < hashmap->cap; i++) {                                \
-      size_t new_index = (index + i * i) % hashmap->cap;                       \
-      Bucket##Name *b = hashmap->values[new_index];                            \
+  static inline void hashmap_##name##_set(struct HashMap##Name *hashmap,       \
+                                          const char *key, type value) {       \
+    hashmap_##name##_set_n(hashmap, key, strlen(key), value);                  \
+  }                                                                            \
                                                                                \
-      if (b == NULL) {                                                         \
-        continue;                                                              \
-      }                                                                        \
+  /* takes `key' out of the map, its value into `out' if set. Returns false    \
+   * when it is not there */                                                   \
+  static inline bool hashmap_##name##_remove_n(struct HashMap##Name *hashmap,  \
+                                               const char *key, size_t len,    \
+                                               type *out) {                    \
+    type *value = hashmap_##name##_find_n(hashmap, key, len);                  \
+    if (value == NULL) {                                                       \
+      return false;                                                            \
+    }                                                                          \
+                                                                               \
+    Bucket##Name *b =                                                          \
+        (Bucket##Name *)((char *)value - offsetof(Bucket##Name, value));       \
+    if (out) {                                                                 \
+      *out = b->value;                                                         \
+    }                                                                          \
+    if (!hashmap->borrow_keys) {                                               \
+      mem_free(hashmap->arena, (void *)b->key);                                \
+    }                                                                          \
+                                                                               \
+    size_t index = b - hashmap->values;                                        \
+    hashmap->size--;                                                           \
+    if (hashmap_is_small(hashmap->cap)) {                                      \
+      memmove(b, b + 1, (hashmap->size - index) * sizeof(Bucket##Name));       \
+      hashmap->values[hashmap->size] = (Bucket##Name){0};                      \
+      return true;                                                             \
+    }                                                                          \
                                                                                \
-      if (strcmp(b->key, key) == 0) {                                          \
-        return b->value;                                                       \
+    /* the entries after it move back a slot, up to the first one that is      \
+     * at home */                                                              \
+    size_t mask = hashmap->cap - 1;                                            \
+    for (;;) {                                                                 \
+      size_t next = (index + 1) & mask;                                        \
+      Bucket##Name *n = &hashmap->values[next];                                \
+      if (n->key == NULL || ((next - n->hash) & mask) == 0) {                  \
+        break;                                                                 \
       }                                                                        \
+                                                                               \
+      hashmap->values[index] = *n;                                             \
+      index = next;                                                            \
     }                                                                          \
                                                                                \
-    return *(type *)NULL;                                                      \
+    hashmap->values[index] = (Bucket##Name){0};                                \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* a miss returns a zeroed value */                                          \
+  static inline type hashmap_##name##_get_n(struct HashMap##Name *hashmap,     \
+                                            const char *key, size_t len) {     \
+    type *value = hashmap_##name##_find_n(hashmap, key, len);                  \
+    return value ? *value : (type){0};                                         \
+  }                                                                            \
+                                                                               \
+  static inline type hashmap_##name##_get(struct HashMap##Name *hashmap,       \
+                                          const char *key) {                   \
+    return hashmap_##name##_get_n(hashmap, key, strlen(key));                  \
   }                                                                            \
                                                                                \
-  void hashmap_##name##_print(struct HashMap##Name *hashmap,                   \
-                              void (*print)(type, int ident), int ident) {     \
+  static inline void hashmap_##name##_print(                                   \
+      struct HashMap##Name *hashmap, void (*print)(type, int ident),           \
+      int ident) {                                                             \
     struct HashMap##Name map = *hashmap;                                       \
                                                                                \
     printf("{\n");                                                             \
     for (size_t i = 0, j = 0; i < map.cap; i++) {                              \
-      Bucket##Name *b = map.values[i];                                         \
-      if (!b) {                                                                \
+      Bucket##Name *b = &map.values[i];                                        \
+      if (!b->key) {                                                           \
         continue;                                                              \
       }                                                                        \
-      printf("%*s\"%s\": ", ident * 2, "", b->key);                            \
+      printf("%*s\"%.*s\": ", ident * 2, "", (int)b->key_len, b->key);         \
       print(b->value, ident);                                                  \
       if (j++ < map.size - 1) {                                                \
         printf(",");                                                           \
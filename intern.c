@@ -0,0 +1,125 @@
+#include "intern.h"
+
+#define INTERN_MIN_CAP 256
+
+JSONInterner *json_interner_new(void) {
+  JSONInterner *interner = malloc(sizeof(JSONInterner));
+  if (!interner) {
+    return NULL;
+  }
+
+  *interner = (JSONInterner){
+      .arena = arena_new(0),
+      .table = calloc(INTERN_MIN_CAP, sizeof(JSONSymbol *)),
+      .cap = INTERN_MIN_CAP,
+      .symbols = malloc(INTERN_MIN_CAP / 2 * sizeof(JSONSymbol *)),
+  };
+
+  if (!interner->arena || !interner->table || !interner->symbols) {
+    json_interner_free(interner);
+    return NULL;
+  }
+
+  return interner;
+}
+
+void json_interner_free(JSONInterner *interner) {
+  if (!interner) {
+    return;
+  }
+
+  if (interner->arena) {
+    arena_free(interner->arena);
+  }
+  free(interner->table);
+  free(interner->symbols);
+  free(interner);
+}
+
+// slot of `str', or of the empty slot where it belongs
+static size_t intern_slot(const JSONInterner *interner, const char *str,
+                          size_t len, uint32_t h) {
+  size_t mask = interner->cap - 1;
+  size_t i = h & mask;
+  for (;; i = (i + 1) & mask) {
+    const JSONSymbol *sym = interner->table[i];
+    if (!sym || (sym->hash == h && sym->len == len &&
+                 memcmp(sym->str, str, len) == 0)) {
+      return i;
+    }
+  }
+}
+
+// doubles the table, which is kept at most half full
+static bool intern_grow(JSONInterner *interner) {
+  size_t cap = interner->cap * 2;
+  JSONSymbol **table = calloc(cap, sizeof(JSONSymbol *));
+  JSONSymbol **symbols =
+      realloc(interner->symbols, cap / 2 * sizeof(JSONSymbol *));
+  if (!table || !symbols) {
+    free(table);
+    interner->symbols = symbols ? symbols : interner->symbols;
+    return false;
+  }
+
+  for (size_t i = 0; i < interner->len; i++) {
+    JSONSymbol *sym = symbols[i];
+    size_t j = sym->hash & (cap - 1);
+    while (table[j]) {
+      j = (j + 1) & (cap - 1);
+    }
+    table[j] = sym;
+  }
+
+  free(interner->table);
+  interner->table = table;
+  interner->symbols = symbols;
+  interner->cap = cap;
+  return true;
+}
+
+const JSONSymbol *json_intern(JSONInterner *interner, const char *str,
+                              size_t len) {
+  if (len > UINT32_MAX) {
+    return NULL;
+  }
+
+  uint32_t h = hash(str, len);
+  size_t i = intern_slot(interner, str, len, h);
+  if (interner->table[i]) {
+    return interner->table[i];
+  }
+
+  if (interner->len == interner->cap / 2) {
+    if (!intern_grow(interner)) {
+      return NULL;
+    }
+    i = intern_slot(interner, str, len, h);
+  }
+
+  JSONSymbol *sym = arena_alloc(interner->arena, sizeof(JSONSymbol));
+  char *copy = arena_strndup(interner->arena, str, len);
+  if (!sym || !copy) {
+    return NULL;
+  }
+
+  *sym = (JSONSymbol){
+      .str = copy,
+      .len = (uint32_t)len,
+      .hash = h,
+      .id = (uint32_t)interner->len,
+  };
+  interner->table[i] = sym;
+  interner->symbols[interner->len++] = sym;
+  return sym;
+}
+
+const JSONSymbol *json_interner_find(const JSONInterner *interner,
+                                     const char *str, size_t len) {
+  return interner->table[intern_slot(interner, str, len, hash(str, len))];
+}
+
+const JSONSymbol *json_interner_symbol(const JSONInterner *interner,
+                                       uint32_t id) {
+  return id < interner->len ? interner->symbols[id] : NULL;
+}
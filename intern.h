@@ -0,0 +1,75 @@
+#include "json.h"
+
+#ifndef INTERN_H
+#define INTERN_H
+
+/**
+ * One distinct key name. `str' is NUL-terminated and is the only copy of the
+ * name in its interner, so two symbols of the same interner are equal
+ * exactly when their pointers are.
+ */
+typedef struct {
+  const char *str;
+  uint32_t len;
+  // same value `hash' gives, maps reuse it instead of hashing the key again
+  uint32_t hash;
+  // dense, in order of first appearance
+  uint32_t id;
+} JSONSymbol;
+
+/**
+ * Table of the key names seen across any number of documents. Documents
+ * parsed with an interner borrow its names, so it must outlive them. It is
+ * not thread-safe: share one per parser or per thread.
+ */
+typedef struct JSONInterner {
+  // names and symbols, which never move
+  Arena *arena;
+  // open addressing over a power of two `cap'
+  JSONSymbol **table;
+  size_t cap;
+  // symbols by id
+  JSONSymbol **symbols;
+  size_t len;
+} JSONInterner;
+
+JSONInterner *json_interner_new(void);
+void json_interner_free(JSONInterner *interner);
+
+/**
+ * The symbol for the `len' bytes at `str', added on first sight. Returns
+ * NULL when out of memory.
+ */
+const JSONSymbol *json_intern(JSONInterner *interner, const char *str,
+                              size_t len);
+
+// the symbol for a name, NULL when it was never interned
+const JSONSymbol *json_interner_find(const JSONInterner *interner,
+                                     const char *str, size_t len);
+
+// the symbol with id `id', NULL when there is none
+const JSONSymbol *json_interner_symbol(const JSONInterner *interner,
+                                       uint32_t id);
+
+/**
+ * Same as `json_parse_n', with every object key interned into `interner'.
+ * Maps then hold its canonical names instead of copies, with their hashes
+ * already computed.
+ */
+JSON json_parse_interned(const char *source, size_t len, Arena *arena,
+                         unsigned flags, JSONInterner *interner);
+
+/**
+ * Member `sym' of `object', for objects parsed with the same interner:
+ * neither hashed nor compared byte by byte when it is there.
+ */
+static inline JSON *json_find_symbol(JSON object, const JSONSymbol *sym) {
+  if (object.type != OBJECT || !sym) {
+    return NULL;
+  }
+
+  return hashmap_json_find_with_hash(object.map, sym->str, sym->len,
+                                     sym->hash);
+}
+
+#endif
@@ -1,58 +1,206 @@
 #include "json.h"
+#include "file.h"
 #include "hashmap.h"
+#include "intern.h"
+#include "number.h"
+#include "stringify.h"
+#include "validate.h"
 #include "vector.h"
 
-static const char WS[] = " \n\r\t";
-#define WS_SIZE sizeof(char) * 5;
+static inline bool is_ws(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
 
-void json_print_r(JSON json, int ident) {
-  switch (json.type) {
-  case OBJECT:
-    hashmap_json_print(json.map, json_print_r, ident + 1);
-    break;
-  case ARRAY:
-    vector_json_print(json.vec, json_print_r, ident + 1);
-    break;
-  case STRING:
-    printf("\"%s\"", json.str);
-    break;
-  case NUMBER:
-    printf("%f", json.d);
-    break;
-  case BOOLEAN:
-    printf("%s", json.b ? "true" : "false");
-    break;
+void json_print(JSON json) {
+  // anything stdio still buffers has to come out first
+  fflush(stdout);
+
+  JSONBuffer buf = json_buffer_fd(fileno(stdout), 0);
+  json_stringify(&buf, json, JSON_PRETTY);
+  json_buffer_write(&buf, "\n", 1);
+  json_buffer_free(&buf);
+}
+
+static const char ESCAPES[] = "\"\\/bfnrt";
+static const char UNESCAPED[] = "\"\\/\b\f\n\r\t";
+
+static inline int hex4(const char *s) {
+  int value = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = s[i];
+    int digit = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                       : -1;
+    if (digit < 0) {
+      return -1;
+    }
+    value = value << 4 | digit;
   }
+
+  return value;
 }
 
-void json_print(JSON json) {
-  json_print_r(json, 0);
-  printf("\n");
+static inline size_t utf8_encode(char *dst, uint32_t cp) {
+  if (cp < 0x80) {
+    dst[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    dst[0] = (char)(0xC0 | cp >> 6);
+    dst[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    dst[0] = (char)(0xE0 | cp >> 12);
+    dst[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+    dst[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  dst[0] = (char)(0xF0 | cp >> 18);
+  dst[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+  dst[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+  dst[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+// decodes the escape sequences of `src' into `dst'. No escape sequence is
+// shorter than its UTF-8 encoding, so `dst' needs at most `len' bytes.
+size_t json_unescape(char *dst, const char *src, size_t len) {
+  const char *end = src + len;
+  char *out = dst;
+
+  while (src < end) {
+    const char *slash = memchr(src, '\\', end - src);
+    size_t run = (slash ? slash : end) - src;
+    memcpy(out, src, run);
+    out += run;
+    src += run;
+
+    if (!slash || end - src < 2) {
+      break;
+    }
+
+    char c = src[1];
+    src += 2;
+
+    const char *e = strchr(ESCAPES, c);
+    if (c != 'u') {
+      *out++ = c && e ? UNESCAPED[e - ESCAPES] : c;
+      continue;
+    }
+
+    int cp = end - src >= 4 ? hex4(src) : -1;
+    if (cp < 0) {
+      *out++ = c;
+      continue;
+    }
+    src += 4;
+
+    if (cp >= 0xD800 && cp <= 0xDFFF) {
+      int low = end - src >= 6 && src[0] == '\\' && src[1] == 'u'
+                    ? hex4(src + 2)
+                    : -1;
+      if (cp <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        src += 6;
+      } else {
+        // lone surrogate
+        cp = 0xFFFD;
+      }
+    }
+
+    out += utf8_encode(out, (uint32_t)cp);
+  }
+
+  return out - dst;
+}
+
+// returns the contents of a string token, pointing into the source when it
+// is allowed and there is nothing to decode
+static StringView json_string(Parser *p, Token t) {
+  if (!t.escaped && p->flags & JSON_ZERO_COPY) {
+    return (StringView){t.str, t.len};
+  }
+
+  char *str = mem_alloc(p->arena, t.len + 1);
+  if (!str) {
+    // empty, and still pointing into the source so nobody frees it
+    p->result.ok = false;
+    return (StringView){t.str, 0};
+  }
+
+  size_t len = t.len;
+  if (t.escaped) {
+    len = json_unescape(str, t.str, t.len);
+  } else {
+    memcpy(str, t.str, len);
+  }
+  str[len] = '\0';
+
+  return (StringView){str, len};
 }
 
 static inline char next(Parser *p) { return p->source[p->offset++]; }
 
-static inline char match(Parser *p, const char *accept, bool skip_ws) {
-  if (skip_ws) {
-    p->offset += strspn(p->source + p->offset, WS);
+// the character of the next structural index entry, if it is one of `accept'.
+// The end of the input matches as '\0'.
+static inline char match(Parser *p, const char *accept) {
+  if (p->index_pos >= p->index.len) {
+    return '\0';
   }
 
-  if (!strchr(accept, p->source[p->offset])) {
+  char c = p->source[p->index.positions[p->index_pos]];
+  if (!c || !strchr(accept, c)) {
     return -1;
   }
 
-  return p->source[p->offset];
+  return c;
 }
 
-Token scan_token(Parser *p) {
+// end of the token at `offset': the next index entry with any whitespace in
+// between trimmed
+static inline size_t token_end(Parser *p) {
+  size_t end = p->index_pos < p->index.len ? p->index.positions[p->index_pos]
+                                           : p->len;
+  while (end > p->offset && is_ws(p->source[end - 1])) {
+    end--;
+  }
+
+  return end;
+}
+
+Token scan_scalar(const char *start, size_t len) {
+  switch (*start) {
+  case 't':
+    return len == 4 && !memcmp(start, "true", 4)
+               ? (Token){.type = TOK_BOOLEAN, .b = true}
+               : (Token){.type = TOK_NONE};
+  case 'f':
+    return len == 5 && !memcmp(start, "false", 5)
+               ? (Token){.type = TOK_BOOLEAN, .b = false}
+               : (Token){.type = TOK_NONE};
+  case 'n':
+    return len == 4 && !memcmp(start, "null", 4) ? (Token){.type = TOK_NULL}
+                                                 : (Token){.type = TOK_NONE};
+  default: {
+    JSON_STATS_TIMER(since);
+    Token t = scan_number(start, len);
+    JSON_STATS_ELAPSED(number_ns, since);
+    return t;
+  }
+  }
+}
+
+static inline Token next_token(Parser *p) {
+  if (p->index_pos >= p->index.len) {
+    return (Token){.type = TOK_NONE};
+  }
+
+  p->offset = p->index.positions[p->index_pos++];
   char c = next(p);
 
   switch (c) {
-  case ' ':
-  case '\n':
-  case '\r':
-  case '\t':
-    return (Token){.type = TOK_WHITESPACE};
   case '{':
     return (Token){.type = TOK_BRACE_LEFT};
   case '}':
@@ -66,151 +214,422 @@ Token scan_token(Parser *p) {
   case ':':
     return (Token){.type = TOK_COLON};
   case '"': {
-    const char *start = p->source + p->offset;
-    const char *end = strchr(start, '"');
-    size_t len = end - start;
+    // the index skips the contents of strings, so the closing quote is the
+    // last byte before the next structural character
+    size_t end = token_end(p);
+    if (end == p->offset || p->source[end - 1] != '"') {
+      break;
+    }
 
-    char *str = malloc(sizeof(char) * len);
-    memcpy(str, start, len);
-    str[len] = '\0';
+    const char *start = p->source + p->offset;
+    size_t len = end - 1 - p->offset;
+    bool escaped = memchr(start, '\\', len) != NULL;
 
     // set offset to the character after the last quote
-    p->offset += len + 1;
+    p->offset = end;
 
-    return (Token){.type = TOK_STRING, .str = str};
+    return (Token){
+        .type = TOK_STRING, .str = start, .len = len, .escaped = escaped};
   }
   default: {
-    const char *start = p->source + p->offset - 1;
-    char *endptr;
-    double value = strtod(start, &endptr);
+    size_t start = p->offset - 1;
+    size_t end = token_end(p);
 
-    if (endptr != start) {
-      p->offset += endptr - (start + 1);
-      return (Token){.type = TOK_NUMBER, .d = value};
-    }
-
-    break;
+    p->offset = end;
+    return scan_scalar(p->source + start, end - start);
   }
   }
 
   return (Token){.type = TOK_NONE};
 }
 
-void json_merge_value(Parser *parser, JSON value) {
-  Parser p = *parser;
+Token scan_token(Parser *p) {
+  Token t = next_token(p);
+  JSON_STATS_TOKEN(t.type);
+  return t;
+}
+
+// sets member `key' through the parser's interner, which also owns the name
+static void json_merge_interned(Parser *p, struct HashMapJSON *map, Token key,
+                                JSON value) {
+  char small[256];
+  const char *str = key.str;
+  size_t len = key.len;
+  char *buf = NULL;
+
+  // only the interned copy outlives this call
+  if (key.escaped) {
+    buf = key.len <= sizeof(small) ? small : malloc(key.len);
+    if (!buf) {
+      p->result.ok = false;
+      return;
+    }
+    len = json_unescape(buf, key.str, key.len);
+    str = buf;
+  }
+
+  const JSONSymbol *sym = json_intern(p->interner, str, len);
+  if (buf != small) {
+    free(buf);
+  }
+  if (!sym) {
+    p->result.ok = false;
+    return;
+  }
 
-  if (p.vec_ctx->len == 0) {
-    parser->result = value;
+  hashmap_json_set_with_hash(map, sym->str, sym->len, sym->hash, value);
+}
+
+void json_merge_value(Parser *p, JSON value) {
+  if (p->vec_ctx->len == 0) {
+    value.ok = p->result.ok;
+    p->result = value;
     return;
   }
 
-  JSON current = vector_json_at(p.vec_ctx, -1);
-  switch (current.type) {
+  JSON *current = &p->vec_ctx->items[p->vec_ctx->len - 1];
+  switch (current->type) {
   case ARRAY:
-    vector_json_push(current.vec, value);
+    vector_json_push(current->vec, value);
     break;
   case OBJECT: {
-    const char **key = vector_str_pop(p.keys);
+    Token *key = vector_tok_pop(p->keys);
     if (!key) {
       return;
     }
-    hashmap_json_set(current.map, *key, value);
+
+    struct HashMapJSON *map = current->map;
+    if (p->interner) {
+      json_merge_interned(p, map, *key, value);
+      break;
+    }
+
+    // a map that copies its keys only needs them decoded
+    if (map->borrow_keys || key->escaped) {
+      StringView k = json_string(p, *key);
+      hashmap_json_set_n(map, k.str, k.len, value);
+      if (!map->borrow_keys && k.str != key->str) {
+        mem_free(p->arena, (void *)k.str);
+      }
+    } else {
+      hashmap_json_set_n(map, key->str, key->len, value);
+    }
     break;
   }
   default:
-    printf("[ERROR]: Unknown ctx type\n");
     break;
   }
 }
 
-JSON json_parse(const char *source) {
-  Parser p = {
-      .source = source,
-      .offset = 0,
-      .keys = vector_str_new(),
-      .vec_ctx = vector_json_new(),
-      .result = {.ok = true},
-  };
-
+// builds the tree of the validated tokens of `p'
+static JSON json_build(Parser *p) {
   Token t;
-  while ((t = scan_token(&p)), t.type != TOK_NONE) {
+  size_t start;
+  while ((start = p->index_pos), (t = scan_token(p)), t.type != TOK_NONE) {
     switch (t.type) {
     case TOK_WHITESPACE:
     case TOK_COLON:
     case TOK_COMMA:
       continue;
-    case TOK_BRACE_LEFT:
-      vector_json_push(p.vec_ctx,
-                       (JSON){.type = OBJECT, .map = hashmap_json_new()});
+    case TOK_BRACE_LEFT: {
+      struct HashMapJSON *map = hashmap_json_new_in(p->arena);
+      if (!map) {
+        p->error = (JSONError){JSON_ERROR_MEMORY, p->index.positions[start]};
+        p->result.ok = false;
+        return p->result;
+      }
+
+      // keys already live as long as the document
+      map->borrow_keys = p->arena || p->interner;
+      vector_json_push(p->vec_ctx, (JSON){.type = OBJECT, .map = map});
+      JSON_STATS_MAX(max_depth, p->vec_ctx->len);
       break;
+    }
     case TOK_BRACE_RIGHT: {
-      char next = match(&p, ",}]", true);
-
-      if (next == -1) {
-        printf("[ERROR]: Unterminated JSON objectx\n");
-        p.result.ok = false;
-        break;
+      JSON *object = vector_json_pop(p->vec_ctx);
+      if (!object || object->type != OBJECT) {
+        p->result.ok = false;
+        return p->result;
       }
 
-      json_merge_value(&p, *vector_json_pop(p.vec_ctx));
-
+      json_merge_value(p, *object);
       break;
     }
-    case TOK_BRACKET_LEFT:
-      vector_json_push(p.vec_ctx,
-                       (JSON){.type = ARRAY, .vec = vector_json_new()});
-      break;
-    case TOK_BRACKET_RIGHT:
-      json_merge_value(&p, *vector_json_pop(p.vec_ctx));
-      break;
-    case TOK_STRING: {
-      char next = match(&p, ":,}]", true);
+    case TOK_BRACKET_LEFT: {
+      struct VectorJSON *vec = vector_json_new_in(p->arena);
+      if (!vec) {
+        p->error = (JSONError){JSON_ERROR_MEMORY, p->index.positions[start]};
+        p->result.ok = false;
+        return p->result;
+      }
 
-      if (next == -1) {
-        printf("[ERROR]: Unterminated JSON object\n");
-        p.result.ok = false;
-        break;
+      vector_json_push(p->vec_ctx, (JSON){.type = ARRAY, .vec = vec});
+      JSON_STATS_MAX(max_depth, p->vec_ctx->len);
+      break;
+    }
+    case TOK_BRACKET_RIGHT: {
+      JSON *array = vector_json_pop(p->vec_ctx);
+      if (!array || array->type != ARRAY) {
+        p->result.ok = false;
+        return p->result;
       }
 
-      if (next == ':') {
-        vector_str_push(p.keys, t.str);
+      json_merge_value(p, *array);
+      break;
+    }
+    case TOK_STRING: {
+      if (match(p, ":") == ':') {
+        vector_tok_push(p->keys, t);
       } else {
-        json_merge_value(&p, (JSON){.type = STRING, .str = t.str});
+        StringView str = json_string(p, t);
+        json_merge_value(p, (JSON){.type = STRING,
+                                   .owned = !p->arena && str.str != t.str,
+                                   .str = str.str,
+                                   .len = str.len});
       }
 
       break;
     }
-    case TOK_NUMBER: {
-      char next = match(&p, ",}]", true);
-
-      if (next == -1) {
-        printf("[ERROR]: Unterminated JSON object\n");
-        p.result.ok = false;
-        break;
+    case TOK_NUMBER:
+    case TOK_INTEGER:
+    case TOK_UNSIGNED: {
+      if (t.type == TOK_INTEGER) {
+        json_merge_value(p, (JSON){.type = INTEGER, .i = t.i});
+      } else if (t.type == TOK_UNSIGNED) {
+        json_merge_value(p, (JSON){.type = UNSIGNED, .u = t.u});
+      } else {
+        json_merge_value(p, (JSON){.type = NUMBER, .d = t.d});
       }
-
-      json_merge_value(&p, (JSON){.type = NUMBER, .d = t.d});
       break;
     }
     case TOK_BOOLEAN:
+      json_merge_value(p, (JSON){.type = BOOLEAN, .b = t.b});
+      break;
+    case TOK_NULL:
+      json_merge_value(p, (JSON){.type = NIL});
       break;
     case TOK_NONE:
-      p.result.ok = false;
       break;
     }
   }
 
-  return p.result;
+  // the validator leaves bare words to `scan_scalar', so stopping before the
+  // end means one was neither a number nor a literal
+  if (start < p->index.len) {
+    p->error = (JSONError){JSON_ERROR_SCALAR, p->index.positions[start]};
+    p->result.ok = false;
+  }
+
+  return p->result;
+}
+
+JSON json_parse_indexed(Parser *p) {
+  // the grammar is checked up front so the builder only ever sees
+  // well-formed token sequences
+  JSON_STATS_TIMER(start);
+  Validator v;
+  validate_begin(&v, p->source, p->len, false);
+  v.max_depth = parser_max_depth(p);
+  bool valid =
+      validate_index(&v, p->index.positions, p->index_pos, p->index.len) &&
+      validate_end(&v);
+  JSON_STATS_ELAPSED(validate_ns, start);
+  if (!valid) {
+    p->error = v.error;
+    p->result.ok = false;
+    return p->result;
+  }
+
+  JSON_STATS_TIMER(built);
+  JSON result = json_build(p);
+  JSON_STATS_ELAPSED(build_ns, built);
+  return result;
+}
+
+static _Thread_local JSONError last_error;
+
+JSONError json_last_error(void) { return last_error; }
+
+void json_set_last_error(JSONError error) { last_error = error; }
+
+JSON json_parse_n(const char *source, size_t len, Arena *arena,
+                  unsigned flags) {
+  return json_parse_interned(source, len, arena, flags, NULL);
+}
+
+// indexes and parses the source `p' is set up for, onto empty stacks
+static JSON parse_document(Parser *p) {
+  JSON_STATS_BEGIN();
+  JSON result = {.ok = false};
+  if (!p->keys || !p->vec_ctx) {
+    p->error = (JSONError){JSON_ERROR_MEMORY, 0};
+  } else if (scanner_index(&p->index, p->source, p->len)) {
+    result = json_parse_indexed(p);
+  } else {
+    p->error = p->index.error;
+  }
+
+  // everything else that fails is an allocation
+  if (!result.ok && p->error.code == JSON_OK) {
+    p->error = (JSONError){JSON_ERROR_MEMORY, 0};
+  }
+  // containers left open by a rejected document are nobody's but ours
+  while (p->vec_ctx && p->vec_ctx->len > 0) {
+    json_free(*vector_json_pop(p->vec_ctx));
+  }
+  last_error = p->error;
+  JSON_STATS_ADD(documents, 1);
+  JSON_STATS_END();
+  return result;
+}
+
+JSON json_parse_interned(const char *source, size_t len, Arena *arena,
+                         unsigned flags, JSONInterner *interner) {
+  Parser p = {
+      .source = source,
+      .len = len,
+      .offset = 0,
+      .index = {.arena = arena},
+      .keys = vector_tok_new_in(arena),
+      .vec_ctx = vector_json_new_in(arena),
+      .arena = arena,
+      .flags = flags,
+      .interner = interner,
+      .result = {.ok = true},
+  };
+
+  JSON result = parse_document(&p);
+  scanner_index_free(&p.index);
+  vector_tok_free(p.keys);
+  vector_json_free(p.vec_ctx);
+  return result;
+}
+
+JSONParser *json_parser_new(size_t max_depth) {
+  JSONParser *parser = malloc(sizeof(JSONParser));
+  if (!parser) {
+    return NULL;
+  }
+
+  // the stacks outlive every arena a document is parsed into
+  *parser = (JSONParser){
+      .keys = vector_tok_new(),
+      .vec_ctx = vector_json_new(),
+      .max_depth = max_depth,
+  };
+  if (!parser->keys || !parser->vec_ctx) {
+    json_parser_free(parser);
+    return NULL;
+  }
+
+  return parser;
+}
+
+void json_parser_free(JSONParser *parser) {
+  if (!parser) {
+    return;
+  }
+
+  scanner_index_free(&parser->index);
+  vector_tok_free(parser->keys);
+  vector_json_free(parser->vec_ctx);
+  free(parser);
+}
+
+JSON json_parser_parse(JSONParser *parser, const char *source, size_t len,
+                       Arena *arena, unsigned flags) {
+  // a rejected document can leave keys behind
+  parser->keys->len = 0;
+
+  Parser p = {
+      .source = source,
+      .len = len,
+      .index = parser->index,
+      .keys = parser->keys,
+      .vec_ctx = parser->vec_ctx,
+      .arena = arena,
+      .flags = flags,
+      .interner = parser->interner,
+      .max_depth = parser->max_depth,
+      .result = {.ok = true},
+  };
+
+  JSON result = parse_document(&p);
+  // the index may have grown
+  parser->index = p.index;
+  parser->error = p.error;
+  return result;
+}
+
+void json_free(JSON json) {
+  switch (json.type) {
+  case OBJECT:
+    // arena documents are released all at once
+    if (json.map && !json.map->arena) {
+      hashmap_json_free(json.map);
+    }
+    break;
+  case ARRAY:
+    if (json.vec && !json.vec->arena) {
+      vector_json_free(json.vec);
+    }
+    break;
+  case STRING:
+    if (json.owned) {
+      mem_free(NULL, (void *)json.str);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+JSON json_parse_ex(const char *source, Arena *arena, unsigned flags) {
+  return json_parse_n(source, strlen(source), arena, flags);
+}
+
+JSON json_parse_arena(const char *source, Arena *arena) {
+  return json_parse_ex(source, arena, 0);
 }
 
-int main() {
+JSON json_parse(const char *source) { return json_parse_ex(source, NULL, 0); }
+
+// the library is linked into programs with their own `main'
+#ifndef JSON_NO_MAIN
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    JSONFile file = json_parse_file(argv[1]);
+    if (!file.json.ok) {
+      JSONError error = json_last_error();
+      fprintf(stderr, "[ERROR]: Could not parse %s: %s at offset %zu\n",
+              argv[1], json_error_string(error.code), error.offset);
+      json_file_close(&file);
+      return 1;
+    }
+
+    json_print(file.json);
+    json_file_close(&file);
+
+    if (JSON_STATS_ENABLED) {
+      JSONStats stats = json_stats_last();
+      char *dump = json_stats_dump(&stats, false, NULL);
+      if (dump) {
+        fputs(dump, stderr);
+        free(dump);
+      }
+    }
+    return 0;
+  }
+
   const char *json_str = "[{ \n"
                          "\"name\":\"John Doe\",\t\t\t"
                          "\"meta\":{\"tag\":589},"
                          "\"itemIds\": \t[10,20,30,40,50, \"literal\", [  { "
-                         "\"nested\" :  {\"itemId\" : 0x68 }}  ]]"
+                         "\"nested\" :  {\"itemId\" : 104 }}  ]]"
                          " } , {   \t \"id\"   :           \n\t 12345}]";
 
   JSON json = json_parse(json_str);
   json_print(json);
+  json_free(json);
 }
+#endif
@@ -1,24 +1,54 @@
+#include "arena.h"
 #include "hashmap.h"
+#include "scanner.h"
 #include "vector.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifndef JSON_H
+#define JSON_H
+
+typedef struct {
+  const char *str;
+  size_t len;
+} StringView;
 
 typedef struct {
   bool ok;
-  enum JSONType { OBJECT, ARRAY, STRING, NUMBER, BOOLEAN } type;
+  // `str' was allocated for this value alone and goes with it in `json_free'
+  bool owned;
+  enum JSONType {
+    OBJECT,
+    ARRAY,
+    STRING,
+    NUMBER,
+    // numbers without fraction or exponent, kept exact: `i', or `u' when
+    // they exceed INT64_MAX
+    INTEGER,
+    UNSIGNED,
+    BOOLEAN,
+    // `null'
+    NIL
+  } type;
   union {
     bool b;
     double d;
-    const char *str;
+    int64_t i;
+    uint64_t u;
+    // `str' is only NUL-terminated when the string was copied
+    struct {
+      const char *str;
+      size_t len;
+    };
+    // members keep insertion order up to `HASHMAP_SMALL_MAX', larger
+    // objects iterate, and are stringified, in hash table order, which
+    // changes with the random hash seed from run to run unless
+    // `json_hash_seed' fixes it
     struct HashMapJSON *map;
     struct VectorJSON *vec;
   };
 } JSON;
 
-DEFINE_HASHMAP(JSON, json, JSON, NULL)
-DEFINE_VECTOR(JSON, json, JSON, NULL)
-DEFINE_VECTOR(JSONPTR, jsonp, JSON *, NULL)
-DEFINE_VECTOR(String, str, const char *, NULL)
-
 typedef enum {
   TOK_WHITESPACE,
   TOK_BRACE_LEFT,
@@ -30,7 +60,10 @@ typedef enum {
 
   TOK_STRING,
   TOK_NUMBER,
+  TOK_INTEGER,
+  TOK_UNSIGNED,
   TOK_BOOLEAN,
+  TOK_NULL,
 
   TOK_NONE
 } TokenType;
@@ -40,14 +73,154 @@ typedef struct {
   union {
     bool b;
     double d;
-    const char *str;
+    int64_t i;
+    uint64_t u;
+    // raw contents between the quotes, `escaped' if it needs decoding
+    struct {
+      const char *str;
+      size_t len;
+      bool escaped;
+    };
   };
 } Token;
 
+/**
+ * Releases a document parsed without an arena along with everything it holds:
+ * nested objects and arrays, their keys and the strings that were copied. The
+ * memory goes back to the calling thread's pools, where the next parse picks
+ * it up, see `pool_trim'. Documents that failed to parse are fine too. Anything
+ * allocated from an arena is left alone, it goes with `arena_reset'.
+ */
+void json_free(JSON json);
+
+DEFINE_HASHMAP(JSON, json, JSON, json_free)
+DEFINE_VECTOR(JSON, json, JSON, json_free)
+DEFINE_VECTOR(JSONPTR, jsonp, JSON *, NULL)
+DEFINE_VECTOR(Token, tok, Token, NULL)
+
+// containers nested deeper than this are rejected. Parsers can lower the limit,
+// not raise it
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 1024
+#endif
+
+enum JSONFlags {
+  // strings and object keys point into the source buffer instead of being
+  // copied, only strings with escape sequences are decoded into new memory.
+  // The source must outlive the document. Without an arena, object keys are
+  // still copied, so that `json_free' can release every map the same way.
+  JSON_ZERO_COPY = 1 << 0,
+};
+
 typedef struct {
   size_t offset;
-  struct VectorString *keys;
+  size_t len;
+  StructuralIndex index;
+  size_t index_pos;
+  struct VectorToken *keys;
   struct VectorJSON *vec_ctx;
   const char *source;
+  Arena *arena;
+  unsigned flags;
+  // when set, object keys are interned and maps borrow the interned names
+  struct JSONInterner *interner;
   JSON result;
+  // why `result' is not ok
+  JSONError error;
+  // deepest nesting accepted, 0 for `JSON_MAX_DEPTH'
+  size_t max_depth;
 } Parser;
+
+static inline size_t parser_max_depth(const Parser *p) {
+  return p->max_depth && p->max_depth < JSON_MAX_DEPTH ? p->max_depth
+                                                       : JSON_MAX_DEPTH;
+}
+
+/**
+ * Parser state kept from one document to the next. The structural index and
+ * the context stacks are allocated once and only ever grow, so a run of
+ * documents parsed into arenas allocates nothing for bookkeeping once the
+ * largest and deepest of them was seen. Not thread-safe: keep one per thread
+ * or connection.
+ */
+typedef struct {
+  StructuralIndex index;
+  struct VectorToken *keys;
+  struct VectorJSON *vec_ctx;
+  size_t max_depth;
+  // when set, object keys are interned, see `json_parse_interned'
+  struct JSONInterner *interner;
+  // why the last document was rejected
+  JSONError error;
+} JSONParser;
+
+// parses without an arena, the result is released with `json_free'
+JSON json_parse(const char *source);
+
+/**
+ * Parses `source' allocating every string, object and array of the result
+ * from `arena'. The document lives until the arena is reset or freed, and a
+ * reset arena can be reused for the next document without touching the
+ * system allocator.
+ */
+JSON json_parse_arena(const char *source, Arena *arena);
+
+/**
+ * Same as `json_parse_arena' with a set of `JSONFlags'. `arena' may be NULL.
+ */
+JSON json_parse_ex(const char *source, Arena *arena, unsigned flags);
+
+/**
+ * Parses the `len' bytes at `source', which need no NUL terminator.
+ */
+JSON json_parse_n(const char *source, size_t len, Arena *arena,
+                  unsigned flags);
+
+// `max_depth' 0 is `JSON_MAX_DEPTH', larger limits are capped to it
+JSONParser *json_parser_new(size_t max_depth);
+void json_parser_free(JSONParser *parser);
+
+/**
+ * Same as `json_parse_n', reusing the index and stacks of `parser'. Sets
+ * `parser->error' as well as `json_last_error'.
+ */
+JSON json_parser_parse(JSONParser *parser, const char *source, size_t len,
+                       Arena *arena, unsigned flags);
+
+/**
+ * Validates and parses the tokens of `p->index' from `p->index_pos' up to
+ * `p->index.len'. The stacks, source and length of `p' must be set up, the
+ * index is not freed. A rejected document sets `p->error'.
+ */
+JSON json_parse_indexed(Parser *p);
+
+/**
+ * Why the last document parsed by this thread through `json_parse' or one of
+ * its variants was rejected, `JSON_OK' when it was not.
+ */
+JSONError json_last_error(void);
+// for parsers built on `json_parse_indexed' that report like `json_parse'
+void json_set_last_error(JSONError error);
+
+void json_print(JSON json);
+
+// next token from the parser's structural index
+Token scan_token(Parser *p);
+
+/**
+ * Token for the number or literal spanning exactly the `len' bytes at
+ * `start', `TOK_NONE' when they are neither.
+ */
+Token scan_scalar(const char *start, size_t len);
+
+// adds a finished value to the innermost open container, or makes it the
+// result when none is open
+void json_merge_value(Parser *parser, JSON value);
+
+/**
+ * Decodes the escape sequences of the `len' bytes at `src' into `dst', which
+ * must hold `len' bytes. Returns the decoded length.
+ */
+size_t json_unescape(char *dst, const char *src, size_t len);
+
+#endif
@@ -0,0 +1,308 @@
+#include "lazy.h"
+#include "validate.h"
+
+static const JSONCursor NONE = {0};
+
+// character of index entry `pos', '\0' past the end
+static inline char lazy_char(const JSONDoc *doc, size_t pos) {
+  const Parser *p = &doc->parser;
+  return pos < p->index.len ? p->source[p->index.positions[pos]] : '\0';
+}
+
+static inline Token lazy_token(const JSONDoc *doc, size_t pos) {
+  Parser p = doc->parser;
+  p.index_pos = pos;
+  return scan_token(&p);
+}
+
+// index entry just past the value starting at `pos'
+static size_t lazy_skip(const JSONDoc *doc, size_t pos) {
+  char c = lazy_char(doc, pos);
+  if (c != '{' && c != '[') {
+    return pos + 1;
+  }
+
+  // string contents are not indexed, so every bracket seen is structural
+  const Parser *p = &doc->parser;
+  size_t depth = 0;
+  for (; pos < p->index.len; pos++) {
+    c = p->source[p->index.positions[pos]];
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      return pos + 1;
+    }
+  }
+
+  return pos;
+}
+
+// the value at `pos', moved past the name when it is an object member
+static inline JSONCursor lazy_member(const JSONDoc *doc, size_t pos) {
+  if (lazy_char(doc, pos) == '"' && lazy_char(doc, pos + 1) == ':') {
+    pos += 2;
+  }
+
+  char c = lazy_char(doc, pos);
+  if (!c || c == ',' || c == ':' || c == '}' || c == ']') {
+    return NONE;
+  }
+
+  return (JSONCursor){doc, pos};
+}
+
+static bool lazy_string(const JSONDoc *doc, size_t pos, StringView *out,
+                        Arena *arena) {
+  if (lazy_char(doc, pos) != '"') {
+    return false;
+  }
+
+  Token t = lazy_token(doc, pos);
+  if (t.type != TOK_STRING) {
+    return false;
+  }
+  if (!t.escaped) {
+    *out = (StringView){t.str, t.len};
+    return true;
+  }
+  if (!arena) {
+    return false;
+  }
+
+  char *str = arena_alloc(arena, t.len + 1);
+  if (!str) {
+    return false;
+  }
+
+  size_t len = json_unescape(str, t.str, t.len);
+  str[len] = '\0';
+  *out = (StringView){str, len};
+  return true;
+}
+
+// compares the member name at `pos' without allocating
+static bool lazy_key_equals(const JSONDoc *doc, size_t pos, const char *key,
+                            size_t len) {
+  Token t = lazy_token(doc, pos);
+  if (t.type != TOK_STRING) {
+    return false;
+  }
+  if (!t.escaped) {
+    return t.len == len && memcmp(t.str, key, len) == 0;
+  }
+
+  // a decoded name is never longer than its source
+  if (len > t.len) {
+    return false;
+  }
+
+  char small[256];
+  char *buf = t.len <= sizeof(small) ? small : malloc(t.len);
+  if (!buf) {
+    return false;
+  }
+
+  bool equal = json_unescape(buf, t.str, t.len) == len &&
+               memcmp(buf, key, len) == 0;
+  if (buf != small) {
+    free(buf);
+  }
+
+  return equal;
+}
+
+bool json_doc_open(JSONDoc *doc, const char *source, size_t len) {
+  *doc = (JSONDoc){.parser = {.source = source, .len = len}};
+  Parser *p = &doc->parser;
+  if (!scanner_index(&p->index, source, len)) {
+    p->error = p->index.error;
+    return false;
+  }
+
+  // walking the index relies on it being well formed, the bare words are
+  // left for when they are visited
+  Validator v;
+  validate_begin(&v, source, len, false);
+  doc->ok = validate_index(&v, p->index.positions, 0, p->index.len) &&
+            validate_end(&v);
+  p->error = v.error;
+  return doc->ok;
+}
+
+void json_doc_close(JSONDoc *doc) {
+  scanner_index_free(&doc->parser.index);
+  *doc = (JSONDoc){0};
+}
+
+JSONCursor json_doc_root(const JSONDoc *doc) {
+  return doc->ok ? lazy_member(doc, 0) : NONE;
+}
+
+enum JSONType json_cursor_type(JSONCursor c) {
+  switch (lazy_char(c.doc, c.pos)) {
+  case '{':
+    return OBJECT;
+  case '[':
+    return ARRAY;
+  case '"':
+    return STRING;
+  default:
+    switch (lazy_token(c.doc, c.pos).type) {
+    case TOK_INTEGER:
+      return INTEGER;
+    case TOK_UNSIGNED:
+      return UNSIGNED;
+    case TOK_BOOLEAN:
+      return BOOLEAN;
+    case TOK_NULL:
+      return NIL;
+    default:
+      return NUMBER;
+    }
+  }
+}
+
+JSONCursor json_cursor_find(JSONCursor c, const char *key, size_t len) {
+  if (!c.doc || lazy_char(c.doc, c.pos) != '{') {
+    return NONE;
+  }
+
+  // the last of duplicate keys wins, as it does in a parsed tree
+  JSONCursor found = NONE;
+  size_t pos = c.pos + 1;
+  while (lazy_char(c.doc, pos) == '"' && lazy_char(c.doc, pos + 1) == ':') {
+    if (lazy_key_equals(c.doc, pos, key, len)) {
+      found = lazy_member(c.doc, pos);
+    }
+
+    pos = lazy_skip(c.doc, pos + 2);
+    if (lazy_char(c.doc, pos) != ',') {
+      break;
+    }
+    pos++;
+  }
+
+  return found;
+}
+
+JSONCursor json_cursor_at(JSONCursor c, size_t index) {
+  if (!c.doc || lazy_char(c.doc, c.pos) != '[') {
+    return NONE;
+  }
+
+  c = json_cursor_child(c);
+  while (c.doc && index-- > 0) {
+    c = json_cursor_next(c);
+  }
+
+  return c;
+}
+
+JSONCursor json_cursor_child(JSONCursor c) {
+  if (!c.doc) {
+    return NONE;
+  }
+
+  char open = lazy_char(c.doc, c.pos);
+  if (open != '{' && open != '[') {
+    return NONE;
+  }
+
+  return lazy_member(c.doc, c.pos + 1);
+}
+
+JSONCursor json_cursor_next(JSONCursor c) {
+  if (!c.doc) {
+    return NONE;
+  }
+
+  size_t pos = lazy_skip(c.doc, c.pos);
+  if (lazy_char(c.doc, pos) != ',') {
+    return NONE;
+  }
+
+  return lazy_member(c.doc, pos + 1);
+}
+
+bool json_cursor_string(JSONCursor c, StringView *out, Arena *arena) {
+  return c.doc && lazy_string(c.doc, c.pos, out, arena);
+}
+
+bool json_cursor_key(JSONCursor c, StringView *out, Arena *arena) {
+  return c.doc && c.pos >= 2 && lazy_char(c.doc, c.pos - 1) == ':' &&
+         lazy_string(c.doc, c.pos - 2, out, arena);
+}
+
+// the scalar at `c' tokenized, `TOK_NONE' for anything else
+static Token lazy_scalar(JSONCursor c) {
+  char first = c.doc ? lazy_char(c.doc, c.pos) : '\0';
+  if (!first || strchr("{}[]:,\"", first)) {
+    return (Token){.type = TOK_NONE};
+  }
+
+  return lazy_token(c.doc, c.pos);
+}
+
+bool json_cursor_double(JSONCursor c, double *out) {
+  Token t = lazy_scalar(c);
+  switch (t.type) {
+  case TOK_NUMBER:
+    *out = t.d;
+    return true;
+  case TOK_INTEGER:
+    *out = (double)t.i;
+    return true;
+  case TOK_UNSIGNED:
+    *out = (double)t.u;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool json_cursor_int64(JSONCursor c, int64_t *out) {
+  Token t = lazy_scalar(c);
+  if (t.type != TOK_INTEGER) {
+    return false;
+  }
+
+  *out = t.i;
+  return true;
+}
+
+bool json_cursor_uint64(JSONCursor c, uint64_t *out) {
+  Token t = lazy_scalar(c);
+  if (t.type == TOK_UNSIGNED || (t.type == TOK_INTEGER && t.i >= 0)) {
+    *out = t.u;
+    return true;
+  }
+
+  return false;
+}
+
+JSON json_cursor_value(JSONCursor c, Arena *arena, unsigned flags) {
+  if (!c.doc) {
+    return (JSON){.ok = false};
+  }
+
+  // parse just the index entries of this value
+  size_t end = lazy_skip(c.doc, c.pos);
+  Parser p = {
+      .source = c.doc->parser.source,
+      .len = end < c.doc->parser.index.len
+                 ? c.doc->parser.index.positions[end]
+                 : c.doc->parser.len,
+      .index = {.positions = c.doc->parser.index.positions, .len = end},
+      .index_pos = c.pos,
+      .keys = vector_tok_new_in(arena),
+      .vec_ctx = vector_json_new_in(arena),
+      .arena = arena,
+      .flags = flags,
+      .result = {.ok = true},
+  };
+
+  JSON json = json_parse_indexed(&p);
+  vector_tok_free(p.keys);
+  vector_json_free(p.vec_ctx);
+  return json;
+}
@@ -0,0 +1,76 @@
+#include "json.h"
+
+#ifndef LAZY_H
+#define LAZY_H
+
+/**
+ * On-demand access to a document. Only the structural index is built up
+ * front, values are then located by walking it and decoded when asked for.
+ * A subtree that is never visited costs a skip over its index entries and
+ * no allocation. The structure is checked when the document is opened,
+ * numbers, literals and escapes only in the values that are visited.
+ */
+typedef struct {
+  // only the source and the index are used
+  Parser parser;
+  bool ok;
+} JSONDoc;
+
+/**
+ * Position of a value in a `JSONDoc'. Cursors are plain values, copying one
+ * is free. A failed lookup gives a cursor with a NULL `doc'.
+ */
+typedef struct {
+  const JSONDoc *doc;
+  // index entry of the value's first token
+  size_t pos;
+} JSONCursor;
+
+/**
+ * Indexes the `len' bytes at `source', which must outlive the document.
+ * Returns false with `doc->parser.error' set when they cannot be indexed or
+ * are not well formed.
+ */
+bool json_doc_open(JSONDoc *doc, const char *source, size_t len);
+void json_doc_close(JSONDoc *doc);
+
+JSONCursor json_doc_root(const JSONDoc *doc);
+
+static inline bool json_cursor_ok(JSONCursor c) { return c.doc != NULL; }
+
+// type of the value at a valid cursor `c', numbers are scanned to tell them
+// apart
+enum JSONType json_cursor_type(JSONCursor c);
+
+// value of member `key' of the object at `c', the last one when the key is
+// repeated, like the tree `json_parse' builds
+JSONCursor json_cursor_find(JSONCursor c, const char *key, size_t len);
+// element `index' of the array at `c'
+JSONCursor json_cursor_at(JSONCursor c, size_t index);
+// first element of an array, or value of the first member of an object
+JSONCursor json_cursor_child(JSONCursor c);
+// element or member value after `c' in the same container
+JSONCursor json_cursor_next(JSONCursor c);
+
+/**
+ * Contents of the string at `c', or the name of the member whose value is at
+ * `c' for `json_cursor_key'. They point into the source unless they contain
+ * escape sequences, which are decoded into `arena'. Returns false when there
+ * is no such string, or it needs decoding and `arena' is NULL.
+ */
+bool json_cursor_string(JSONCursor c, StringView *out, Arena *arena);
+bool json_cursor_key(JSONCursor c, StringView *out, Arena *arena);
+
+// the number at `c', false when it is none or does not fit
+bool json_cursor_double(JSONCursor c, double *out);
+bool json_cursor_int64(JSONCursor c, int64_t *out);
+bool json_cursor_uint64(JSONCursor c, uint64_t *out);
+
+/**
+ * Builds the `JSON' tree of the value at `c', like `json_parse_ex' would for
+ * just that part of the source. Without an arena it is released with
+ * `json_free'.
+ */
+JSON json_cursor_value(JSONCursor c, Arena *arena, unsigned flags);
+
+#endif
@@ -0,0 +1,726 @@
+#include "number.h"
+#include "number_table.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ||    \
+    defined(_WIN32)
+#define NUMBER_SWAR
+#endif
+
+static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+
+#ifdef NUMBER_SWAR
+static inline uint64_t load8(const char *s) {
+  uint64_t v;
+  memcpy(&v, s, sizeof(v));
+  return v;
+}
+
+// all eight bytes are in '0'..'9'
+static inline bool is_eight_digits(uint64_t v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0) |
+          ((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4) ==
+         0x3333333333333333;
+}
+
+// value of eight ASCII digits, combining pairs, then quads, then halves
+static inline uint32_t parse_eight_digits(uint64_t v) {
+  const uint64_t mask = 0x000000FF000000FF;
+  const uint64_t mul1 = 0x000F424000000064; // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+
+  v -= 0x3030303030303030;
+  v = v * 10 + (v >> 8);
+  v = ((v & mask) * mul1 + (v >> 16 & mask) * mul2) >> 32;
+  return (uint32_t)v;
+}
+#endif
+
+// accumulates a run of digits into `w', which wraps past 19 digits
+static inline const char *parse_digits(const char *s, const char *end,
+                                       uint64_t *w) {
+#ifdef NUMBER_SWAR
+  while (end - s >= 8 && is_eight_digits(load8(s))) {
+    *w = *w * 100000000 + parse_eight_digits(load8(s));
+    s += 8;
+  }
+#endif
+  for (; s < end && is_digit(*s); s++) {
+    *w = *w * 10 + (uint64_t)(*s - '0');
+  }
+
+  return s;
+}
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128;
+#endif
+
+static inline void mul128(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo) {
+#ifdef __SIZEOF_INT128__
+  uint128 r = (uint128)a * b;
+  *hi = (uint64_t)(r >> 64);
+  *lo = (uint64_t)r;
+#else
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+  uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  *lo = mid << 32 | (uint32_t)ll;
+#endif
+}
+
+static inline int clz64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  for (; !(x & 1ULL << 63); x <<= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+// Eisel-Lemire: w * 10^q rounded to the nearest double from a 128-bit
+// approximation of 5^q. Gives up on the rare inputs where the approximation
+// cannot decide the rounding, or the result is subnormal or infinite.
+static bool eisel_lemire(uint64_t w, int64_t q, bool negative, double *out) {
+  const uint64_t *pow5 = NUMBER_POW5[q - NUMBER_POW5_MIN];
+
+  // floor(log2(10^q)) + the bias and the shift of the product
+  int64_t exponent = ((152170 + 65536) * q >> 16) + 1024 + 63;
+  int lz = clz64(w);
+  w <<= lz;
+
+  uint64_t hi, lo;
+  mul128(w, pow5[0], &hi, &lo);
+
+  // the truncated bits may carry into the 55 bits that are kept
+  if ((hi & 0x1FF) == 0x1FF) {
+    uint64_t hi2, lo2;
+    mul128(w, pow5[1], &hi2, &lo2);
+    lo += hi2;
+    hi += lo < hi2;
+    if (lo == UINT64_MAX) {
+      return false;
+    }
+  }
+
+  uint64_t upper_bit = hi >> 63;
+  uint64_t mantissa = hi >> (upper_bit + 9);
+  lz += (int)(1 ^ upper_bit);
+
+  // exactly halfway between two doubles
+  if (lo == 0 && (hi & 0x1FF) == 0 && (mantissa & 3) == 1) {
+    return false;
+  }
+
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  if (mantissa >= 1ULL << 53) {
+    mantissa = 1ULL << 52;
+    lz--;
+  }
+  mantissa &= ~(1ULL << 52);
+
+  int64_t biased = exponent - lz;
+  if (biased < 1 || biased > 2046) {
+    return false;
+  }
+
+  uint64_t bits = mantissa | (uint64_t)biased << 52 | (uint64_t)negative << 63;
+  memcpy(out, &bits, sizeof(double));
+  return true;
+}
+
+// Simple decimal conversion, for the inputs the fast paths cannot round. The
+// digits are shifted by powers of two until the 53 bits of the mantissa can
+// be read off, as fast_float and Go's strconv do. Exact for the first
+// `DECIMAL_DIGITS' significant digits, which is more than a double needs to
+// round correctly. Unlike strtod, it does not depend on the locale and needs
+// no terminated copy.
+#define DECIMAL_DIGITS 800
+// the most a 64-bit accumulator of digits can be shifted by at once
+#define DECIMAL_SHIFT 60
+
+typedef struct {
+  // digit values, with room for the digits a left shift adds
+  uint8_t d[DECIMAL_DIGITS + 20];
+  // the value is 0.d[0] d[1] ... d[nd - 1] * 10^dp
+  int nd;
+  int dp;
+  // nonzero digits were dropped past `DECIMAL_DIGITS'
+  bool trunc;
+} Decimal;
+
+static void decimal_trim(Decimal *a) {
+  while (a->nd > 0 && a->d[a->nd - 1] == 0) {
+    a->nd--;
+  }
+  if (a->nd == 0) {
+    a->dp = 0;
+  }
+}
+
+// divides by 2^k
+static void decimal_right_shift(Decimal *a, unsigned k) {
+  int r = 0, w = 0;
+  uint64_t n = 0;
+
+  // enough leading digits for the first quotient digit
+  for (; n >> k == 0; r++) {
+    if (r >= a->nd) {
+      if (n == 0) {
+        a->nd = 0;
+        return;
+      }
+      for (; n >> k == 0; r++) {
+        n *= 10;
+      }
+      break;
+    }
+    n = n * 10 + a->d[r];
+  }
+  a->dp -= r - 1;
+
+  uint64_t mask = (1ULL << k) - 1;
+  for (; r < a->nd; r++) {
+    a->d[w++] = (uint8_t)(n >> k);
+    n = (n & mask) * 10 + a->d[r];
+  }
+  while (n > 0) {
+    uint8_t digit = (uint8_t)(n >> k);
+    n = (n & mask) * 10;
+    if (w < DECIMAL_DIGITS) {
+      a->d[w++] = digit;
+    } else if (digit) {
+      a->trunc = true;
+    }
+  }
+
+  a->nd = w;
+  decimal_trim(a);
+}
+
+// multiplies by 2^k
+static void decimal_left_shift(Decimal *a, unsigned k) {
+  // 2^k adds floor(k * log10(2)) digits, or one more, which is made room for
+  // and moved over when it is not needed
+  int delta = (int)(k * 1233 >> 12) + 1;
+  int w = a->nd + delta;
+  uint64_t n = 0;
+
+  for (int r = a->nd - 1; r >= 0; r--) {
+    n += (uint64_t)a->d[r] << k;
+    a->d[--w] = (uint8_t)(n % 10);
+    n /= 10;
+  }
+  while (n > 0) {
+    a->d[--w] = (uint8_t)(n % 10);
+    n /= 10;
+  }
+  if (w > 0) {
+    delta -= w;
+    memmove(a->d, a->d + w, (size_t)(a->nd + delta));
+  }
+
+  a->nd += delta;
+  a->dp += delta;
+  if (a->nd > DECIMAL_DIGITS) {
+    for (int i = DECIMAL_DIGITS; i < a->nd; i++) {
+      a->trunc |= a->d[i] != 0;
+    }
+    a->nd = DECIMAL_DIGITS;
+  }
+  decimal_trim(a);
+}
+
+static void decimal_shift(Decimal *a, int k) {
+  if (a->nd == 0) {
+    return;
+  }
+  for (; k > DECIMAL_SHIFT; k -= DECIMAL_SHIFT) {
+    decimal_left_shift(a, DECIMAL_SHIFT);
+  }
+  for (; k < -DECIMAL_SHIFT; k += DECIMAL_SHIFT) {
+    decimal_right_shift(a, DECIMAL_SHIFT);
+  }
+  if (k > 0) {
+    decimal_left_shift(a, (unsigned)k);
+  } else if (k < 0) {
+    decimal_right_shift(a, (unsigned)-k);
+  }
+}
+
+// the integer part, rounded half to even on the digits that follow
+static uint64_t decimal_round(const Decimal *a) {
+  uint64_t n = 0;
+  int i = 0;
+  for (; i < a->dp && i < a->nd; i++) {
+    n = n * 10 + a->d[i];
+  }
+  for (; i < a->dp; i++) {
+    n *= 10;
+  }
+
+  if (a->dp >= 0 && a->dp < a->nd) {
+    uint8_t next = a->d[a->dp];
+    if (next == 5 && a->dp + 1 == a->nd) {
+      // digits dropped past the limit put it above the halfway point
+      n += a->trunc || (n & 1);
+    } else {
+      n += next >= 5;
+    }
+  }
+
+  return n;
+}
+
+// the bits of `a * 10^dp' without the sign
+static uint64_t decimal_bits(Decimal *a, int64_t dp) {
+  // the shifts that bring 10^i down to [0.5, 1), at most 27 bits at a time
+  static const int POW2_STEPS[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+  const int steps = sizeof(POW2_STEPS) / sizeof(POW2_STEPS[0]);
+  const uint64_t infinity = 0x7FFULL << 52;
+
+  if (a->nd == 0 || dp < -330) {
+    return 0;
+  }
+  if (dp > 310) {
+    return infinity;
+  }
+  a->dp = (int)dp;
+
+  // scale into [0.5, 1), keeping the binary exponent of the leading bit
+  int exponent = 0;
+  while (a->dp > 0) {
+    int n = a->dp >= steps ? 27 : POW2_STEPS[a->dp];
+    decimal_shift(a, -n);
+    exponent += n;
+  }
+  while (a->dp < 0 || (a->dp == 0 && a->d[0] < 5)) {
+    int n = -a->dp >= steps ? 27 : POW2_STEPS[-a->dp];
+    decimal_shift(a, n);
+    exponent -= n;
+  }
+
+  // to [1, 2), with the subnormals at the smallest exponent
+  exponent--;
+  if (exponent < -1022) {
+    decimal_shift(a, exponent + 1022);
+    exponent = -1022;
+  }
+  if (exponent > 1023) {
+    return infinity;
+  }
+
+  decimal_shift(a, 53);
+  uint64_t mantissa = decimal_round(a);
+  // rounding up may carry into another bit
+  if (mantissa == 1ULL << 53) {
+    mantissa >>= 1;
+    if (++exponent > 1023) {
+      return infinity;
+    }
+  }
+
+  // subnormals have a biased exponent of 0
+  if (!(mantissa & 1ULL << 52)) {
+    return mantissa;
+  }
+  return (mantissa & ((1ULL << 52) - 1)) | (uint64_t)(exponent + 1023) << 52;
+}
+
+static double number_slow(const char *start, size_t len) {
+  const char *s = start;
+  const char *end = start + len;
+  bool negative = *s == '-';
+  s += negative;
+
+  // the grammar was checked by `scan_number', only the digits are read
+  Decimal a;
+  a.nd = 0;
+  a.trunc = false;
+  int64_t seen = 0, point = -1, leading = 0;
+  for (; s < end && (is_digit(*s) || *s == '.'); s++) {
+    if (*s == '.') {
+      point = seen;
+    } else if (*s == '0' && seen == 0) {
+      leading += point >= 0;
+    } else {
+      seen++;
+      if (a.nd < DECIMAL_DIGITS) {
+        a.d[a.nd++] = (uint8_t)(*s - '0');
+      } else if (*s != '0') {
+        a.trunc = true;
+      }
+    }
+  }
+
+  int64_t dp = (point >= 0 ? point : seen) - leading;
+  if (s < end) {
+    s++;
+    bool negative_exp = *s == '-';
+    s += *s == '-' || *s == '+';
+    int64_t e = 0;
+    for (; s < end; s++) {
+      // saturate, as `scan_number' does
+      if (e < 100000) {
+        e = e * 10 + (*s - '0');
+      }
+    }
+    dp += negative_exp ? -e : e;
+  }
+
+  uint64_t bits = decimal_bits(&a, dp) | (uint64_t)negative << 63;
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+size_t number_length(const char *start, size_t len) {
+  const char *s = start;
+  const char *end = start + len;
+
+  s += s < end && *s == '-';
+  const char *digits = s;
+  while (s < end && is_digit(*s)) {
+    s++;
+  }
+  if (s == digits || (*digits == '0' && s - digits > 1)) {
+    return 0;
+  }
+
+  if (s < end && *s == '.') {
+    const char *fraction = ++s;
+    while (s < end && is_digit(*s)) {
+      s++;
+    }
+    if (s == fraction) {
+      return 0;
+    }
+  }
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    s++;
+    s += s < end && (*s == '-' || *s == '+');
+    const char *exp_digits = s;
+    while (s < end && is_digit(*s)) {
+      s++;
+    }
+    if (s == exp_digits) {
+      return 0;
+    }
+  }
+
+  return s - start;
+}
+
+Token scan_number(const char *start, size_t len) {
+  const char *s = start;
+  const char *end = start + len;
+  const Token none = {.type = TOK_NONE};
+
+  bool negative = s < end && *s == '-';
+  s += negative;
+
+  // -?(0|[1-9][0-9]*)
+  const char *digits = s;
+  uint64_t w = 0;
+  s = parse_digits(s, end, &w);
+  size_t count = s - digits;
+  if (count == 0 || (count > 1 && *digits == '0')) {
+    return none;
+  }
+
+  // (\.[0-9]+)?
+  int64_t q = 0;
+  bool integer = true;
+  if (s < end && *s == '.') {
+    const char *fraction = ++s;
+    s = parse_digits(s, end, &w);
+    if (s == fraction) {
+      return none;
+    }
+
+    q = -(int64_t)(s - fraction);
+    count += s - fraction;
+    integer = false;
+  }
+
+  // ([eE][+-]?[0-9]+)?
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    s++;
+    bool negative_exp = s < end && *s == '-';
+    s += s < end && (*s == '-' || *s == '+');
+
+    const char *exp_digits = s;
+    int64_t e = 0;
+    for (; s < end && is_digit(*s); s++) {
+      // saturate, the result is 0 or infinite long before
+      if (e < 100000) {
+        e = e * 10 + (*s - '0');
+      }
+    }
+    if (s == exp_digits) {
+      return none;
+    }
+
+    q += negative_exp ? -e : e;
+    integer = false;
+  }
+
+  if (s != end) {
+    return none;
+  }
+
+  // leading zeros of the fraction are not significant
+  if (count > 19) {
+    const char *p = digits;
+    while (p < end && (*p == '0' || *p == '.')) {
+      p++;
+    }
+
+    count = 0;
+    for (; p < end && (is_digit(*p) || *p == '.'); p++) {
+      count += *p != '.';
+    }
+  }
+
+  if (integer) {
+    // 20 digits may still fit, once checked without wrapping
+    if (count == 20) {
+      uint64_t head = 0;
+      parse_digits(digits, digits + 19, &head);
+      uint64_t last = (uint64_t)(digits[19] - '0');
+      count = head > (UINT64_MAX - last) / 10 ? 21 : 19;
+    }
+
+    if (count <= 19 && negative && w <= (uint64_t)INT64_MAX + 1) {
+      return (Token){.type = TOK_INTEGER, .i = (int64_t)(0 - w)};
+    }
+    if (count <= 19 && !negative) {
+      if (w <= INT64_MAX) {
+        return (Token){.type = TOK_INTEGER, .i = (int64_t)w};
+      }
+      return (Token){.type = TOK_UNSIGNED, .u = w};
+    }
+  }
+
+  double d;
+  if (count > 19) {
+    d = number_slow(start, len);
+  } else if (w == 0) {
+    d = negative ? -0.0 : 0.0;
+  } else if (q >= -22 && q <= 22 && w <= 1ULL << 53) {
+    // both operands are exact, so a single rounding gives the right result
+    d = (double)w;
+    d = q < 0 ? d / POW10[-q] : d * POW10[q];
+    d = negative ? -d : d;
+  } else if (q < NUMBER_POW5_MIN || q > NUMBER_POW5_MAX ||
+             !eisel_lemire(w, q, negative, &d)) {
+    d = number_slow(start, len);
+  }
+
+  return (Token){.type = TOK_NUMBER, .d = d};
+}
+
+// Grisu2: the shortest digits within the rounding interval of a double,
+// computed with 64-bit fixed point floats `f * 2^e'. Always round-trips,
+// and is the shortest representation for all but a tiny fraction of inputs.
+typedef struct {
+  uint64_t f;
+  int e;
+} DiyFp;
+
+static const uint32_t POW10_32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+static inline DiyFp diy_mul(DiyFp x, DiyFp y) {
+  uint64_t hi, lo;
+  mul128(x.f, y.f, &hi, &lo);
+  // round the dropped half
+  return (DiyFp){hi + (lo >> 63), x.e + y.e + 64};
+}
+
+static inline DiyFp diy_normalize(DiyFp x) {
+  int lz = clz64(x.f);
+  return (DiyFp){x.f << lz, x.e - lz};
+}
+
+static inline int count_digits(uint32_t n) {
+  int k = 1;
+  while (k < 10 && n >= POW10_32[k]) {
+    k++;
+  }
+  return k;
+}
+
+static inline void grisu_round(char *buf, int len, uint64_t delta,
+                               uint64_t rest, uint64_t ten_kappa,
+                               uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+// digits of `value' into `buf', returning their count. `*k' becomes the
+// decimal exponent of the last one.
+static int grisu2(double value, char *buf, int *k) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(double));
+
+  const uint64_t hidden = 1ULL << 52;
+  int biased = (int)(bits >> 52 & 0x7FF);
+  DiyFp v = {bits & (hidden - 1), -1074};
+  if (biased) {
+    v = (DiyFp){v.f | hidden, biased - 1075};
+  }
+
+  // boundaries halfway to the neighbouring doubles, on the same exponent
+  DiyFp plus = diy_normalize((DiyFp){(v.f << 1) + 1, v.e - 1});
+  DiyFp minus = v.f == hidden ? (DiyFp){(v.f << 2) - 1, v.e - 2}
+                              : (DiyFp){(v.f << 1) - 1, v.e - 1};
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  // a cached power of ten that brings the exponent into [-60, -32]
+  double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+  int ki = (int)dk;
+  if (dk - ki > 0.0) {
+    ki++;
+  }
+  int index = (ki >> 3) + 1;
+  *k = -(NUMBER_CACHED_MIN + index * 8);
+  DiyFp c = {NUMBER_CACHED_POWERS[index].f, NUMBER_CACHED_POWERS[index].e};
+
+  DiyFp w = diy_mul(diy_normalize(v), c);
+  DiyFp wp = diy_mul(plus, c);
+  DiyFp wm = diy_mul(minus, c);
+  wm.f++;
+  wp.f--;
+
+  uint64_t delta = wp.f - wm.f;
+  uint64_t wp_w = wp.f - w.f;
+  DiyFp one = {1ULL << -wp.e, wp.e};
+  uint32_t p1 = (uint32_t)(wp.f >> -one.e);
+  uint64_t p2 = wp.f & (one.f - 1);
+  int kappa = count_digits(p1);
+  int len = 0;
+
+  while (kappa > 0) {
+    uint32_t d = p1 / POW10_32[kappa - 1];
+    p1 %= POW10_32[kappa - 1];
+    if (d || len) {
+      buf[len++] = (char)('0' + d);
+    }
+    kappa--;
+
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      grisu_round(buf, len, delta, rest, (uint64_t)POW10_32[kappa] << -one.e,
+                  wp_w);
+      return len;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> -one.e);
+    if (d || len) {
+      buf[len++] = (char)('0' + d);
+    }
+    p2 &= one.f - 1;
+    kappa--;
+
+    if (p2 < delta) {
+      *k += kappa;
+      grisu_round(buf, len, delta, p2, one.f,
+                  -kappa < 10 ? wp_w * POW10_32[-kappa] : 0);
+      return len;
+    }
+  }
+}
+
+size_t json_format_double(char *dst, double value) {
+  char *out = dst;
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(double));
+
+  // JSON has no representation for them
+  if ((bits >> 52 & 0x7FF) == 0x7FF) {
+    memcpy(dst, "null", 4);
+    return 4;
+  }
+
+  if (bits >> 63) {
+    *out++ = '-';
+  }
+  if (!(bits << 1)) {
+    memcpy(out, "0.0", 3);
+    return out + 3 - dst;
+  }
+
+  char digits[20];
+  int k;
+  int len = grisu2(value < 0 ? -value : value, digits, &k);
+  // position of the decimal point relative to the digits
+  int point = len + k;
+
+  if (point > 0 && point <= 21) {
+    if (len <= point) {
+      // keep a fraction, so it reads back as a double
+      memcpy(out, digits, len);
+      memset(out + len, '0', point - len);
+      memcpy(out + point, ".0", 2);
+      return out + point + 2 - dst;
+    }
+
+    memcpy(out, digits, point);
+    out[point] = '.';
+    memcpy(out + point + 1, digits + point, len - point);
+    return out + len + 1 - dst;
+  }
+
+  if (point > -6 && point <= 0) {
+    memcpy(out, "0.", 2);
+    memset(out + 2, '0', -point);
+    memcpy(out + 2 - point, digits, len);
+    return out + 2 - point + len - dst;
+  }
+
+  *out++ = digits[0];
+  if (len > 1) {
+    *out++ = '.';
+    memcpy(out, digits + 1, len - 1);
+    out += len - 1;
+  }
+
+  int exp = point - 1;
+  *out++ = 'e';
+  if (exp < 0) {
+    *out++ = '-';
+    exp = -exp;
+  }
+  if (exp >= 100) {
+    *out++ = (char)('0' + exp / 100);
+    exp %= 100;
+    *out++ = (char)('0' + exp / 10);
+  } else if (exp >= 10) {
+    *out++ = (char)('0' + exp / 10);
+  }
+  *out++ = (char)('0' + exp % 10);
+
+  return out - dst;
+}
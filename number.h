@@ -0,0 +1,30 @@
+#include "json.h"
+
+#ifndef NUMBER_H
+#define NUMBER_H
+
+/**
+ * Parses the `len' bytes at `start' as a JSON number, without reading past
+ * them. Integers without a fraction or exponent come back as `TOK_INTEGER',
+ * or `TOK_UNSIGNED' above INT64_MAX, so 64-bit values survive unchanged.
+ * Anything else is a correctly rounded `TOK_NUMBER'. Returns `TOK_NONE' for
+ * anything outside the JSON grammar, e.g. `0x68', `inf' or `01'.
+ */
+Token scan_number(const char *start, size_t len);
+
+// length of the JSON number that `start' begins with, looking at no more than
+// `len' bytes, 0 if there is none. The digits are not converted
+size_t number_length(const char *start, size_t len);
+
+#define JSON_DOUBLE_MAX 32
+
+/**
+ * Writes digits that read back as exactly `value' to `dst', which needs room
+ * for `JSON_DOUBLE_MAX' bytes, and returns their length. They are the
+ * shortest such digits for all but a tiny fraction of values.
+ * Integral values keep a `.0' so they parse back as doubles, NaN and the
+ * infinities become `null'. No NUL terminator is written.
+ */
+size_t json_format_double(char *dst, double value);
+
+#endif
@@ -0,0 +1,636 @@
+#include "patch.h"
+#include "query.h"
+
+typedef struct {
+  Arena *arena;
+  bool share;
+  // containers copied into the new version, which are changed in place
+  const void **fresh;
+  size_t fresh_cap;
+  size_t fresh_len;
+  // false once out of memory
+  bool ok;
+} Patcher;
+
+static bool copy_value(JSON json, Arena *arena, JSON *out) {
+  *out = (JSON){.ok = json.ok, .type = json.type};
+
+  switch (json.type) {
+  case OBJECT: {
+    size_t n = json.map ? json.map->size : 0;
+    if (!(out->map = hashmap_json_new_cap(arena, n))) {
+      return false;
+    }
+
+    for (size_t b = 0, i = 0; i < n && b < json.map->cap; b++) {
+      BucketJSON *bucket = &json.map->values[b];
+      if (!bucket->key) {
+        continue;
+      }
+
+      JSON value;
+      if (!copy_value(bucket->value, arena, &value)) {
+        json_free(*out);
+        return false;
+      }
+
+      hashmap_json_set_n(out->map, bucket->key, bucket->key_len, value);
+      if (out->map->size == i++) {
+        json_free(value);
+        json_free(*out);
+        return false;
+      }
+    }
+    return true;
+  }
+  case ARRAY: {
+    size_t n = json.vec ? json.vec->len : 0;
+    if (!(out->vec = vector_json_new_in(arena))) {
+      return false;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      JSON value;
+      if (!copy_value(json.vec->items[i], arena, &value)) {
+        json_free(*out);
+        return false;
+      }
+
+      vector_json_push(out->vec, value);
+      if (out->vec->len == i) {
+        json_free(value);
+        json_free(*out);
+        return false;
+      }
+    }
+    return true;
+  }
+  case STRING:
+    out->str = mem_strndup(arena, json.str, json.len);
+    out->len = json.len;
+    out->owned = arena == NULL;
+    return out->str != NULL;
+  default:
+    *out = json;
+    return true;
+  }
+}
+
+JSON json_copy(JSON json, Arena *arena) {
+  JSON copy;
+  if (!copy_value(json, arena, &copy)) {
+    return (JSON){.ok = false};
+  }
+
+  copy.ok = true;
+  return copy;
+}
+
+static inline bool is_number(enum JSONType type) {
+  return type == NUMBER || type == INTEGER || type == UNSIGNED;
+}
+
+static double number_value(JSON json) {
+  switch (json.type) {
+  case INTEGER:
+    return (double)json.i;
+  case UNSIGNED:
+    return (double)json.u;
+  default:
+    return json.d;
+  }
+}
+
+bool json_equal(JSON a, JSON b) {
+  if (is_number(a.type) && is_number(b.type)) {
+    // exact integers stay exact, `UNSIGNED' only holds what `INTEGER' cannot
+    if (a.type != NUMBER && b.type != NUMBER) {
+      return a.type == b.type && a.u == b.u;
+    }
+    return number_value(a) == number_value(b);
+  }
+
+  if (a.type != b.type) {
+    return false;
+  }
+
+  switch (a.type) {
+  case OBJECT: {
+    size_t n = a.map ? a.map->size : 0;
+    if (n != (b.map ? b.map->size : 0)) {
+      return false;
+    }
+
+    for (size_t i = 0; n && i < a.map->cap; i++) {
+      BucketJSON *bucket = &a.map->values[i];
+      if (!bucket->key) {
+        continue;
+      }
+
+      JSON *other = hashmap_json_find_n(b.map, bucket->key, bucket->key_len);
+      if (!other || !json_equal(bucket->value, *other)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case ARRAY: {
+    size_t n = a.vec ? a.vec->len : 0;
+    if (n != (b.vec ? b.vec->len : 0)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      if (!json_equal(a.vec->items[i], b.vec->items[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case STRING:
+    return a.len == b.len && (a.len == 0 || memcmp(a.str, b.str, a.len) == 0);
+  case BOOLEAN:
+    return a.b == b.b;
+  default:
+    return true;
+  }
+}
+
+static inline size_t fresh_slot(const void *c, size_t cap) {
+  return (size_t)(((uintptr_t)c >> 4) * 0x9E3779B97F4A7C15ull) & (cap - 1);
+}
+
+static bool patch_is_fresh(const Patcher *p, const void *c) {
+  for (size_t i = p->fresh_cap ? fresh_slot(c, p->fresh_cap) : 0;
+       p->fresh_cap && p->fresh[i]; i = (i + 1) & (p->fresh_cap - 1)) {
+    if (p->fresh[i] == c) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool patch_add_fresh(Patcher *p, const void *c) {
+  if (!p->share) {
+    return true;
+  }
+
+  // at most half full
+  if (2 * (p->fresh_len + 1) > p->fresh_cap) {
+    size_t cap = p->fresh_cap ? 2 * p->fresh_cap : 64;
+    const void **fresh = calloc(cap, sizeof(void *));
+    if (!fresh) {
+      p->ok = false;
+      return false;
+    }
+
+    for (size_t i = 0; i < p->fresh_cap; i++) {
+      if (p->fresh[i]) {
+        size_t s = fresh_slot(p->fresh[i], cap);
+        while (fresh[s]) {
+          s = (s + 1) & (cap - 1);
+        }
+        fresh[s] = p->fresh[i];
+      }
+    }
+
+    free(p->fresh);
+    p->fresh = fresh;
+    p->fresh_cap = cap;
+  }
+
+  size_t s = fresh_slot(c, p->fresh_cap);
+  while (p->fresh[s]) {
+    s = (s + 1) & (p->fresh_cap - 1);
+  }
+  p->fresh[s] = c;
+  p->fresh_len++;
+  return true;
+}
+
+// a value the patch took out of the document
+static void patch_release(Patcher *p, JSON json) {
+  // the old version still holds it
+  if (!p->share) {
+    json_free(json);
+  }
+}
+
+/**
+ * Makes the object or array at `value' writable: shared with the old
+ * version, it is replaced by a copy that holds the same members or
+ * elements. Anything else is left as it is.
+ */
+static bool patch_own(Patcher *p, JSON *value) {
+  if (value->type == OBJECT && !value->map) {
+    value->map = hashmap_json_new_in(p->arena);
+    p->ok = value->map && patch_add_fresh(p, value->map);
+  } else if (value->type == ARRAY && !value->vec) {
+    value->vec = vector_json_new_in(p->arena);
+    p->ok = value->vec && patch_add_fresh(p, value->vec);
+  } else if (!p->share || (value->type != OBJECT && value->type != ARRAY)) {
+    return true;
+  } else if (value->type == OBJECT && !patch_is_fresh(p, value->map)) {
+    value->map = hashmap_json_clone(value->map, p->arena);
+    p->ok = value->map && patch_add_fresh(p, value->map);
+  } else if (value->type == ARRAY && !patch_is_fresh(p, value->vec)) {
+    value->vec = vector_json_clone(value->vec, p->arena);
+    p->ok = value->vec && patch_add_fresh(p, value->vec);
+  }
+
+  return p->ok;
+}
+
+/**
+ * Makes a map without an arena that borrows its keys, those of a document
+ * parsed through an interner, own copies of them. `json_free' never releases
+ * borrowed keys, so a new key has nowhere else to go.
+ */
+static bool patch_own_keys(struct HashMapJSON *map) {
+  const char **keys = malloc((map->size ? map->size : 1) * sizeof(char *));
+  if (!keys) {
+    return false;
+  }
+
+  size_t n = 0;
+  for (size_t b = 0; b < map->cap; b++) {
+    BucketJSON *bucket = &map->values[b];
+    if (!bucket->key) {
+      continue;
+    }
+
+    if (!(keys[n] = mem_strndup(NULL, bucket->key, bucket->key_len))) {
+      while (n > 0) {
+        mem_free(NULL, (void *)keys[--n]);
+      }
+      free(keys);
+      return false;
+    }
+    n++;
+  }
+
+  for (size_t b = 0, i = 0; b < map->cap; b++) {
+    if (map->values[b].key) {
+      map->values[b].key = keys[i++];
+    }
+  }
+
+  free(keys);
+  map->borrow_keys = false;
+  return true;
+}
+
+// adds `key', which is not there yet, to a writable map
+static bool patch_insert(Patcher *p, struct HashMapJSON *map, const char *key,
+                         size_t len, JSON value) {
+  if (map->borrow_keys && !map->arena && !patch_own_keys(map)) {
+    p->ok = false;
+    return false;
+  }
+
+  // copies of the old version borrow its keys, new keys need a copy too
+  if (map->borrow_keys && !(key = mem_strndup(map->arena, key, len))) {
+    p->ok = false;
+    return false;
+  }
+
+  size_t size = map->size;
+  hashmap_json_set_n(map, key, len, value);
+  p->ok = map->size != size;
+  return p->ok;
+}
+
+static JSON *patch_child(JSON *parent, const QueryStep *step) {
+  switch (parent->type) {
+  case OBJECT:
+    return parent->map ? hashmap_json_find_n(parent->map, step->key, step->len)
+                       : NULL;
+  case ARRAY:
+    return parent->vec && step->has_index
+               ? vector_json_find(parent->vec, (ptrdiff_t)step->index)
+               : NULL;
+  default:
+    return NULL;
+  }
+}
+
+// the value at the first `n' steps from `root', NULL when there is none
+static JSON *patch_find(JSON *root, const QueryStep *steps, size_t n) {
+  for (size_t i = 0; root && i < n; i++) {
+    root = patch_child(root, &steps[i]);
+  }
+
+  return root;
+}
+
+// same as `patch_find', making every container on the way writable
+static JSON *patch_walk(Patcher *p, JSON *root, const QueryStep *steps,
+                        size_t n) {
+  for (size_t i = 0; root && i < n; i++) {
+    root = patch_own(p, root) ? patch_child(root, &steps[i]) : NULL;
+  }
+
+  return root && patch_own(p, root) ? root : NULL;
+}
+
+static inline JSONErrorCode patch_walk_error(const Patcher *p) {
+  return p->ok ? JSON_ERROR_PATH : JSON_ERROR_MEMORY;
+}
+
+/**
+ * Puts `value' at `to', in place of what is there for `replace' and as a
+ * new member or element otherwise. The document takes `value' over when
+ * this succeeds.
+ */
+static JSONErrorCode patch_put(Patcher *p, JSON *root, const JSONQuery *to,
+                               JSON value, bool replace) {
+  if (to->len == 0) {
+    patch_release(p, *root);
+    *root = value;
+    return JSON_OK;
+  }
+
+  JSON *parent = patch_walk(p, root, to->steps, to->len - 1);
+  if (!parent) {
+    return patch_walk_error(p);
+  }
+
+  const QueryStep *last = &to->steps[to->len - 1];
+  JSON *slot = patch_child(parent, last);
+  if (slot && (replace || parent->type == OBJECT)) {
+    patch_release(p, *slot);
+    *slot = value;
+    return JSON_OK;
+  }
+  if (replace) {
+    return JSON_ERROR_PATH;
+  }
+
+  switch (parent->type) {
+  case OBJECT:
+    return patch_insert(p, parent->map, last->key, last->len, value)
+               ? JSON_OK
+               : JSON_ERROR_MEMORY;
+  case ARRAY: {
+    struct VectorJSON *vec = parent->vec;
+    size_t index = vec->len;
+    if (!(last->len == 1 && last->key[0] == '-')) {
+      if (!last->has_index || (size_t)last->index > vec->len) {
+        return JSON_ERROR_PATH;
+      }
+      index = (size_t)last->index;
+    }
+
+    p->ok = vector_json_insert(vec, index, value);
+    return p->ok ? JSON_OK : JSON_ERROR_MEMORY;
+  }
+  default:
+    return JSON_ERROR_PATH;
+  }
+}
+
+// takes the value at `from' out of the document into `out'
+static JSONErrorCode patch_take(Patcher *p, JSON *root, const JSONQuery *from,
+                                JSON *out) {
+  // the document itself cannot be removed
+  if (from->len == 0) {
+    return JSON_ERROR_PATCH;
+  }
+
+  JSON *parent = patch_walk(p, root, from->steps, from->len - 1);
+  if (!parent) {
+    return patch_walk_error(p);
+  }
+
+  const QueryStep *last = &from->steps[from->len - 1];
+  bool found = false;
+  if (parent->type == OBJECT) {
+    found = hashmap_json_remove_n(parent->map, last->key, last->len, out);
+  } else if (parent->type == ARRAY && last->has_index) {
+    found = vector_json_remove(parent->vec, (size_t)last->index, out);
+  }
+
+  return found ? JSON_OK : JSON_ERROR_PATH;
+}
+
+// the first `len' steps of `a' and `b' are the same
+static bool patch_same_steps(const JSONQuery *a, const JSONQuery *b,
+                             size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (a->steps[i].len != b->steps[i].len ||
+        memcmp(a->steps[i].key, b->steps[i].key, a->steps[i].len) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static JSONQuery *patch_pointer(JSON *path) {
+  if (!path || path->type != STRING ||
+      (path->len > 0 && path->str[0] != '/')) {
+    return NULL;
+  }
+
+  return json_query_compile(path->str, path->len);
+}
+
+static inline bool patch_op_is(JSON *op, const char *name) {
+  return op->len == strlen(name) && memcmp(op->str, name, op->len) == 0;
+}
+
+static JSONErrorCode patch_apply(Patcher *p, JSON *root, JSON *op,
+                                 const JSONQuery *to, const JSONQuery *from,
+                                 JSON *value) {
+  JSON json;
+  JSONErrorCode code;
+
+  if (patch_op_is(op, "test")) {
+    JSON *found = patch_find(root, to->steps, to->len);
+    if (!found) {
+      return JSON_ERROR_PATH;
+    }
+    return json_equal(*found, *value) ? JSON_OK : JSON_ERROR_TEST;
+  }
+
+  if (patch_op_is(op, "remove")) {
+    code = patch_take(p, root, to, &json);
+    if (code == JSON_OK) {
+      patch_release(p, json);
+    }
+    return code;
+  }
+
+  if (patch_op_is(op, "move")) {
+    if (from->len == to->len && patch_same_steps(from, to, to->len)) {
+      return patch_find(root, from->steps, from->len) ? JSON_OK
+                                                      : JSON_ERROR_PATH;
+    }
+    // a value cannot move into itself
+    if (from->len < to->len && patch_same_steps(from, to, from->len)) {
+      return JSON_ERROR_PATCH;
+    }
+
+    code = patch_take(p, root, from, &json);
+  } else if (patch_op_is(op, "copy")) {
+    JSON *found = patch_find(root, from->steps, from->len);
+    if (!found) {
+      return JSON_ERROR_PATH;
+    }
+    code = copy_value(*found, p->arena, &json) ? JSON_OK : JSON_ERROR_MEMORY;
+  } else {
+    code = copy_value(*value, p->arena, &json) ? JSON_OK : JSON_ERROR_MEMORY;
+  }
+
+  if (code == JSON_OK) {
+    code = patch_put(p, root, to, json, patch_op_is(op, "replace"));
+    if (code != JSON_OK) {
+      patch_release(p, json);
+    }
+  }
+
+  return code;
+}
+
+static JSONErrorCode patch_op(Patcher *p, JSON *root, JSON operation) {
+  if (operation.type != OBJECT || !operation.map) {
+    return JSON_ERROR_PATCH;
+  }
+
+  struct HashMapJSON *map = operation.map;
+  JSON *op = hashmap_json_find_n(map, "op", 2);
+  JSON *value = hashmap_json_find_n(map, "value", 5);
+  if (!op || op->type != STRING) {
+    return JSON_ERROR_PATCH;
+  }
+
+  bool needs_from = patch_op_is(op, "move") || patch_op_is(op, "copy");
+  bool needs_value = patch_op_is(op, "add") || patch_op_is(op, "replace") ||
+                     patch_op_is(op, "test");
+  if (!needs_from && !needs_value && !patch_op_is(op, "remove")) {
+    return JSON_ERROR_PATCH;
+  }
+
+  JSONQuery *to = patch_pointer(hashmap_json_find_n(map, "path", 4));
+  JSONQuery *from =
+      needs_from ? patch_pointer(hashmap_json_find_n(map, "from", 4)) : NULL;
+
+  JSONErrorCode code = JSON_ERROR_PATCH;
+  if (to && (!needs_from || from) && (!needs_value || value)) {
+    code = patch_apply(p, root, op, to, from, value);
+  }
+
+  json_query_free(to);
+  json_query_free(from);
+  return code;
+}
+
+JSONError json_patch(JSON *target, JSON patch, Arena *arena, unsigned flags) {
+  Patcher p = {
+      .arena = arena,
+      .share = (flags & JSON_PATCH_SHARE) != 0,
+      .ok = true,
+  };
+  if ((p.share && !arena) || patch.type != ARRAY) {
+    return (JSONError){JSON_ERROR_PATCH, 0};
+  }
+
+  JSON doc = *target;
+  JSONError error = {JSON_OK, 0};
+  for (size_t i = 0; patch.vec && i < patch.vec->len; i++) {
+    JSONErrorCode code = patch_op(&p, &doc, patch.vec->items[i]);
+    if (code != JSON_OK) {
+      error = (JSONError){p.ok ? code : JSON_ERROR_MEMORY, i};
+      break;
+    }
+  }
+
+  free(p.fresh);
+  if (!p.share || error.code == JSON_OK) {
+    doc.ok = true;
+    *target = doc;
+  }
+
+  return error;
+}
+
+static bool patch_merge(Patcher *p, JSON *target, JSON patch) {
+  if (patch.type != OBJECT) {
+    JSON value;
+    if (!copy_value(patch, p->arena, &value)) {
+      return false;
+    }
+
+    patch_release(p, *target);
+    *target = value;
+    return true;
+  }
+
+  if (target->type != OBJECT) {
+    patch_release(p, *target);
+    *target = (JSON){.type = OBJECT};
+  }
+  if (!patch_own(p, target)) {
+    return false;
+  }
+
+  struct HashMapJSON *map = target->map;
+  size_t n = patch.map ? patch.map->size : 0;
+  for (size_t b = 0, i = 0; i < n && b < patch.map->cap; b++) {
+    BucketJSON *bucket = &patch.map->values[b];
+    if (!bucket->key) {
+      continue;
+    }
+    i++;
+
+    JSON removed;
+    if (bucket->value.type == NIL) {
+      if (hashmap_json_remove_n(map, bucket->key, bucket->key_len, &removed)) {
+        patch_release(p, removed);
+      }
+      continue;
+    }
+
+    JSON *slot = hashmap_json_find_n(map, bucket->key, bucket->key_len);
+    if (slot) {
+      if (!patch_merge(p, slot, bucket->value)) {
+        return false;
+      }
+      continue;
+    }
+
+    // merged into nothing, which drops the nulls of nested objects
+    JSON value = {.type = NIL};
+    if (!patch_merge(p, &value, bucket->value) ||
+        !patch_insert(p, map, bucket->key, bucket->key_len, value)) {
+      patch_release(p, value);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+JSONError json_merge_patch(JSON *target, JSON patch, Arena *arena,
+                           unsigned flags) {
+  Patcher p = {
+      .arena = arena,
+      .share = (flags & JSON_PATCH_SHARE) != 0,
+      .ok = true,
+  };
+  if (p.share && !arena) {
+    return (JSONError){JSON_ERROR_PATCH, 0};
+  }
+
+  JSON doc = *target;
+  bool ok = patch_merge(&p, &doc, patch);
+  free(p.fresh);
+
+  if (!p.share || ok) {
+    doc.ok = true;
+    *target = doc;
+  }
+
+  return (JSONError){ok ? JSON_OK : JSON_ERROR_MEMORY, 0};
+}
@@ -0,0 +1,40 @@
+#include "json.h"
+
+#ifndef PATCH_H
+#define PATCH_H
+
+enum JSONPatchFlags {
+  // builds a new version of the target in `arena' and leaves the old one
+  // untouched. Only the objects and arrays on the paths the patch changes
+  // are copied, every other subtree is shared by both versions: the old one
+  // must outlive the new one, and readers can keep using it meanwhile.
+  // Without it the target is changed in place.
+  JSON_PATCH_SHARE = 1 << 0,
+};
+
+/**
+ * Applies the RFC 7396 merge patch `patch' to `*target'. In place, `arena'
+ * is the one the target was parsed into, NULL for documents released with
+ * `json_free', and the values the patch replaces or removes are released.
+ * Values taken from `patch' are copied, it can go once this returns.
+ * `JSON_PATCH_SHARE' needs an arena.
+ */
+JSONError json_merge_patch(JSON *target, JSON patch, Arena *arena,
+                           unsigned flags);
+
+/**
+ * Applies the RFC 6902 JSON Patch `patch', an array of operations, to
+ * `*target', with `arena' and `flags' as in `json_merge_patch'. The `offset'
+ * of an error is the index of the operation that failed. With
+ * `JSON_PATCH_SHARE', `*target' is only replaced when every operation
+ * applied, in place the operations before the failed one stay applied.
+ */
+JSONError json_patch(JSON *target, JSON patch, Arena *arena, unsigned flags);
+
+// a deep copy of `json' in `arena', which may be NULL
+JSON json_copy(JSON json, Arena *arena);
+
+// same type and contents, numbers compare by value and members in any order
+bool json_equal(JSON a, JSON b);
+
+#endif
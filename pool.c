@@ -0,0 +1,202 @@
+#include "pool.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define POOL_MIN_SHIFT 4
+// 16, 32, ... up to POOL_MAX_SIZE bytes
+#define POOL_CLASSES 9
+#define POOL_LARGE POOL_CLASSES
+
+// in front of every block, keeps the payload aligned like malloc's
+typedef union {
+  size_t size_class;
+  max_align_t align;
+} PoolHeader;
+
+typedef struct PoolBlock {
+  struct PoolBlock *next;
+} PoolBlock;
+
+typedef struct {
+  PoolBlock *free[POOL_CLASSES];
+  size_t cached;
+  // the cache is trimmed when its thread exits
+  bool registered;
+} PoolCache;
+
+static _Thread_local PoolCache cache;
+
+static inline size_t class_of(size_t size) {
+  if (size <= 1u << POOL_MIN_SHIFT) {
+    return 0;
+  }
+
+  size_t bits = 64 - __builtin_clzll((unsigned long long)size - 1);
+  return bits - POOL_MIN_SHIFT;
+}
+
+static inline size_t class_size(size_t size_class) {
+  return (size_t)1 << (size_class + POOL_MIN_SHIFT);
+}
+
+static inline PoolHeader *header_of(void *ptr) {
+  return (PoolHeader *)ptr - 1;
+}
+
+static void pool_trim_cache(PoolCache *c) {
+  for (size_t i = 0; i < POOL_CLASSES; i++) {
+    PoolBlock *block = c->free[i];
+    while (block) {
+      PoolBlock *next = block->next;
+      free(header_of(block));
+      block = next;
+    }
+    c->free[i] = NULL;
+  }
+
+  c->cached = 0;
+}
+
+// a thread-specific key whose destructor trims the cache of every thread that
+// ever cached a block, however the thread was started. A block freed by a
+// later destructor registers the cache again
+#ifdef _WIN32
+static DWORD pool_key = FLS_OUT_OF_INDEXES;
+static INIT_ONCE pool_once = INIT_ONCE_STATIC_INIT;
+
+static VOID WINAPI pool_exit(PVOID data) {
+  PoolCache *c = data;
+  c->registered = false;
+  pool_trim_cache(c);
+}
+
+static BOOL CALLBACK pool_key_init(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+  pool_key = FlsAlloc(pool_exit);
+  return TRUE;
+}
+
+static void pool_register(void) {
+  InitOnceExecuteOnce(&pool_once, pool_key_init, NULL, NULL);
+  cache.registered = pool_key != FLS_OUT_OF_INDEXES &&
+                     FlsSetValue(pool_key, &cache);
+}
+#else
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static bool pool_key_ok;
+
+static void pool_exit(void *data) {
+  PoolCache *c = data;
+  c->registered = false;
+  pool_trim_cache(c);
+}
+
+static void pool_key_init(void) {
+  pool_key_ok = pthread_key_create(&pool_key, pool_exit) == 0;
+}
+
+static void pool_register(void) {
+  pthread_once(&pool_once, pool_key_init);
+  cache.registered = pool_key_ok && pthread_setspecific(pool_key, &cache) == 0;
+}
+#endif
+
+void *pool_alloc(size_t size) {
+  if (size > POOL_MAX_SIZE) {
+    PoolHeader *h = malloc(sizeof(PoolHeader) + size);
+    if (!h) {
+      return NULL;
+    }
+
+    h->size_class = POOL_LARGE;
+    return h + 1;
+  }
+
+  size_t c = class_of(size);
+  PoolBlock *block = cache.free[c];
+  if (block) {
+    cache.free[c] = block->next;
+    cache.cached -= class_size(c);
+    return block;
+  }
+
+  PoolHeader *h = malloc(sizeof(PoolHeader) + class_size(c));
+  if (!h) {
+    return NULL;
+  }
+
+  h->size_class = c;
+  return h + 1;
+}
+
+void *pool_calloc(size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size) {
+    return NULL;
+  }
+
+  void *ptr = pool_alloc(count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+
+  return ptr;
+}
+
+void *pool_realloc(void *ptr, size_t size) {
+  if (!ptr) {
+    return pool_alloc(size);
+  }
+
+  PoolHeader *h = header_of(ptr);
+  size_t c = h->size_class;
+  if (c == POOL_LARGE && size > POOL_MAX_SIZE) {
+    h = realloc(h, sizeof(PoolHeader) + size);
+    return h ? h + 1 : NULL;
+  }
+  if (c != POOL_LARGE && size <= class_size(c)) {
+    return ptr;
+  }
+
+  // only large blocks shrink into a class, and they are at least as big
+  void *new_ptr = pool_alloc(size);
+  if (new_ptr) {
+    size_t old_size = c == POOL_LARGE ? size : class_size(c);
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    pool_free(ptr);
+  }
+
+  return new_ptr;
+}
+
+void pool_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  PoolHeader *h = header_of(ptr);
+  size_t c = h->size_class;
+  if (c == POOL_LARGE || cache.cached + class_size(c) > POOL_MAX_CACHED) {
+    free(h);
+    return;
+  }
+
+  if (!cache.registered) {
+    pool_register();
+  }
+
+  // the header stays, the block comes back with its class already set
+  PoolBlock *block = ptr;
+  block->next = cache.free[c];
+  cache.free[c] = block;
+  cache.cached += class_size(c);
+}
+
+void pool_trim(void) { pool_trim_cache(&cache); }
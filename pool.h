@@ -0,0 +1,32 @@
+#include <stddef.h>
+
+#ifndef POOL_H
+#define POOL_H
+
+// blocks up to this size are pooled, larger ones go straight to malloc
+#define POOL_MAX_SIZE 4096
+
+// memory each thread keeps cached at most, the rest is freed. Enough for the
+// tree of a document of a few MB, lower it for programs with many threads
+#ifndef POOL_MAX_CACHED
+#define POOL_MAX_CACHED (64u << 20)
+#endif
+
+/**
+ * Per-thread free lists behind every allocation made without an arena. A
+ * block released with `pool_free' is handed out again by the next
+ * `pool_alloc' of its size class on the same thread, so a loop that parses
+ * and frees documents settles into reusing the same maps, vectors and
+ * strings instead of going through malloc. Blocks may be freed on any
+ * thread, they join the pool of the thread that frees them. The pools of a
+ * thread are trimmed when it exits, however it was started.
+ */
+void *pool_alloc(size_t size);
+void *pool_calloc(size_t count, size_t size);
+void *pool_realloc(void *ptr, size_t size);
+void pool_free(void *ptr);
+
+// hands the blocks cached by the calling thread back to the system allocator
+void pool_trim(void);
+
+#endif
@@ -0,0 +1,358 @@
+#include "query.h"
+
+// "0" or a number without leading zeros, negative only when `sign' allows it
+static bool query_index(const char *s, size_t len, bool sign, int64_t *out) {
+  bool negative = sign && len > 0 && *s == '-';
+  s += negative;
+  len -= negative;
+
+  if (len == 0 || len > 18 || (len > 1 && *s == '0')) {
+    return false;
+  }
+
+  int64_t value = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+    value = value * 10 + (s[i] - '0');
+  }
+
+  *out = negative ? -value : value;
+  return true;
+}
+
+static bool query_pointer(JSONQuery *q, const char *s, const char *end) {
+  char *out = q->keys;
+
+  while (s < end) {
+    if (*s++ != '/') {
+      return false;
+    }
+
+    QueryStep *step = &q->steps[q->len++];
+    *step = (QueryStep){.kind = QUERY_TOKEN, .key = out};
+    for (; s < end && *s != '/'; s++) {
+      if (*s != '~') {
+        *out++ = *s;
+        continue;
+      }
+
+      // ~0 and ~1 are the only escapes
+      if (s + 1 == end || (s[1] != '0' && s[1] != '1')) {
+        return false;
+      }
+      *out++ = *++s == '0' ? '~' : '/';
+    }
+
+    step->len = out - step->key;
+    step->has_index = query_index(step->key, step->len, false, &step->index);
+  }
+
+  return true;
+}
+
+// the inside of `[...]', returns the position after the `]'
+static const char *query_bracket(const char *s, const char *end,
+                                 QueryStep *step, char **out) {
+  if (s < end && *s == '*') {
+    step->kind = QUERY_WILDCARD;
+    s++;
+  } else if (s < end && (*s == '\'' || *s == '"')) {
+    char quote = *s++;
+    step->kind = QUERY_KEY;
+    step->key = *out;
+    for (; s < end && *s != quote; s++) {
+      if (*s == '\\' && s + 1 < end) {
+        s++;
+      }
+      *(*out)++ = *s;
+    }
+    if (s == end) {
+      return NULL;
+    }
+
+    step->len = *out - step->key;
+    s++;
+  } else {
+    const char *start = s;
+    while (s < end && *s != ']') {
+      s++;
+    }
+
+    step->kind = QUERY_INDEX;
+    step->has_index = true;
+    if (!query_index(start, s - start, true, &step->index)) {
+      return NULL;
+    }
+  }
+
+  return s < end && *s == ']' ? s + 1 : NULL;
+}
+
+static bool query_path(JSONQuery *q, const char *s, const char *end) {
+  char *out = q->keys;
+
+  while (s < end) {
+    QueryStep step = {0};
+
+    if (*s == '.') {
+      s++;
+      step.descent = s < end && *s == '.';
+      s += step.descent;
+      if (s == end) {
+        return false;
+      }
+
+      if (*s == '*') {
+        step.kind = QUERY_WILDCARD;
+        s++;
+        q->steps[q->len++] = step;
+        continue;
+      }
+
+      if (*s != '[') {
+        step.kind = QUERY_KEY;
+        step.key = out;
+        for (; s < end && *s != '.' && *s != '['; s++) {
+          *out++ = *s;
+        }
+        step.len = out - step.key;
+        q->steps[q->len++] = step;
+        continue;
+      }
+
+      // only descent may be followed by a bracket: `..[0]'
+      if (!step.descent) {
+        return false;
+      }
+    }
+
+    if (*s != '[') {
+      return false;
+    }
+
+    s = query_bracket(s + 1, end, &step, &out);
+    if (!s) {
+      return false;
+    }
+    q->steps[q->len++] = step;
+  }
+
+  return true;
+}
+
+JSONQuery *json_query_compile(const char *expr, size_t len) {
+  JSONQuery *q = malloc(sizeof(JSONQuery));
+  if (!q) {
+    return NULL;
+  }
+
+  // there are never more steps than bytes, and decoded names never outgrow
+  // the expression
+  *q = (JSONQuery){
+      .steps = malloc((len + 1) * sizeof(QueryStep)),
+      .keys = malloc(len + 1),
+  };
+
+  bool ok = q->steps && q->keys;
+  if (ok && len > 0 && expr[0] == '$') {
+    ok = query_path(q, expr + 1, expr + len);
+  } else if (ok) {
+    ok = query_pointer(q, expr, expr + len);
+  }
+
+  if (!ok) {
+    json_query_free(q);
+    return NULL;
+  }
+
+  return q;
+}
+
+void json_query_free(JSONQuery *query) {
+  if (!query) {
+    return;
+  }
+
+  free(query->steps);
+  free(query->keys);
+  free(query);
+}
+
+typedef struct {
+  const JSONQuery *query;
+  struct VectorJSONPTR *out;
+  JSON *first;
+  size_t count;
+  // stop at the first match
+  bool once;
+} QueryRun;
+
+static void query_tree(QueryRun *r, size_t i, JSON *node);
+
+// applies the selector of step `i' to `node' alone
+static void query_tree_select(QueryRun *r, size_t i, JSON *node) {
+  const QueryStep *step = &r->query->steps[i];
+  JSON *child = NULL;
+
+  switch (step->kind) {
+  case QUERY_KEY:
+  case QUERY_TOKEN:
+    if (node->type == OBJECT) {
+      child = hashmap_json_find_n(node->map, step->key, step->len);
+    } else if (node->type == ARRAY && step->has_index) {
+      child = vector_json_find(node->vec, step->index);
+    }
+    break;
+  case QUERY_INDEX:
+    if (node->type == ARRAY) {
+      child = vector_json_find(node->vec, step->index);
+    }
+    break;
+  case QUERY_WILDCARD:
+    if (node->type == OBJECT) {
+      for (size_t k = 0; k < node->map->cap; k++) {
+        if (node->map->values[k].key) {
+          query_tree(r, i + 1, &node->map->values[k].value);
+        }
+      }
+    } else if (node->type == ARRAY) {
+      for (size_t k = 0; k < node->vec->len; k++) {
+        query_tree(r, i + 1, &node->vec->items[k]);
+      }
+    }
+    break;
+  }
+
+  if (child) {
+    query_tree(r, i + 1, child);
+  }
+}
+
+static void query_tree(QueryRun *r, size_t i, JSON *node) {
+  if (r->once && r->count > 0) {
+    return;
+  }
+
+  if (i == r->query->len) {
+    if (r->out) {
+      vector_jsonp_push(r->out, node);
+    }
+    r->first = r->count++ ? r->first : node;
+    return;
+  }
+
+  query_tree_select(r, i, node);
+  if (!r->query->steps[i].descent) {
+    return;
+  }
+
+  // the same step again one level down
+  if (node->type == OBJECT) {
+    for (size_t k = 0; k < node->map->cap; k++) {
+      if (node->map->values[k].key) {
+        query_tree(r, i, &node->map->values[k].value);
+      }
+    }
+  } else if (node->type == ARRAY) {
+    for (size_t k = 0; k < node->vec->len; k++) {
+      query_tree(r, i, &node->vec->items[k]);
+    }
+  }
+}
+
+size_t json_query_run(const JSONQuery *query, JSON *root,
+                      struct VectorJSONPTR *out) {
+  QueryRun r = {.query = query, .out = out};
+  query_tree(&r, 0, root);
+  return r.count;
+}
+
+JSON *json_query_first(const JSONQuery *query, JSON *root) {
+  QueryRun r = {.query = query, .once = true};
+  query_tree(&r, 0, root);
+  return r.first;
+}
+
+typedef struct {
+  const JSONQuery *query;
+  JSONQueryCallback callback;
+  void *ctx;
+  size_t count;
+} QueryEach;
+
+static void query_cursor(QueryEach *r, size_t i, JSONCursor c);
+
+// element `index' of the array at `c', counted from the end when negative
+static JSONCursor query_cursor_at(JSONCursor c, int64_t index) {
+  if (index >= 0) {
+    return json_cursor_at(c, (size_t)index);
+  }
+
+  size_t len = 0;
+  for (JSONCursor e = json_cursor_child(c); json_cursor_ok(e);
+       e = json_cursor_next(e)) {
+    len++;
+  }
+
+  return (int64_t)len + index >= 0 ? json_cursor_at(c, len + index)
+                                   : (JSONCursor){0};
+}
+
+static void query_cursor_select(QueryEach *r, size_t i, JSONCursor c) {
+  const QueryStep *step = &r->query->steps[i];
+  JSONCursor child = {0};
+
+  // lookups that do not fit the value's type come back empty, so the type
+  // itself is never needed
+  switch (step->kind) {
+  case QUERY_KEY:
+  case QUERY_TOKEN:
+    child = json_cursor_find(c, step->key, step->len);
+    if (!json_cursor_ok(child) && step->has_index) {
+      child = query_cursor_at(c, step->index);
+    }
+    break;
+  case QUERY_INDEX:
+    child = query_cursor_at(c, step->index);
+    break;
+  case QUERY_WILDCARD:
+    for (JSONCursor e = json_cursor_child(c); json_cursor_ok(e);
+         e = json_cursor_next(e)) {
+      query_cursor(r, i + 1, e);
+    }
+    break;
+  }
+
+  if (json_cursor_ok(child)) {
+    query_cursor(r, i + 1, child);
+  }
+}
+
+static void query_cursor(QueryEach *r, size_t i, JSONCursor c) {
+  if (i == r->query->len) {
+    r->callback(r->ctx, c);
+    r->count++;
+    return;
+  }
+
+  query_cursor_select(r, i, c);
+  if (!r->query->steps[i].descent) {
+    return;
+  }
+
+  for (JSONCursor e = json_cursor_child(c); json_cursor_ok(e);
+       e = json_cursor_next(e)) {
+    query_cursor(r, i, e);
+  }
+}
+
+size_t json_query_each(const JSONQuery *query, JSONCursor root,
+                       JSONQueryCallback callback, void *ctx) {
+  QueryEach r = {.query = query, .callback = callback, .ctx = ctx};
+  if (json_cursor_ok(root)) {
+    query_cursor(&r, 0, root);
+  }
+  return r.count;
+}
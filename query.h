@@ -0,0 +1,74 @@
+#include "json.h"
+#include "lazy.h"
+
+#ifndef QUERY_H
+#define QUERY_H
+
+typedef enum {
+  // member `key' of an object
+  QUERY_KEY,
+  // element `index' of an array, counted from the end when negative
+  QUERY_INDEX,
+  // JSON Pointer reference token: a member name, or an index for arrays
+  QUERY_TOKEN,
+  // every member or element
+  QUERY_WILDCARD,
+} QueryKind;
+
+typedef struct {
+  QueryKind kind;
+  // the selector also applies to every descendant (`..')
+  bool descent;
+  const char *key;
+  size_t len;
+  // set for `QUERY_INDEX', and for `QUERY_TOKEN' when it is an array index
+  bool has_index;
+  int64_t index;
+} QueryStep;
+
+/**
+ * A compiled path, evaluated any number of times against trees or raw
+ * documents. Member names are decoded once at compile time.
+ */
+typedef struct {
+  QueryStep *steps;
+  size_t len;
+  char *keys;
+} JSONQuery;
+
+/**
+ * Compiles an RFC 6901 JSON Pointer (`""', `/items/0/id') or, starting with
+ * `$', a JSONPath subset: `.name', `['name']', `[2]', `[-1]', `.*', `[*]' and
+ * recursive descent with `..name', `..*' or `..[0]'. Returns NULL on a syntax
+ * error.
+ */
+JSONQuery *json_query_compile(const char *expr, size_t len);
+void json_query_free(JSONQuery *query);
+
+/**
+ * Appends a pointer to every value of the tree at `root' that `query'
+ * selects to `out'. Returns the number found. Array elements come in order,
+ * object members in the order of their map: insertion order up to
+ * `HASHMAP_SMALL_MAX' members, beyond that the order of the hash table, which
+ * changes with the hash seed from one run to the next. `json_query_each'
+ * keeps document order.
+ */
+size_t json_query_run(const JSONQuery *query, JSON *root,
+                      struct VectorJSONPTR *out);
+
+// first value `query' selects, NULL when there is none
+JSON *json_query_first(const JSONQuery *query, JSON *root);
+
+typedef void (*JSONQueryCallback)(void *ctx, JSONCursor match);
+
+/**
+ * Runs `query' over a raw document through its cursor, without building a
+ * tree: subtrees that cannot match are skipped and only the matches are
+ * handed to `callback'. Returns the number of matches. Names select the last
+ * of repeated keys, as in a tree, but wildcards visit every member of the
+ * document, including the duplicates a tree drops.
+ */
+size_t json_query_each(const JSONQuery *query, JSONCursor root,
+                       JSONQueryCallback callback, void *ctx);
+
+#endif
@@ -0,0 +1,587 @@
+#include "scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct {
+  uint64_t whitespace;
+  uint64_t op;
+  uint64_t quote;
+  uint64_t backslash;
+  // bytes below 0x20, which are only allowed outside of strings
+  uint64_t control;
+  // bytes of multi-byte UTF-8 sequences
+  uint64_t high;
+} BlockMasks;
+
+enum {
+  CLASS_WHITESPACE = 1,
+  CLASS_OP = 2,
+  CLASS_QUOTE = 4,
+  CLASS_BACKSLASH = 8,
+};
+
+static const uint8_t CLASSES[256] = {
+    [' '] = CLASS_WHITESPACE, ['\t'] = CLASS_WHITESPACE,
+    ['\n'] = CLASS_WHITESPACE, ['\r'] = CLASS_WHITESPACE,
+    ['{'] = CLASS_OP,         ['}'] = CLASS_OP,
+    ['['] = CLASS_OP,         [']'] = CLASS_OP,
+    [':'] = CLASS_OP,         [','] = CLASS_OP,
+    ['"'] = CLASS_QUOTE,      ['\\'] = CLASS_BACKSLASH,
+};
+
+static void classify_scalar(const uint8_t *block, BlockMasks *m) {
+  *m = (BlockMasks){0};
+
+  for (int i = 0; i < 64; i++) {
+    uint64_t bit = 1ULL << i;
+    m->control |= (uint64_t)(block[i] < 0x20) << i;
+    m->high |= (uint64_t)(block[i] >> 7) << i;
+    switch (CLASSES[block[i]]) {
+    case CLASS_WHITESPACE:
+      m->whitespace |= bit;
+      break;
+    case CLASS_OP:
+      m->op |= bit;
+      break;
+    case CLASS_QUOTE:
+      m->quote |= bit;
+      break;
+    case CLASS_BACKSLASH:
+      m->backslash |= bit;
+      break;
+    }
+  }
+}
+
+#ifdef SCANNER_X86
+__attribute__((target("sse2"))) static void
+classify_sse2(const uint8_t *block, BlockMasks *m) {
+  *m = (BlockMasks){0};
+
+  for (int i = 0; i < 4; i++) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(block + i * 16));
+#define EQ(c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+    __m128i ws = _mm_or_si128(_mm_or_si128(EQ(' '), EQ('\t')),
+                              _mm_or_si128(EQ('\n'), EQ('\r')));
+    __m128i op = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(EQ('{'), EQ('}')),
+                     _mm_or_si128(EQ('['), EQ(']'))),
+        _mm_or_si128(EQ(':'), EQ(',')));
+    uint64_t quote = (uint16_t)_mm_movemask_epi8(EQ('"'));
+    uint64_t backslash = (uint16_t)_mm_movemask_epi8(EQ('\\'));
+    uint64_t control = (uint16_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v));
+    uint64_t high = (uint16_t)_mm_movemask_epi8(v);
+#undef EQ
+
+    m->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << (i * 16);
+    m->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << (i * 16);
+    m->quote |= quote << (i * 16);
+    m->backslash |= backslash << (i * 16);
+    m->control |= control << (i * 16);
+    m->high |= high << (i * 16);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+classify_avx2(const uint8_t *block, BlockMasks *m) {
+  *m = (BlockMasks){0};
+
+  for (int i = 0; i < 2; i++) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(block + i * 32));
+#define EQ(c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+    __m256i ws = _mm256_or_si256(_mm256_or_si256(EQ(' '), EQ('\t')),
+                                 _mm256_or_si256(EQ('\n'), EQ('\r')));
+    __m256i op = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(EQ('{'), EQ('}')),
+                        _mm256_or_si256(EQ('['), EQ(']'))),
+        _mm256_or_si256(EQ(':'), EQ(',')));
+    uint64_t quote = (uint32_t)_mm256_movemask_epi8(EQ('"'));
+    uint64_t backslash = (uint32_t)_mm256_movemask_epi8(EQ('\\'));
+    uint64_t control = (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v));
+    uint64_t high = (uint32_t)_mm256_movemask_epi8(v);
+#undef EQ
+
+    m->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << (i * 32);
+    m->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << (i * 32);
+    m->quote |= quote << (i * 32);
+    m->backslash |= backslash << (i * 32);
+    m->control |= control << (i * 32);
+    m->high |= high << (i * 32);
+  }
+}
+#endif
+
+// state carried from one block to the next
+typedef struct {
+  uint64_t prev_odd;
+  uint64_t prev_in_string;
+  uint64_t prev_scalar;
+  // the scalar validator: continuation bytes still expected, and the range
+  // of the next one
+  uint8_t utf8_need, utf8_lo, utf8_hi;
+  // the vector validator: the previous block, whether it had any non-ASCII
+  // byte, and whether it ended inside a sequence
+  uint8_t utf8_prev[16];
+  bool utf8_dirty;
+  bool utf8_incomplete;
+  // opening quote of the last string, for an unterminated one
+  size_t string_start;
+} ScannerState;
+
+// offset of the first byte of `s' that is not valid UTF-8, `len' when there
+// is none
+static size_t utf8_scalar(ScannerState *st, const uint8_t *s, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = s[i];
+    if (st->utf8_need) {
+      if (c < st->utf8_lo || c > st->utf8_hi) {
+        return i;
+      }
+      st->utf8_need--;
+      st->utf8_lo = 0x80;
+      st->utf8_hi = 0xBF;
+      continue;
+    }
+
+    // overlong forms, surrogates and code points above U+10FFFF are ruled
+    // out by the range of the second byte
+    if (c < 0x80) {
+      continue;
+    } else if (c < 0xC2) {
+      return i;
+    } else if (c < 0xE0) {
+      st->utf8_need = 1;
+      st->utf8_lo = 0x80;
+      st->utf8_hi = 0xBF;
+    } else if (c < 0xF0) {
+      st->utf8_need = 2;
+      st->utf8_lo = c == 0xE0 ? 0xA0 : 0x80;
+      st->utf8_hi = c == 0xED ? 0x9F : 0xBF;
+    } else if (c < 0xF5) {
+      st->utf8_need = 3;
+      st->utf8_lo = c == 0xF0 ? 0x90 : 0x80;
+      st->utf8_hi = c == 0xF4 ? 0x8F : 0xBF;
+    } else {
+      return i;
+    }
+  }
+
+  return len;
+}
+
+static bool utf8_block_scalar(ScannerState *st, const uint8_t *block) {
+  return utf8_scalar(st, block, 64) == 64;
+}
+
+#ifdef SCANNER_X86
+// the lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than
+// One Instruction Per Byte": three table lookups on the nibbles of each byte
+// and the one before it classify every error of a two-byte window, longer
+// sequences are checked against the bytes two and three back
+enum {
+  TOO_SHORT = 1 << 0,
+  TOO_LONG = 1 << 1,
+  OVERLONG_3 = 1 << 2,
+  TOO_LARGE = 1 << 3,
+  SURROGATE = 1 << 4,
+  OVERLONG_2 = 1 << 5,
+  TOO_LARGE_1000 = 1 << 6,
+  OVERLONG_4 = 1 << 6,
+  TWO_CONTS = 1 << 7,
+  CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+};
+
+// indexed by the high nibble of the first byte of a pair
+static const uint8_t UTF8_BYTE_1_HIGH[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+
+// by its low nibble
+static const uint8_t UTF8_BYTE_1_LOW[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000};
+
+// by the high nibble of the second byte
+static const uint8_t UTF8_BYTE_2_HIGH[16] = {
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+        OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT};
+
+__attribute__((target("ssse3"))) static bool
+utf8_block_ssse3(ScannerState *st, const uint8_t *block) {
+  const __m128i byte_1_high =
+      _mm_loadu_si128((const __m128i *)UTF8_BYTE_1_HIGH);
+  const __m128i byte_1_low = _mm_loadu_si128((const __m128i *)UTF8_BYTE_1_LOW);
+  const __m128i byte_2_high =
+      _mm_loadu_si128((const __m128i *)UTF8_BYTE_2_HIGH);
+  // the last three bytes of a block may only start sequences that fit
+  const __m128i max_tail = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         -1, -1, -1, -1, (char)(0xF0 - 1),
+                                         (char)(0xE0 - 1), (char)(0xC0 - 1));
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+
+  __m128i prev = _mm_loadu_si128((const __m128i *)st->utf8_prev);
+  __m128i error = _mm_setzero_si128();
+  for (int i = 0; i < 4; i++) {
+    __m128i input = _mm_loadu_si128((const __m128i *)(block + i * 16));
+    __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(byte_1_high,
+                             _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high,
+                         _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+    // continuations required by a lead two or three bytes back
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80));
+    __m128i must23 =
+        _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+
+    error = _mm_or_si128(error, _mm_xor_si128(must23, special));
+    prev = input;
+  }
+
+  __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128((__m128i *)st->utf8_prev, prev);
+  st->utf8_incomplete =
+      _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(prev, max_tail), zero)) !=
+      0xFFFF;
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) == 0xFFFF;
+}
+#endif
+
+// the portable kernels until `scanner_init' picks the best ones
+static void (*classify)(const uint8_t *block, BlockMasks *m) = classify_scalar;
+static bool (*utf8_block)(ScannerState *st,
+                          const uint8_t *block) = utf8_block_scalar;
+static ScannerKind kind = SCANNER_SCALAR;
+
+// runs before `main', so every thread sees the kernels it picked without a
+// lock. The SIMD kernels need a GNU compiler, which has constructors
+#ifdef SCANNER_X86
+__attribute__((constructor)) static void scanner_init(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kind = SCANNER_AVX2;
+    classify = classify_avx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kind = SCANNER_SSE2;
+    classify = classify_sse2;
+  }
+
+  if (__builtin_cpu_supports("ssse3")) {
+    utf8_block = utf8_block_ssse3;
+  }
+}
+#endif
+
+ScannerKind scanner_kind(void) { return kind; }
+
+static inline uint64_t prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// returns the characters escaped by an odd-length run of backslashes.
+// `prev_odd' carries a run that ended on the last byte of the previous block.
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t *prev_odd) {
+  const uint64_t even_bits = 0x5555555555555555ULL;
+  const uint64_t odd_bits = ~even_bits;
+
+  uint64_t start_edges = backslash & ~(backslash << 1);
+  uint64_t even_start_mask = even_bits ^ *prev_odd;
+  uint64_t even_starts = start_edges & even_start_mask;
+  uint64_t odd_starts = start_edges & ~even_start_mask;
+
+  uint64_t even_carries = backslash + even_starts;
+  uint64_t odd_carries;
+  bool ends_odd = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+  odd_carries |= *prev_odd;
+  *prev_odd = ends_odd;
+
+  uint64_t even_carry_ends = even_carries & ~backslash;
+  uint64_t odd_carry_ends = odd_carries & ~backslash;
+
+  return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+static inline bool is_hex(char c) {
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+// offset of the first backslash before one of the `escaped' characters that
+// does not start `\"\\/bfnrt' or `\u' and four hex digits, `len' if there is
+// none. Escapes are rare enough to be checked a byte at a time
+static size_t find_bad_escape(const char *source, size_t len, size_t base,
+                              uint64_t escaped) {
+  for (; escaped; escaped &= escaped - 1) {
+    size_t pos = base + __builtin_ctzll(escaped);
+    if (pos >= len) {
+      // cut off by the end of the input, reported as an unterminated string
+      break;
+    }
+
+    const char *c = source + pos;
+    switch (*c) {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+      continue;
+    case 'u':
+      if (len - pos > 4 && is_hex(c[1]) && is_hex(c[2]) && is_hex(c[3]) &&
+          is_hex(c[4])) {
+        continue;
+      }
+      return pos - 1;
+    default:
+      return pos - 1;
+    }
+  }
+
+  return len;
+}
+
+static inline bool index_reserve(StructuralIndex *index, size_t extra) {
+  if (index->cap - index->len >= extra) {
+    return true;
+  }
+
+  size_t new_cap = index->cap ? index->cap * 2 : 1024;
+  while (new_cap - index->len < extra) {
+    new_cap *= 2;
+  }
+
+  uint32_t *positions =
+      mem_realloc(index->arena, index->positions,
+                  index->cap * sizeof(uint32_t), new_cap * sizeof(uint32_t));
+  if (!positions) {
+    return false;
+  }
+
+  index->positions = positions;
+  index->cap = new_cap;
+  return true;
+}
+
+// offset of the first invalid UTF-8 byte of the block at `base', once the
+// vector validator found one
+static size_t utf8_locate(const char *source, size_t len, size_t base) {
+  const uint8_t *s = (const uint8_t *)source;
+
+  // back to the lead byte of a sequence that may continue into the block
+  size_t start = base;
+  for (size_t i = 1; i <= 3 && i <= base; i++) {
+    if (s[base - i] >= 0xC0) {
+      start = base - i;
+      break;
+    }
+  }
+
+  size_t end = len - base < 64 ? len : base + 64;
+  ScannerState st = {0};
+  return start + utf8_scalar(&st, s + start, end - start);
+}
+
+// structural bits of the block at `base', false with `error' set when the
+// block is invalid
+static inline bool scanner_block(ScannerState *st, const uint8_t *block,
+                                 const char *source, size_t len, size_t base,
+                                 uint64_t *bits, JSONError *error) {
+  BlockMasks m;
+  classify(block, &m);
+
+  uint64_t escaped = find_escaped(m.backslash, &st->prev_odd);
+  uint64_t quotes = m.quote & ~escaped;
+
+  // the opening quote and the contents of a string are inside of it
+  uint64_t in_string = prefix_xor(quotes) ^ st->prev_in_string;
+  st->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+  uint64_t opening = quotes & in_string;
+  if (opening) {
+    st->string_start = base + 63 - __builtin_clzll(opening);
+  }
+
+  // the first of the errors of the block is reported, whatever its kind
+  JSONError bad = {JSON_OK, len};
+  uint64_t control = m.control & in_string;
+  if (control) {
+    bad = (JSONError){JSON_ERROR_CONTROL, base + __builtin_ctzll(control)};
+  }
+
+  if (escaped & in_string) {
+    size_t pos = find_bad_escape(source, len, base, escaped & in_string);
+    if (pos < bad.offset) {
+      bad = (JSONError){JSON_ERROR_ESCAPE, pos};
+    }
+  }
+
+  // a block after one with multi-byte sequences is checked as well, for one
+  // that was cut off
+  if ((m.high || st->utf8_dirty) && !utf8_block(st, block)) {
+    size_t pos = utf8_locate(source, len, base);
+    if (bad.code == JSON_OK || pos < bad.offset) {
+      bad = (JSONError){JSON_ERROR_UTF8, pos};
+    }
+  }
+  if (bad.code != JSON_OK) {
+    *error = bad;
+    return false;
+  }
+  st->utf8_dirty = m.high != 0;
+
+  uint64_t scalar = ~(m.op | m.whitespace | m.quote | in_string);
+  uint64_t scalar_starts = scalar & ~(scalar << 1 | st->prev_scalar);
+  st->prev_scalar = scalar >> 63;
+
+  *bits = (m.op & ~in_string) | opening | scalar_starts;
+  return true;
+}
+
+// errors only visible once the whole input was seen
+static bool scanner_finish(const ScannerState *st, size_t len,
+                           JSONError *error) {
+  if (st->prev_in_string) {
+    *error = (JSONError){JSON_ERROR_UNTERMINATED_STRING, st->string_start};
+    return false;
+  }
+  if (st->utf8_dirty && (st->utf8_need || st->utf8_incomplete)) {
+    *error = (JSONError){JSON_ERROR_UTF8, len};
+    return false;
+  }
+
+  return true;
+}
+
+static bool scanner_build(StructuralIndex *index, const char *source,
+                          size_t len) {
+  index->len = 0;
+  index->error = (JSONError){JSON_OK, 0};
+  if (len > UINT32_MAX) {
+    index->error = (JSONError){JSON_ERROR_TOO_LARGE, 0};
+    return false;
+  }
+
+  ScannerState st = {0};
+  uint8_t tail[64];
+
+  for (size_t base = 0; base < len; base += 64) {
+    const uint8_t *block = (const uint8_t *)source + base;
+    if (len - base < 64) {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, block, len - base);
+      block = tail;
+    }
+
+    uint64_t bits;
+    if (!scanner_block(&st, block, source, len, base, &bits, &index->error)) {
+      return false;
+    }
+
+    if (!index_reserve(index, 64)) {
+      index->error = (JSONError){JSON_ERROR_MEMORY, base};
+      return false;
+    }
+
+    uint32_t *out = index->positions + index->len;
+    while (bits) {
+      *out++ = (uint32_t)(base + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+    index->len = out - index->positions;
+  }
+
+  return scanner_finish(&st, len, &index->error);
+}
+
+bool scanner_index(StructuralIndex *index, const char *source, size_t len) {
+  JSON_STATS_TIMER(start);
+  bool ok = scanner_build(index, source, len);
+  JSON_STATS_ADD(bytes_scanned, len);
+  JSON_STATS_ELAPSED(index_ns, start);
+  return ok;
+}
+
+JSONError scanner_each(const char *source, size_t len, ScannerFn fn,
+                       void *ctx) {
+  ScannerState st = {0};
+  JSONError error = {JSON_OK, 0};
+  uint8_t tail[64];
+
+  for (size_t base = 0; base < len; base += 64) {
+    const uint8_t *block = (const uint8_t *)source + base;
+    if (len - base < 64) {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, block, len - base);
+      block = tail;
+    }
+
+    uint64_t bits;
+    if (!scanner_block(&st, block, source, len, base, &bits, &error)) {
+      return error;
+    }
+    if (bits && !fn(ctx, base, bits)) {
+      return error;
+    }
+  }
+
+  scanner_finish(&st, len, &error);
+  return error;
+}
+
+void scanner_index_free(StructuralIndex *index) {
+  mem_free(index->arena, index->positions);
+  index->positions = NULL;
+  index->len = 0;
+  index->cap = 0;
+}
@@ -0,0 +1,57 @@
+#include "arena.h"
+#include "error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+/**
+ * Stage-1 index of a JSON document: the offsets of every structural
+ * character (`{}[]:,'), of every opening quote and of the first byte of every
+ * number or literal, in source order. Characters inside strings, including
+ * escaped quotes, never appear in the index.
+ */
+typedef struct {
+  uint32_t *positions;
+  size_t len;
+  size_t cap;
+  Arena *arena;
+  // why the last `scanner_index' failed
+  JSONError error;
+} StructuralIndex;
+
+typedef enum {
+  SCANNER_SCALAR,
+  SCANNER_SSE2,
+  SCANNER_AVX2,
+} ScannerKind;
+
+/**
+ * Fills `index' for the `len' bytes of `source', replacing its previous
+ * contents. Returns false with `index->error' set when the input is not
+ * UTF-8, a string is left unterminated or holds a control character or an
+ * invalid escape sequence, or the index cannot grow. The best kernel for
+ * the running CPU is picked when the program starts.
+ */
+bool scanner_index(StructuralIndex *index, const char *source, size_t len);
+
+// index entries of the 64 bytes at `base', one bit per byte. Returning false
+// stops the scan
+typedef bool (*ScannerFn)(void *ctx, size_t base, uint64_t bits);
+
+/**
+ * Same checks as `scanner_index' without building an index: the entries are
+ * handed to `fn' a block at a time, so nothing is allocated and there is no
+ * size limit. Returns the first error, `JSON_OK' also when `fn' stopped the
+ * scan.
+ */
+JSONError scanner_each(const char *source, size_t len, ScannerFn fn,
+                       void *ctx);
+
+void scanner_index_free(StructuralIndex *index);
+
+ScannerKind scanner_kind(void);
+
+#endif
@@ -0,0 +1,640 @@
+#include "snapshot.h"
+#include "intern.h"
+#include <stdio.h>
+
+#define SNAP_MAGIC "JSONSNAP"
+#define SNAP_BYTE_ORDER 0x01020304u
+#define SNAP_SEED 0x9E3779B97F4A7C15ull
+// tables are at least this big, which keeps them a multiple of 8 bytes
+#define SNAP_MIN_CAP 16
+
+struct JSONSnapNode {
+  uint32_t type;
+  uint32_t len;
+  // bits of the number, offset of the string or of the body
+  uint64_t payload;
+};
+
+typedef struct {
+  // low half of the key's hash, which also picks its slot
+  uint32_t hash;
+  uint32_t key_len;
+  uint64_t key;
+  JSONSnapNode value;
+} SnapMember;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t size;
+  uint64_t seed;
+  uint64_t strings;
+  uint64_t strings_len;
+  JSONSnapNode root;
+} SnapHeader;
+
+_Static_assert(sizeof(SnapHeader) == 64, "header is 64 bytes");
+_Static_assert(sizeof(SnapMember) == 32, "members are 32 bytes");
+
+// table size of an object of `n' members, loaded at most half
+static inline size_t snap_cap(size_t n) {
+  size_t cap = SNAP_MIN_CAP;
+  while (cap < 2 * n) {
+    cap *= 2;
+  }
+
+  return cap;
+}
+
+typedef struct {
+  // header and bodies
+  char *data;
+  size_t len;
+  size_t cap;
+  char *strings;
+  size_t strings_len;
+  size_t strings_cap;
+  // pool offset + 1 of every interned key by symbol id, 0 until written
+  uint64_t *keys;
+  size_t keys_cap;
+  JSONInterner *interner;
+  bool ok;
+} SnapWriter;
+
+// makes room for `len' more bytes in a buffer of the writer
+static bool snap_grow(SnapWriter *w, char **data, size_t *cap, size_t used,
+                      size_t len) {
+  if (!w->ok || *cap - used >= len) {
+    return w->ok;
+  }
+
+  size_t new_cap = *cap ? *cap : 4096;
+  while (new_cap - used < len) {
+    new_cap *= 2;
+  }
+
+  char *new_data = realloc(*data, new_cap);
+  if (!new_data) {
+    w->ok = false;
+    return false;
+  }
+
+  *data = new_data;
+  *cap = new_cap;
+  return true;
+}
+
+// offset of `len' zeroed bytes at the end of the bodies
+static size_t snap_reserve(SnapWriter *w, size_t len) {
+  if (!snap_grow(w, &w->data, &w->cap, w->len, len)) {
+    return 0;
+  }
+
+  size_t at = w->len;
+  memset(w->data + at, 0, len);
+  w->len += len;
+  return at;
+}
+
+static uint64_t snap_string(SnapWriter *w, const char *str, size_t len) {
+  if (!snap_grow(w, &w->strings, &w->strings_cap, w->strings_len, len + 1)) {
+    return 0;
+  }
+
+  size_t at = w->strings_len;
+  memcpy(w->strings + at, str, len);
+  w->strings[at + len] = '\0';
+  w->strings_len += len + 1;
+  return at;
+}
+
+// keys repeat across objects, each is stored once
+static uint64_t snap_key(SnapWriter *w, const char *key, size_t len) {
+  const JSONSymbol *sym = w->ok ? json_intern(w->interner, key, len) : NULL;
+  if (!sym) {
+    w->ok = false;
+    return 0;
+  }
+
+  if (sym->id >= w->keys_cap) {
+    size_t cap = w->keys_cap ? 2 * w->keys_cap : 256;
+    uint64_t *keys = realloc(w->keys, cap * sizeof(uint64_t));
+    if (!keys) {
+      w->ok = false;
+      return 0;
+    }
+
+    memset(keys + w->keys_cap, 0, (cap - w->keys_cap) * sizeof(uint64_t));
+    w->keys = keys;
+    w->keys_cap = cap;
+  }
+
+  if (!w->keys[sym->id]) {
+    w->keys[sym->id] = snap_string(w, key, len) + 1;
+  }
+
+  return w->keys[sym->id] - 1;
+}
+
+// keys by their bytes, a key before the longer ones it is a prefix of
+static int snap_key_cmp(const void *a, const void *b) {
+  const BucketJSON *x = *(BucketJSON *const *)a;
+  const BucketJSON *y = *(BucketJSON *const *)b;
+  size_t len = x->key_len < y->key_len ? x->key_len : y->key_len;
+  int c = memcmp(x->key, y->key, len);
+  return c ? c : (x->key_len > y->key_len) - (x->key_len < y->key_len);
+}
+
+// writes `json' into the node at offset `at', its body after everything
+// written so far
+static void snap_node(SnapWriter *w, JSON json, size_t at) {
+  JSONSnapNode node = {.type = json.type};
+
+  switch (json.type) {
+  case OBJECT: {
+    struct HashMapJSON *map = json.map;
+    size_t n = map ? map->size : 0;
+    if (n > UINT32_MAX / 2) {
+      w->ok = false;
+      return;
+    }
+
+    size_t cap = n > JSON_SNAPSHOT_SMALL_MAX ? snap_cap(n) : 0;
+    size_t body =
+        snap_reserve(w, n * sizeof(SnapMember) + cap * sizeof(uint32_t));
+
+    // members in the order of their keys, so the image depends neither on
+    // the hash seed nor on the order they were added in
+    BucketJSON **sorted = n ? malloc(n * sizeof(BucketJSON *)) : NULL;
+    if (n && !sorted) {
+      w->ok = false;
+      return;
+    }
+
+    size_t i = 0;
+    for (size_t b = 0; i < n && b < map->cap; b++) {
+      if (map->values[b].key) {
+        sorted[i++] = &map->values[b];
+      }
+    }
+    if (n) {
+      qsort(sorted, n, sizeof(BucketJSON *), snap_key_cmp);
+    }
+
+    for (i = 0; w->ok && i < n; i++) {
+      BucketJSON *bucket = sorted[i];
+      SnapMember m = {
+          .hash = (uint32_t)json_hash_wy(bucket->key, bucket->key_len,
+                                         SNAP_SEED),
+          .key_len = bucket->key_len,
+          .key = snap_key(w, bucket->key, bucket->key_len),
+      };
+      size_t member = body + i * sizeof(SnapMember);
+      if (w->ok) {
+        memcpy(w->data + member, &m, sizeof(SnapMember));
+        snap_node(w, bucket->value, member + offsetof(SnapMember, value));
+      }
+    }
+    free(sorted);
+
+    if (cap && w->ok) {
+      const SnapMember *members = (const SnapMember *)(w->data + body);
+      uint32_t *slots = (uint32_t *)(members + n);
+      for (size_t k = 0; k < n; k++) {
+        size_t s = members[k].hash & (cap - 1);
+        while (slots[s]) {
+          s = (s + 1) & (cap - 1);
+        }
+        slots[s] = (uint32_t)k + 1;
+      }
+    }
+
+    node.len = (uint32_t)n;
+    node.payload = body;
+    break;
+  }
+  case ARRAY: {
+    struct VectorJSON *vec = json.vec;
+    size_t n = vec ? vec->len : 0;
+    if (n > UINT32_MAX) {
+      w->ok = false;
+      return;
+    }
+
+    size_t body = snap_reserve(w, n * sizeof(JSONSnapNode));
+    for (size_t i = 0; w->ok && i < n; i++) {
+      snap_node(w, vec->items[i], body + i * sizeof(JSONSnapNode));
+    }
+
+    node.len = (uint32_t)n;
+    node.payload = body;
+    break;
+  }
+  case STRING:
+    if (json.len > UINT32_MAX) {
+      w->ok = false;
+      return;
+    }
+
+    node.len = (uint32_t)json.len;
+    node.payload = snap_string(w, json.str, json.len);
+    break;
+  case NUMBER:
+    memcpy(&node.payload, &json.d, sizeof(double));
+    break;
+  case INTEGER:
+  case UNSIGNED:
+    node.payload = json.u;
+    break;
+  case BOOLEAN:
+    node.payload = json.b;
+    break;
+  case NIL:
+    break;
+  }
+
+  if (w->ok) {
+    memcpy(w->data + at, &node, sizeof(JSONSnapNode));
+  }
+}
+
+// lays out the snapshot of `json' in the bodies and the pool of `w'
+static bool snap_build(SnapWriter *w, JSON json) {
+  *w = (SnapWriter){.interner = json_interner_new(), .ok = json.ok};
+  if (!w->interner) {
+    w->ok = false;
+  }
+
+  snap_reserve(w, sizeof(SnapHeader));
+  snap_node(w, json, offsetof(SnapHeader, root));
+  if (!w->ok) {
+    return false;
+  }
+
+  SnapHeader *h = (SnapHeader *)w->data;
+  memcpy(h->magic, SNAP_MAGIC, sizeof(h->magic));
+  h->version = JSON_SNAPSHOT_VERSION;
+  h->byte_order = SNAP_BYTE_ORDER;
+  h->size = w->len + w->strings_len;
+  h->seed = SNAP_SEED;
+  h->strings = w->len;
+  h->strings_len = w->strings_len;
+  return true;
+}
+
+static void snap_writer_free(SnapWriter *w) {
+  free(w->data);
+  free(w->strings);
+  free(w->keys);
+  json_interner_free(w->interner);
+}
+
+bool json_snapshot_write(JSONBuffer *buf, JSON json) {
+  SnapWriter w;
+  if (snap_build(&w, json)) {
+    json_buffer_write(buf, w.data, w.len);
+    // documents without strings have no pool
+    if (w.strings_len) {
+      json_buffer_write(buf, w.strings, w.strings_len);
+    }
+  } else {
+    buf->ok = false;
+  }
+
+  snap_writer_free(&w);
+  return buf->ok;
+}
+
+bool json_snapshot_save(JSON json, const char *path) {
+  SnapWriter w;
+  bool ok = snap_build(&w, json);
+
+  FILE *f = ok ? fopen(path, "wb") : NULL;
+  ok = f && fwrite(w.data, 1, w.len, f) == w.len &&
+       (!w.strings_len ||
+        fwrite(w.strings, 1, w.strings_len, f) == w.strings_len);
+  if (f && fclose(f) != 0) {
+    ok = false;
+  }
+
+  snap_writer_free(&w);
+  return ok;
+}
+
+static inline const SnapHeader *snap_header(const JSONSnapshot *snap) {
+  return (const SnapHeader *)snap->data;
+}
+
+JSONSnapshot json_snapshot_load(const void *data, size_t len) {
+  const SnapHeader *h = data;
+  if (!data || (uintptr_t)data % 8 != 0 || len < sizeof(SnapHeader) ||
+      memcmp(h->magic, SNAP_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != JSON_SNAPSHOT_VERSION ||
+      h->byte_order != SNAP_BYTE_ORDER || h->size != len ||
+      h->strings < sizeof(SnapHeader) || h->strings % 8 != 0 ||
+      h->strings > len || h->strings_len != len - h->strings) {
+    return (JSONSnapshot){0};
+  }
+
+  return (JSONSnapshot){.ok = true, .data = data, .len = len};
+}
+
+JSONSnapshot json_snapshot_open(const char *path) {
+  // lookups touch a few scattered pages, read-ahead would only waste memory
+  JSONMap map;
+  if (json_map_file(&map, path, false) != JSON_OK) {
+    return (JSONSnapshot){0};
+  }
+
+  JSONSnapshot snap = json_snapshot_load(map.data, map.len);
+  if (!snap.ok) {
+    json_unmap_file(&map);
+    return snap;
+  }
+
+  snap.map = map;
+  return snap;
+}
+
+void json_snapshot_close(JSONSnapshot *snap) {
+  json_unmap_file(&snap->map);
+  *snap = (JSONSnapshot){0};
+}
+
+JSONSnapValue json_snapshot_root(const JSONSnapshot *snap) {
+  if (!snap->ok) {
+    return (JSONSnapValue){0};
+  }
+
+  return (JSONSnapValue){.snap = snap, .node = &snap_header(snap)->root};
+}
+
+// the `len' bytes of the pool at `off', NULL unless they are in it and
+// followed by a NUL
+static const char *snap_str(const JSONSnapshot *snap, uint64_t off,
+                            uint64_t len) {
+  const SnapHeader *h = snap_header(snap);
+  if (off >= h->strings_len || len >= h->strings_len - off) {
+    return NULL;
+  }
+
+  const char *str = snap->data + h->strings + off;
+  return str[len] == '\0' ? str : NULL;
+}
+
+// body of the container at `v' when it lies between the value and the pool,
+// which also keeps a damaged snapshot from looping back on itself
+static const char *snap_body(JSONSnapValue v, enum JSONType type) {
+  if (!v.node || v.node->type != type) {
+    return NULL;
+  }
+
+  size_t n = v.node->len;
+  size_t size = type == ARRAY ? n * sizeof(JSONSnapNode)
+                              : n * sizeof(SnapMember) +
+                                    (n > JSON_SNAPSHOT_SMALL_MAX
+                                         ? snap_cap(n) * sizeof(uint32_t)
+                                         : 0);
+
+  uint64_t at = (uint64_t)((const char *)v.node - v.snap->data);
+  uint64_t off = v.node->payload;
+  uint64_t end = snap_header(v.snap)->strings;
+  if (off <= at || off % 8 != 0 || off > end || size > end - off) {
+    return NULL;
+  }
+
+  return v.snap->data + off;
+}
+
+enum JSONType json_snapshot_type(JSONSnapValue v) {
+  return (enum JSONType)v.node->type;
+}
+
+size_t json_snapshot_len(JSONSnapValue v) {
+  if (!v.node) {
+    return 0;
+  }
+
+  switch (v.node->type) {
+  case OBJECT:
+  case ARRAY:
+  case STRING:
+    return v.node->len;
+  default:
+    return 0;
+  }
+}
+
+static inline bool snap_match(const JSONSnapshot *snap, const SnapMember *m,
+                              const char *key, size_t len, uint32_t hash) {
+  if (m->hash != hash || m->key_len != len) {
+    return false;
+  }
+
+  const char *k = snap_str(snap, m->key, m->key_len);
+  return k && memcmp(k, key, len) == 0;
+}
+
+JSONSnapValue json_snapshot_get_n(JSONSnapValue v, const char *key,
+                                  size_t len) {
+  const SnapMember *members = (const SnapMember *)snap_body(v, OBJECT);
+  if (!members) {
+    return (JSONSnapValue){0};
+  }
+
+  size_t n = v.node->len;
+  uint32_t hash =
+      (uint32_t)json_hash_wy(key, len, snap_header(v.snap)->seed);
+
+  if (n <= JSON_SNAPSHOT_SMALL_MAX) {
+    for (size_t i = 0; i < n; i++) {
+      if (snap_match(v.snap, &members[i], key, len, hash)) {
+        return (JSONSnapValue){.snap = v.snap, .node = &members[i].value};
+      }
+    }
+
+    return (JSONSnapValue){0};
+  }
+
+  const uint32_t *slots = (const uint32_t *)(members + n);
+  size_t mask = snap_cap(n) - 1;
+  // a table without an empty slot is damaged, give up after one round
+  for (size_t s = hash & mask, probes = 0; probes <= mask;
+       s = (s + 1) & mask, probes++) {
+    uint32_t i = slots[s];
+    if (i == 0 || i > n) {
+      break;
+    }
+    if (snap_match(v.snap, &members[i - 1], key, len, hash)) {
+      return (JSONSnapValue){.snap = v.snap, .node = &members[i - 1].value};
+    }
+  }
+
+  return (JSONSnapValue){0};
+}
+
+JSONSnapValue json_snapshot_get(JSONSnapValue v, const char *key) {
+  return json_snapshot_get_n(v, key, strlen(key));
+}
+
+JSONSnapValue json_snapshot_at(JSONSnapValue v, size_t index) {
+  const JSONSnapNode *items = (const JSONSnapNode *)snap_body(v, ARRAY);
+  if (!items || index >= v.node->len) {
+    return (JSONSnapValue){0};
+  }
+
+  return (JSONSnapValue){.snap = v.snap, .node = &items[index]};
+}
+
+JSONSnapValue json_snapshot_member(JSONSnapValue v, size_t index,
+                                   StringView *key) {
+  const SnapMember *members = (const SnapMember *)snap_body(v, OBJECT);
+  if (!members || index >= v.node->len) {
+    return (JSONSnapValue){0};
+  }
+
+  const SnapMember *m = &members[index];
+  if (key) {
+    key->str = snap_str(v.snap, m->key, m->key_len);
+    key->len = m->key_len;
+    if (!key->str) {
+      return (JSONSnapValue){0};
+    }
+  }
+
+  return (JSONSnapValue){.snap = v.snap, .node = &m->value};
+}
+
+const char *json_snapshot_string(JSONSnapValue v, size_t *len) {
+  if (!v.node || v.node->type != STRING) {
+    return NULL;
+  }
+
+  if (len) {
+    *len = v.node->len;
+  }
+
+  return snap_str(v.snap, v.node->payload, v.node->len);
+}
+
+bool json_snapshot_double(JSONSnapValue v, double *out) {
+  if (!v.node) {
+    return false;
+  }
+
+  switch (v.node->type) {
+  case NUMBER:
+    memcpy(out, &v.node->payload, sizeof(double));
+    return true;
+  case INTEGER:
+    *out = (double)(int64_t)v.node->payload;
+    return true;
+  case UNSIGNED:
+    *out = (double)v.node->payload;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool json_snapshot_int64(JSONSnapValue v, int64_t *out) {
+  if (!v.node || v.node->type != INTEGER) {
+    return false;
+  }
+
+  *out = (int64_t)v.node->payload;
+  return true;
+}
+
+bool json_snapshot_uint64(JSONSnapValue v, uint64_t *out) {
+  if (!v.node) {
+    return false;
+  }
+  if (v.node->type != UNSIGNED &&
+      !(v.node->type == INTEGER && (int64_t)v.node->payload >= 0)) {
+    return false;
+  }
+
+  *out = v.node->payload;
+  return true;
+}
+
+bool json_snapshot_bool(JSONSnapValue v) {
+  return v.node && v.node->type == BOOLEAN && v.node->payload;
+}
+
+static JSON snap_value(JSONSnapValue v, Arena *arena, size_t depth) {
+  if (!v.node || depth > JSON_MAX_DEPTH) {
+    return (JSON){.ok = false};
+  }
+
+  JSON json = {.ok = true, .type = (enum JSONType)v.node->type};
+  switch (v.node->type) {
+  case OBJECT: {
+    size_t n = v.node->len;
+    if (!snap_body(v, OBJECT) ||
+        !(json.map = hashmap_json_new_cap(arena, n))) {
+      return (JSON){.ok = false};
+    }
+    json.map->borrow_keys = true;
+
+    for (size_t i = 0; i < n && json.ok; i++) {
+      StringView key;
+      JSON value =
+          snap_value(json_snapshot_member(v, i, &key), arena, depth + 1);
+      if (!value.ok) {
+        json.ok = false;
+        break;
+      }
+      hashmap_json_set_n(json.map, key.str, key.len, value);
+    }
+    break;
+  }
+  case ARRAY: {
+    size_t n = v.node->len;
+    if (!snap_body(v, ARRAY) || !(json.vec = vector_json_new_in(arena))) {
+      return (JSON){.ok = false};
+    }
+
+    for (size_t i = 0; i < n && json.ok; i++) {
+      JSON value = snap_value(json_snapshot_at(v, i), arena, depth + 1);
+      if (!value.ok) {
+        json.ok = false;
+        break;
+      }
+      vector_json_push(json.vec, value);
+    }
+    break;
+  }
+  case STRING:
+    json.str = json_snapshot_string(v, &json.len);
+    json.ok = json.str != NULL;
+    break;
+  case NUMBER:
+    json_snapshot_double(v, &json.d);
+    break;
+  case INTEGER:
+  case UNSIGNED:
+    json.u = v.node->payload;
+    break;
+  case BOOLEAN:
+    json.b = v.node->payload != 0;
+    break;
+  case NIL:
+    break;
+  default:
+    return (JSON){.ok = false};
+  }
+
+  if (!json.ok) {
+    json_free(json);
+    return (JSON){.ok = false};
+  }
+
+  return json;
+}
+
+JSON json_snapshot_value(JSONSnapValue v, Arena *arena) {
+  return snap_value(v, arena, 0);
+}
@@ -0,0 +1,112 @@
+#include "file.h"
+#include "stringify.h"
+#include <stdint.h>
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#define JSON_SNAPSHOT_VERSION 1
+
+/**
+ * Binary image of a `JSON' tree, used straight from memory: loading one is
+ * checking its header, and lookups read the image in place without building
+ * any map or vector.
+ *
+ * - a 64-byte header: magic, version, byte order, total size, hash seed, the
+ *   offset and length of the string pool and the root value
+ * - values are 16 bytes: the `JSONType', a 32-bit length (bytes of a string,
+ *   elements or members of a container) and a payload. Numbers and booleans
+ *   are stored inline, strings as an offset into the pool and containers as
+ *   the offset of their body, which always lies after the value
+ * - array bodies are their values back to back
+ * - object bodies are their members sorted by the bytes of their keys, each
+ *   the hash, length and pool offset of the key followed by the value. The
+ *   order depends neither on the hash seed nor on the order members were
+ *   added in, so equal documents give byte-identical images. Objects of
+ *   more than `JSON_SNAPSHOT_SMALL_MAX' members are followed by a table of
+ *   member index + 1 by the hash of the key, probed linearly
+ * - the pool holds every string with a NUL terminator, each key only once
+ *
+ * Offsets are from the start of the image, everything is 8-byte aligned and
+ * in the byte order of the machine that wrote it. Images from another byte
+ * order or version are rejected.
+ */
+typedef struct JSONSnapNode JSONSnapNode;
+
+// objects up to this many members are searched without their table
+#define JSON_SNAPSHOT_SMALL_MAX 8
+
+typedef struct {
+  bool ok;
+  const char *data;
+  size_t len;
+  // only set for `json_snapshot_open'
+  JSONMap map;
+} JSONSnapshot;
+
+/**
+ * A value in a snapshot. Values are plain handles, copying one is free. A
+ * failed lookup gives a value with a NULL `node'.
+ */
+typedef struct {
+  const JSONSnapshot *snap;
+  const JSONSnapNode *node;
+} JSONSnapValue;
+
+/**
+ * Appends the snapshot of `json' to `buf'. Fails when a string or a container
+ * exceeds 4G bytes or elements. Returns `buf->ok'.
+ */
+bool json_snapshot_write(JSONBuffer *buf, JSON json);
+// writes the snapshot of `json' to the file at `path'
+bool json_snapshot_save(JSON json, const char *path);
+
+/**
+ * Maps the snapshot at `path'. Pages are read when lookups first touch them,
+ * and shared with every other process that maps the same file.
+ */
+JSONSnapshot json_snapshot_open(const char *path);
+
+/**
+ * Uses the `len' bytes at `data', which must be 8-byte aligned and outlive
+ * the snapshot, as an image written by `json_snapshot_write'.
+ */
+JSONSnapshot json_snapshot_load(const void *data, size_t len);
+void json_snapshot_close(JSONSnapshot *snap);
+
+// the document, with a NULL `node' when `snap' is not ok
+JSONSnapValue json_snapshot_root(const JSONSnapshot *snap);
+
+static inline bool json_snapshot_ok(JSONSnapValue v) { return v.node != NULL; }
+
+// type of a value that is ok
+enum JSONType json_snapshot_type(JSONSnapValue v);
+// members of an object, elements of an array, bytes of a string, 0 otherwise
+size_t json_snapshot_len(JSONSnapValue v);
+
+// value of member `key' of the object at `v'
+JSONSnapValue json_snapshot_get_n(JSONSnapValue v, const char *key,
+                                  size_t len);
+JSONSnapValue json_snapshot_get(JSONSnapValue v, const char *key);
+// element `index' of the array at `v'
+JSONSnapValue json_snapshot_at(JSONSnapValue v, size_t index);
+// value of member `index' of the object at `v', its key into `key' if set.
+// Members are in the byte order of their keys
+JSONSnapValue json_snapshot_member(JSONSnapValue v, size_t index,
+                                   StringView *key);
+
+// NUL-terminated contents of the string at `v', NULL when it is none
+const char *json_snapshot_string(JSONSnapValue v, size_t *len);
+// the number at `v', false when it is none or does not fit
+bool json_snapshot_double(JSONSnapValue v, double *out);
+bool json_snapshot_int64(JSONSnapValue v, int64_t *out);
+bool json_snapshot_uint64(JSONSnapValue v, uint64_t *out);
+bool json_snapshot_bool(JSONSnapValue v);
+
+/**
+ * Builds the `JSON' tree of the value at `v'. Strings and keys point into the
+ * snapshot, so it must outlive the tree. `arena' may be NULL.
+ */
+JSON json_snapshot_value(JSONSnapValue v, Arena *arena);
+
+#endif
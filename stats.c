@@ -0,0 +1,223 @@
+#include "stats.h"
+#include "json.h"
+#include "stringify.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+_Static_assert(JSON_STATS_TOKENS == TOK_NONE, "a counter per token type");
+// merged as an array of counters
+_Static_assert(sizeof(JSONStats) % sizeof(uint64_t) == 0, "only counters");
+
+static const char *TOKEN_NAMES[JSON_STATS_TOKENS] = {
+    "whitespace", "brace_left", "brace_right", "bracket_left", "bracket_right",
+    "colon",      "comma",      "string",      "number",       "integer",
+    "unsigned",   "boolean",    "null"};
+
+static const char *PROBE_NAMES[JSON_STATS_PROBES] = {
+    "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+"};
+
+void json_stats_merge(JSONStats *into, const JSONStats *from) {
+  uint64_t max_depth = into->max_depth > from->max_depth ? into->max_depth
+                                                         : from->max_depth;
+
+  uint64_t *a = (uint64_t *)into;
+  const uint64_t *b = (const uint64_t *)from;
+  for (size_t i = 0; i < sizeof(JSONStats) / sizeof(uint64_t); i++) {
+    a[i] += b[i];
+  }
+
+  into->max_depth = max_depth;
+}
+
+#ifdef JSON_STATS
+_Thread_local JSONStats json_stats_current;
+static _Thread_local JSONStats last;
+
+// every thread adds to it when a parse ends
+static JSONStats total;
+static atomic_flag total_lock = ATOMIC_FLAG_INIT;
+
+uint64_t json_stats_now(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  if (!freq.QuadPart) {
+    QueryPerformanceFrequency(&freq);
+  }
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return (uint64_t)(now.QuadPart * (1e9 / (double)freq.QuadPart));
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void total_add(const JSONStats *stats) {
+  while (atomic_flag_test_and_set_explicit(&total_lock, memory_order_acquire)) {
+  }
+  json_stats_merge(&total, stats);
+  atomic_flag_clear_explicit(&total_lock, memory_order_release);
+}
+
+void json_stats_flush(void) {
+  total_add(&json_stats_current);
+  json_stats_current = (JSONStats){0};
+}
+
+void json_stats_begin(void) { json_stats_flush(); }
+
+void json_stats_end(void) {
+  last = json_stats_current;
+  json_stats_flush();
+}
+
+JSONStats json_stats_take(void) {
+  JSONStats stats = json_stats_current;
+  json_stats_current = (JSONStats){0};
+  return stats;
+}
+
+JSONStats json_stats_last(void) { return last; }
+
+JSONStats json_stats_total(void) {
+  while (atomic_flag_test_and_set_explicit(&total_lock, memory_order_acquire)) {
+  }
+  JSONStats stats = total;
+  atomic_flag_clear_explicit(&total_lock, memory_order_release);
+
+  json_stats_merge(&stats, &json_stats_current);
+  return stats;
+}
+
+void json_stats_reset(void) {
+  while (atomic_flag_test_and_set_explicit(&total_lock, memory_order_acquire)) {
+  }
+  total = (JSONStats){0};
+  atomic_flag_clear_explicit(&total_lock, memory_order_release);
+
+  json_stats_current = (JSONStats){0};
+  last = (JSONStats){0};
+}
+#else
+void json_stats_begin(void) {}
+void json_stats_end(void) {}
+JSONStats json_stats_take(void) { return (JSONStats){0}; }
+JSONStats json_stats_last(void) { return (JSONStats){0}; }
+JSONStats json_stats_total(void) { return (JSONStats){0}; }
+void json_stats_flush(void) {}
+void json_stats_reset(void) {}
+#endif
+
+typedef struct {
+  JSONBuffer *buf;
+  bool as_json;
+  // no separator before the first member of an object
+  bool first;
+} StatsWriter;
+
+static void dump_name(StatsWriter *w, const char *name) {
+  char line[64];
+  int n = w->as_json ? snprintf(line, sizeof(line), "%s\"%s\":",
+                                w->first ? "" : ",", name)
+                     : snprintf(line, sizeof(line), "%-16s", name);
+  json_buffer_write(w->buf, line, (size_t)n);
+  w->first = false;
+}
+
+static void dump_u64(StatsWriter *w, const char *name, uint64_t value) {
+  char line[32];
+  dump_name(w, name);
+  int n = snprintf(line, sizeof(line), w->as_json ? "%llu" : " %llu\n",
+                   (unsigned long long)value);
+  json_buffer_write(w->buf, line, (size_t)n);
+}
+
+// a group of counters, a nested object in JSON and a single line otherwise
+static void dump_group(StatsWriter *w, const char *name, const uint64_t *values,
+                       const char **names, size_t len) {
+  dump_name(w, name);
+  json_buffer_write(w->buf, w->as_json ? "{" : "", w->as_json ? 1 : 0);
+
+  size_t written = 0;
+  for (size_t i = 0; i < len; i++) {
+    // the text form leaves out the counters that stayed at 0
+    if (!w->as_json && !values[i]) {
+      continue;
+    }
+
+    char item[64];
+    int n = w->as_json
+                ? snprintf(item, sizeof(item), "%s\"%s\":%llu", i ? "," : "",
+                           names[i], (unsigned long long)values[i])
+                : snprintf(item, sizeof(item), "%s %s=%llu",
+                           written ? "," : "", names[i],
+                           (unsigned long long)values[i]);
+    json_buffer_write(w->buf, item, (size_t)n);
+    written++;
+  }
+
+  if (!w->as_json && !written) {
+    json_buffer_write(w->buf, " -", 2);
+  }
+
+  json_buffer_write(w->buf, w->as_json ? "}" : "\n", 1);
+}
+
+char *json_stats_dump(const JSONStats *stats, bool as_json, size_t *len) {
+  JSONBuffer buf = json_buffer_new(0);
+  StatsWriter w = {.buf = &buf, .as_json = as_json, .first = true};
+
+  if (as_json) {
+    json_buffer_write(&buf, "{", 1);
+  }
+
+  dump_u64(&w, "documents", stats->documents);
+  dump_u64(&w, "bytes_scanned", stats->bytes_scanned);
+  dump_u64(&w, "index_ns", stats->index_ns);
+  dump_u64(&w, "validate_ns", stats->validate_ns);
+  dump_u64(&w, "build_ns", stats->build_ns);
+  dump_u64(&w, "number_ns", stats->number_ns);
+  dump_u64(&w, "allocs", stats->allocs);
+  dump_u64(&w, "alloc_bytes", stats->alloc_bytes);
+  dump_u64(&w, "frees", stats->frees);
+  dump_u64(&w, "max_depth", stats->max_depth);
+  dump_u64(&w, "maps", stats->maps);
+  dump_u64(&w, "map_entries", stats->map_entries);
+  dump_u64(&w, "map_slots", stats->map_slots);
+  dump_u64(&w, "map_resizes", stats->map_resizes);
+  dump_u64(&w, "vector_resizes", stats->vector_resizes);
+
+  char load[32];
+  double factor = stats->map_slots
+                      ? (double)stats->map_entries / (double)stats->map_slots
+                      : 0;
+  dump_name(&w, "load_factor");
+  int n = snprintf(load, sizeof(load), as_json ? "%.3f" : " %.3f\n", factor);
+  json_buffer_write(&buf, load, (size_t)n);
+
+  dump_group(&w, "tokens", stats->tokens, TOKEN_NAMES, JSON_STATS_TOKENS);
+  dump_group(&w, "probes", stats->probes, PROBE_NAMES, JSON_STATS_PROBES);
+
+  if (as_json) {
+    json_buffer_write(&buf, "}", 1);
+  }
+  json_buffer_write(&buf, "", 1);
+
+  if (!buf.ok) {
+    json_buffer_free(&buf);
+    return NULL;
+  }
+
+  if (len) {
+    *len = buf.len - 1;
+  }
+  return buf.data;
+}
@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef STATS_H
+#define STATS_H
+
+// one counter per `TokenType' but `TOK_NONE'
+#define JSON_STATS_TOKENS 13
+// probe lengths 0, 1, 2-3, 4-7, ... 32-63 and 64 or more
+#define JSON_STATS_PROBES 8
+
+/**
+ * What parsing cost. Times are in nanoseconds, `index_ns' is stage 1,
+ * `validate_ns' the grammar check and `build_ns' the tree, which includes
+ * `number_ns'. Allocations count every `mem_alloc' and its variants, from an
+ * arena or not. Probes are the slots a lookup in a hashed map visited, the
+ * lookup of every insert included, and the load factor of the maps built is
+ * `map_entries / map_slots'.
+ */
+typedef struct {
+  uint64_t documents;
+  uint64_t bytes_scanned;
+  uint64_t tokens[JSON_STATS_TOKENS];
+  uint64_t index_ns;
+  uint64_t validate_ns;
+  uint64_t build_ns;
+  uint64_t number_ns;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+  uint64_t frees;
+  uint64_t max_depth;
+  uint64_t maps;
+  uint64_t map_entries;
+  uint64_t map_slots;
+  uint64_t map_resizes;
+  uint64_t vector_resizes;
+  uint64_t probes[JSON_STATS_PROBES];
+} JSONStats;
+
+/**
+ * The counters are only compiled in with `JSON_STATS' defined for the whole
+ * library, e.g. `make CFLAGS="-O2 -DJSON_STATS"'. Without it every hook below
+ * expands to nothing and the functions report zeros.
+ */
+#ifdef JSON_STATS
+#define JSON_STATS_ENABLED 1
+
+// this thread's counters since its last parse began
+extern _Thread_local JSONStats json_stats_current;
+
+uint64_t json_stats_now(void);
+
+static inline size_t json_stats_probe_bucket(size_t dist) {
+  size_t bucket = dist ? 64 - __builtin_clzll(dist) : 0;
+  return bucket < JSON_STATS_PROBES ? bucket : JSON_STATS_PROBES - 1;
+}
+
+#define JSON_STATS_ADD(field, n) (json_stats_current.field += (n))
+#define JSON_STATS_MAX(field, n)                                               \
+  do {                                                                         \
+    if (json_stats_current.field < (n)) {                                      \
+      json_stats_current.field = (n);                                          \
+    }                                                                          \
+  } while (0)
+#define JSON_STATS_TOKEN(type)                                                 \
+  do {                                                                         \
+    if ((size_t)(type) < JSON_STATS_TOKENS) {                                  \
+      json_stats_current.tokens[type]++;                                       \
+    }                                                                          \
+  } while (0)
+#define JSON_STATS_PROBE(dist)                                                 \
+  (json_stats_current.probes[json_stats_probe_bucket(dist)]++)
+#define JSON_STATS_TIMER(name) uint64_t name = json_stats_now()
+#define JSON_STATS_ELAPSED(field, name)                                        \
+  JSON_STATS_ADD(field, json_stats_now() - (name))
+// a parse of one document: its counters become `json_stats_last'
+#define JSON_STATS_BEGIN() json_stats_begin()
+#define JSON_STATS_END() json_stats_end()
+// hands a worker's counters to the thread that started it
+#define JSON_STATS_TAKE(stats) ((stats) = json_stats_take())
+#define JSON_STATS_MERGE(stats) json_stats_merge(&json_stats_current, &(stats))
+#else
+#define JSON_STATS_ENABLED 0
+
+#define JSON_STATS_ADD(field, n) ((void)0)
+#define JSON_STATS_MAX(field, n) ((void)0)
+#define JSON_STATS_TOKEN(type) ((void)0)
+#define JSON_STATS_PROBE(dist) ((void)0)
+#define JSON_STATS_TIMER(name) ((void)0)
+#define JSON_STATS_ELAPSED(field, name) ((void)0)
+#define JSON_STATS_BEGIN() ((void)0)
+#define JSON_STATS_END() ((void)0)
+#define JSON_STATS_TAKE(stats) ((void)0)
+#define JSON_STATS_MERGE(stats) ((void)0)
+#endif
+
+void json_stats_begin(void);
+void json_stats_end(void);
+JSONStats json_stats_take(void);
+
+/**
+ * What the last document parsed by this thread through `json_parse' or one
+ * of its variants, `json_parse_parallel' or `json_parse_many' cost, the
+ * work of their threads included.
+ */
+JSONStats json_stats_last(void);
+
+/**
+ * Sum over every thread since the last `json_stats_reset'. Work done outside
+ * a parse, by cursors, tapes or the push parser, is added at the next parse
+ * of its thread or at `json_stats_flush'.
+ */
+JSONStats json_stats_total(void);
+void json_stats_flush(void);
+void json_stats_reset(void);
+
+// adds the counters of `from' to `into', keeping the larger `max_depth'
+void json_stats_merge(JSONStats *into, const JSONStats *from);
+
+/**
+ * `stats' as a NUL-terminated malloc'd string, one counter per line or as a
+ * JSON object. NULL on failure, `len' may be NULL.
+ */
+char *json_stats_dump(const JSONStats *stats, bool as_json, size_t *len);
+
+#endif
@@ -0,0 +1,494 @@
+#include "stream.h"
+
+JSONStream *json_stream_new(size_t emit_depth, JSONStreamCallback callback,
+                            void *ctx) {
+  JSONStream *s = malloc(sizeof(JSONStream));
+  if (!s) {
+    return NULL;
+  }
+
+  *s = (JSONStream){
+      .parser =
+          {
+              .keys = vector_tok_new(),
+              .vec_ctx = vector_json_new(),
+              .arena = arena_new(0),
+              // every token reaching the parser is already a stable copy
+              .flags = JSON_ZERO_COPY,
+          },
+      .member_keys = vector_tok_new(),
+      .emit_depth = emit_depth,
+      .callback = callback,
+      .ctx = ctx,
+      .state = STREAM_TOKEN,
+      .ok = true,
+  };
+  validate_begin(&s->validator, NULL, 0, false);
+  if (!s->parser.keys || !s->parser.vec_ctx || !s->parser.arena ||
+      !s->member_keys) {
+    json_stream_free(s);
+    return NULL;
+  }
+
+  return s;
+}
+
+void json_stream_free(JSONStream *s) {
+  if (!s) {
+    return;
+  }
+
+  struct VectorToken *keys = s->member_keys;
+  if (keys) {
+    for (size_t i = 0; i < keys->len; i++) {
+      mem_free(NULL, (void *)keys->items[i].str);
+    }
+    vector_tok_free(keys);
+  }
+
+  vector_tok_free(s->parser.keys);
+  vector_json_free(s->parser.vec_ctx);
+  arena_free(s->parser.arena);
+  free(s->pending);
+  free(s);
+}
+
+static void stream_fail(JSONStream *s, JSONErrorCode code, size_t offset) {
+  if (s->ok) {
+    s->ok = false;
+    s->error = (JSONError){code, offset};
+  }
+}
+
+static bool stream_append(JSONStream *s, const char *data, size_t len) {
+  if (s->pending_cap - s->pending_len < len) {
+    size_t new_cap = s->pending_cap ? s->pending_cap : 64;
+    while (new_cap - s->pending_len < len) {
+      new_cap *= 2;
+    }
+
+    char *pending = realloc(s->pending, new_cap);
+    if (!pending) {
+      stream_fail(s, JSON_ERROR_MEMORY, s->token_start);
+      return false;
+    }
+
+    s->pending = pending;
+    s->pending_cap = new_cap;
+  }
+
+  memcpy(s->pending + s->pending_len, data, len);
+  s->pending_len += len;
+  return true;
+}
+
+// copies and decodes a string token that points into the caller's chunk
+static Token stream_copy(Token t, Arena *arena) {
+  char *str = mem_alloc(arena, t.len + 1);
+  if (!str) {
+    return (Token){.type = TOK_NONE};
+  }
+
+  size_t len = t.len;
+  if (t.escaped) {
+    len = json_unescape(str, t.str, t.len);
+  } else {
+    memcpy(str, t.str, len);
+  }
+  str[len] = '\0';
+
+  return (Token){.type = TOK_STRING, .str = str, .len = len};
+}
+
+static void stream_value(JSONStream *s, JSON value) {
+  Parser *p = &s->parser;
+  size_t depth = p->vec_ctx->len;
+
+  if (depth > s->emit_depth) {
+    json_merge_value(p, value);
+    return;
+  }
+
+  // the containers above the emit depth are never built, their members are
+  // emitted or dropped instead
+  Token *key = NULL;
+  if (depth > 0 && p->vec_ctx->items[depth - 1].type == OBJECT) {
+    key = vector_tok_pop(s->member_keys);
+  }
+
+  if (depth == s->emit_depth) {
+    StringView k = key ? (StringView){key->str, key->len} : (StringView){0};
+    value.ok = true;
+    s->callback(s->ctx, k, value);
+    arena_reset(p->arena);
+  }
+
+  if (key) {
+    mem_free(NULL, (void *)key->str);
+  }
+}
+
+// builds the token starting at `offset', which the validator already accepted
+static void stream_token(JSONStream *s, Token t, size_t offset) {
+  Parser *p = &s->parser;
+  size_t depth = p->vec_ctx->len;
+
+  switch (t.type) {
+  case TOK_COLON:
+  case TOK_COMMA:
+    break;
+  case TOK_BRACE_LEFT: {
+    JSON object = {.type = OBJECT};
+    if (depth >= s->emit_depth) {
+      object.map = hashmap_json_new_in(p->arena);
+      if (!object.map) {
+        stream_fail(s, JSON_ERROR_MEMORY, offset);
+        break;
+      }
+      object.map->borrow_keys = true;
+    }
+
+    vector_json_push(p->vec_ctx, object);
+    if (p->vec_ctx->len == depth) {
+      stream_fail(s, JSON_ERROR_MEMORY, offset);
+    }
+    break;
+  }
+  case TOK_BRACKET_LEFT: {
+    JSON array = {.type = ARRAY};
+    if (depth >= s->emit_depth) {
+      array.vec = vector_json_new_in(p->arena);
+      if (!array.vec) {
+        stream_fail(s, JSON_ERROR_MEMORY, offset);
+        break;
+      }
+    }
+
+    vector_json_push(p->vec_ctx, array);
+    if (p->vec_ctx->len == depth) {
+      stream_fail(s, JSON_ERROR_MEMORY, offset);
+    }
+    break;
+  }
+  case TOK_BRACE_RIGHT:
+  case TOK_BRACKET_RIGHT:
+    stream_value(s, *vector_json_pop(p->vec_ctx));
+    break;
+  case TOK_STRING: {
+    // the validator expects a colon only after a key
+    bool key = s->validator.state == VALIDATE_OBJECT_COLON;
+    bool shallow = depth <= s->emit_depth;
+    Token str = stream_copy(t, shallow && key ? NULL : p->arena);
+    if (str.type == TOK_NONE) {
+      stream_fail(s, JSON_ERROR_MEMORY, offset);
+      break;
+    }
+
+    if (key) {
+      struct VectorToken *keys = shallow ? s->member_keys : p->keys;
+      size_t len = keys->len;
+      vector_tok_push(keys, str);
+      if (keys->len == len) {
+        if (shallow) {
+          mem_free(NULL, (void *)str.str);
+        }
+        stream_fail(s, JSON_ERROR_MEMORY, offset);
+      }
+      break;
+    }
+
+    stream_value(s, (JSON){.type = STRING, .str = str.str, .len = str.len});
+    break;
+  }
+  case TOK_NUMBER:
+    stream_value(s, (JSON){.type = NUMBER, .d = t.d});
+    break;
+  case TOK_INTEGER:
+    stream_value(s, (JSON){.type = INTEGER, .i = t.i});
+    break;
+  case TOK_UNSIGNED:
+    stream_value(s, (JSON){.type = UNSIGNED, .u = t.u});
+    break;
+  case TOK_BOOLEAN:
+    stream_value(s, (JSON){.type = BOOLEAN, .b = t.b});
+    break;
+  case TOK_NULL:
+    stream_value(s, (JSON){.type = NIL});
+    break;
+  default:
+    stream_fail(s, JSON_ERROR_UNEXPECTED, offset);
+    break;
+  }
+}
+
+static inline bool is_delimiter(char c) {
+  switch (c) {
+  case ' ':
+  case '\n':
+  case '\r':
+  case '\t':
+  case '{':
+  case '}':
+  case '[':
+  case ']':
+  case ':':
+  case ',':
+  case '"':
+    return true;
+  default:
+    return false;
+  }
+}
+
+static inline bool is_hex(char c) {
+  return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+// `escape' right after a backslash, before the 4 hex digits of `\u'
+#define STREAM_ESCAPE_START 5
+
+/**
+ * Checks one byte of a string that is not plain printable ASCII, the same way
+ * the scanner checks whole blocks: control characters, escape sequences and
+ * UTF-8, with any sequence carried over from the previous chunk. Returns
+ * false at the closing quote, or with the stream failed.
+ */
+static bool stream_string_byte(JSONStream *s, uint8_t c, size_t offset) {
+  if (s->utf8_need) {
+    if (c < s->utf8_lo || c > s->utf8_hi) {
+      stream_fail(s, JSON_ERROR_UTF8, offset);
+      return false;
+    }
+    s->utf8_need--;
+    s->utf8_lo = 0x80;
+    s->utf8_hi = 0xBF;
+    return true;
+  }
+
+  if (s->escape == STREAM_ESCAPE_START) {
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+      s->escape = 0;
+      return true;
+    case 'u':
+      s->escape = 4;
+      return true;
+    default:
+      stream_fail(s, JSON_ERROR_ESCAPE, s->escape_start);
+      return false;
+    }
+  } else if (s->escape) {
+    if (!is_hex(c)) {
+      stream_fail(s, JSON_ERROR_ESCAPE, s->escape_start);
+      return false;
+    }
+    s->escape--;
+    return true;
+  }
+
+  if (c == '"') {
+    return false;
+  } else if (c == '\\') {
+    s->escape = STREAM_ESCAPE_START;
+    s->escape_start = offset;
+    s->escaped = true;
+    return true;
+  } else if (c < 0x20) {
+    stream_fail(s, JSON_ERROR_CONTROL, offset);
+    return false;
+  } else if (c < 0x80) {
+    return true;
+  }
+
+  // overlong forms, surrogates and code points above U+10FFFF are ruled out
+  // by the range of the second byte
+  if (c < 0xC2) {
+    stream_fail(s, JSON_ERROR_UTF8, offset);
+    return false;
+  } else if (c < 0xE0) {
+    s->utf8_need = 1;
+    s->utf8_lo = 0x80;
+    s->utf8_hi = 0xBF;
+  } else if (c < 0xF0) {
+    s->utf8_need = 2;
+    s->utf8_lo = c == 0xE0 ? 0xA0 : 0x80;
+    s->utf8_hi = c == 0xED ? 0x9F : 0xBF;
+  } else if (c < 0xF5) {
+    s->utf8_need = 3;
+    s->utf8_lo = c == 0xF0 ? 0x90 : 0x80;
+    s->utf8_hi = c == 0xF4 ? 0x8F : 0xBF;
+  } else {
+    stream_fail(s, JSON_ERROR_UTF8, offset);
+    return false;
+  }
+
+  return true;
+}
+
+static size_t stream_string(JSONStream *s, const char *chunk, size_t len,
+                            size_t i) {
+  size_t start = i;
+
+  for (; i < len; i++) {
+    uint8_t c = (uint8_t)chunk[i];
+    // most bytes of most strings are printable ASCII
+    bool plain = c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+    if ((!plain || s->escape || s->utf8_need) &&
+        !stream_string_byte(s, c, s->offset + i)) {
+      break;
+    }
+  }
+
+  if (!s->ok) {
+    return len;
+  }
+  if (i == len) {
+    stream_append(s, chunk + start, len - start);
+    return len;
+  }
+
+  Token t = {.type = TOK_STRING, .escaped = s->escaped};
+  if (s->pending_len == 0) {
+    t.str = chunk + start;
+    t.len = i - start;
+  } else {
+    if (!stream_append(s, chunk + start, i - start)) {
+      return len;
+    }
+    t.str = s->pending;
+    t.len = s->pending_len;
+  }
+
+  s->state = STREAM_TOKEN;
+  stream_token(s, t, s->token_start);
+  return i + 1;
+}
+
+static void stream_scalar_end(JSONStream *s, const char *str, size_t len) {
+  s->state = STREAM_TOKEN;
+
+  Token t = scan_scalar(str, len);
+  if (t.type == TOK_NONE) {
+    stream_fail(s, JSON_ERROR_SCALAR, s->token_start);
+    return;
+  }
+
+  stream_token(s, t, s->token_start);
+}
+
+static size_t stream_scalar(JSONStream *s, const char *chunk, size_t len,
+                            size_t i) {
+  size_t start = i;
+  while (i < len && !is_delimiter(chunk[i])) {
+    i++;
+  }
+
+  // only a scalar split across chunks is copied
+  if (i < len && s->pending_len == 0) {
+    stream_scalar_end(s, chunk + start, i - start);
+    return i;
+  }
+
+  if (!stream_append(s, chunk + start, i - start) || i == len) {
+    return len;
+  }
+
+  stream_scalar_end(s, s->pending, s->pending_len);
+  return i;
+}
+
+bool json_stream_feed(JSONStream *s, const char *chunk, size_t len) {
+  Validator *v = &s->validator;
+  v->max_depth = parser_max_depth(&s->parser);
+  size_t i = 0;
+
+  while (s->ok && i < len) {
+    switch (s->state) {
+    case STREAM_STRING:
+      i = stream_string(s, chunk, len, i);
+      break;
+    case STREAM_SCALAR:
+      i = stream_scalar(s, chunk, len, i);
+      break;
+    case STREAM_TOKEN: {
+      char c = chunk[i];
+      size_t offset = s->offset + i++;
+      if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        break;
+      }
+
+      // every document but the first starts after the end of the one before
+      if (v->state == VALIDATE_END && c != ',' && c != ':' && c != '}' &&
+          c != ']') {
+        v->state = VALIDATE_ROOT;
+      }
+      if (!validate_token(v, c, offset)) {
+        stream_fail(s, v->error.code, v->error.offset);
+        break;
+      }
+
+      switch (c) {
+      case '{':
+        stream_token(s, (Token){.type = TOK_BRACE_LEFT}, offset);
+        break;
+      case '}':
+        stream_token(s, (Token){.type = TOK_BRACE_RIGHT}, offset);
+        break;
+      case '[':
+        stream_token(s, (Token){.type = TOK_BRACKET_LEFT}, offset);
+        break;
+      case ']':
+        stream_token(s, (Token){.type = TOK_BRACKET_RIGHT}, offset);
+        break;
+      case ':':
+        stream_token(s, (Token){.type = TOK_COLON}, offset);
+        break;
+      case ',':
+        stream_token(s, (Token){.type = TOK_COMMA}, offset);
+        break;
+      case '"':
+        s->state = STREAM_STRING;
+        s->token_start = offset;
+        s->escape = 0;
+        s->escaped = false;
+        s->pending_len = 0;
+        break;
+      default:
+        s->state = STREAM_SCALAR;
+        s->token_start = offset;
+        s->pending_len = 0;
+        i--;
+        break;
+      }
+      break;
+    }
+    }
+  }
+
+  s->offset += len;
+  return s->ok;
+}
+
+bool json_stream_finish(JSONStream *s) {
+  if (s->ok && s->state == STREAM_SCALAR) {
+    stream_scalar_end(s, s->pending, s->pending_len);
+  }
+  if (s->ok && s->state == STREAM_STRING) {
+    stream_fail(s, JSON_ERROR_UNTERMINATED_STRING, s->token_start);
+  }
+
+  Validator *v = &s->validator;
+  v->len = s->offset;
+  if (s->ok && !validate_end(v)) {
+    stream_fail(s, v->error.code, v->error.offset);
+  }
+
+  return s->ok;
+}
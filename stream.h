@@ -0,0 +1,84 @@
+#include "json.h"
+#include "validate.h"
+
+#ifndef STREAM_H
+#define STREAM_H
+
+/**
+ * Receives every value completed at the stream's emit depth. `key' is the
+ * member name when the value belongs to an object, `{NULL, 0}' otherwise.
+ * The value and the key are only valid until the callback returns.
+ */
+typedef void (*JSONStreamCallback)(void *ctx, StringView key, JSON value);
+
+typedef enum {
+  STREAM_TOKEN,
+  STREAM_STRING,
+  STREAM_SCALAR,
+} StreamState;
+
+/**
+ * Push parser for input that arrives in arbitrary chunks. Containers above
+ * `emit_depth' are never built: their values are handed to the callback one
+ * by one as they complete, so memory is bounded by the nesting depth and the
+ * largest emitted value, not by the size of the input. An emit depth of 0
+ * emits whole documents, which also parses concatenated or newline-delimited
+ * documents.
+ *
+ * The input is checked as strictly as by `json_parse': the grammar by a
+ * `Validator' fed a token at a time, strings for control characters, escape
+ * sequences and UTF-8 as the scanner does.
+ */
+typedef struct {
+  // only `keys', `vec_ctx', `arena' and `max_depth' are used, the tokens come
+  // from `feed'
+  Parser parser;
+  // keys of the containers above the emit depth, kept out of the arena since
+  // it is reset after every emitted value
+  struct VectorToken *member_keys;
+  size_t emit_depth;
+  JSONStreamCallback callback;
+  void *ctx;
+
+  Validator validator;
+  StreamState state;
+  // bytes fed before the current chunk
+  size_t offset;
+  // where the current string or scalar started
+  size_t token_start;
+  // bytes of the current escape sequence still to come, and where it started
+  uint8_t escape;
+  size_t escape_start;
+  // the current string contains escape sequences
+  bool escaped;
+  // continuation bytes of the current UTF-8 sequence still expected, and the
+  // range of the next one
+  uint8_t utf8_need, utf8_lo, utf8_hi;
+  // token split across chunks
+  char *pending;
+  size_t pending_len;
+  size_t pending_cap;
+
+  bool ok;
+  // why the input was rejected, the offset counts every byte fed so far
+  JSONError error;
+} JSONStream;
+
+JSONStream *json_stream_new(size_t emit_depth, JSONStreamCallback callback,
+                            void *ctx);
+void json_stream_free(JSONStream *stream);
+
+/**
+ * Parses the next `len' bytes of input. Returns false with `stream->error'
+ * set once the input is invalid, any further chunks are ignored.
+ */
+bool json_stream_feed(JSONStream *stream, const char *chunk, size_t len);
+
+/**
+ * Ends the input, completing a trailing number. Returns false with
+ * `stream->error' set when the input was invalid, stopped inside a value or
+ * held no value at all.
+ */
+bool json_stream_finish(JSONStream *stream);
+
+#endif
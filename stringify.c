@@ -0,0 +1,387 @@
+#include "stringify.h"
+#include "number.h"
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <limits.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define JSON_BUFFER_CAP (16 * 1024)
+
+static const char DIGITS2[] = "00010203040506070809"
+                              "10111213141516171819"
+                              "20212223242526272829"
+                              "30313233343536373839"
+                              "40414243444546474849"
+                              "50515253545556575859"
+                              "60616263646566676869"
+                              "70717273747576777879"
+                              "80818283848586878889"
+                              "90919293949596979899";
+
+static const char HEX[] = "0123456789abcdef";
+
+JSONBuffer json_buffer_new(size_t cap) {
+  cap = cap ? cap : JSON_BUFFER_CAP;
+  char *data = malloc(cap);
+
+  return (JSONBuffer){
+      .data = data,
+      .cap = data ? cap : 0,
+      .fd = -1,
+      .ok = data != NULL,
+  };
+}
+
+JSONBuffer json_buffer_fixed(char *data, size_t cap) {
+  return (JSONBuffer){
+      .data = data, .cap = cap, .fd = -1, .fixed = true, .ok = true};
+}
+
+JSONBuffer json_buffer_fd(int fd, size_t cap) {
+  JSONBuffer buf = json_buffer_new(cap);
+  buf.fd = fd;
+  return buf;
+}
+
+static bool fd_write(int fd, const char *data, size_t len) {
+  while (len > 0) {
+#ifdef _WIN32
+    int n = _write(fd, data, len > INT_MAX ? INT_MAX : (unsigned)len);
+#else
+    ssize_t n = write(fd, data, len);
+#endif
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    data += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+bool json_buffer_flush(JSONBuffer *buf) {
+  if (buf->fd >= 0 && buf->ok && buf->len > 0) {
+    buf->ok = fd_write(buf->fd, buf->data, buf->len);
+    buf->len = 0;
+  }
+
+  return buf->ok;
+}
+
+void json_buffer_free(JSONBuffer *buf) {
+  json_buffer_flush(buf);
+  if (!buf->fixed) {
+    free(buf->data);
+  }
+
+  *buf = (JSONBuffer){.fd = -1};
+}
+
+// makes room for `len' more bytes
+static bool buffer_reserve(JSONBuffer *buf, size_t len) {
+  if (!buf->ok) {
+    return false;
+  }
+  if (buf->cap - buf->len >= len) {
+    return true;
+  }
+  if (buf->fd >= 0 && (!json_buffer_flush(buf) || buf->cap >= len)) {
+    return buf->ok;
+  }
+  if (buf->fixed) {
+    buf->ok = false;
+    return false;
+  }
+
+  size_t cap = buf->cap ? buf->cap : 64;
+  while (cap - buf->len < len) {
+    cap *= 2;
+  }
+
+  char *data = realloc(buf->data, cap);
+  if (!data) {
+    buf->ok = false;
+    return false;
+  }
+
+  buf->data = data;
+  buf->cap = cap;
+  return true;
+}
+
+static inline void buffer_putc(JSONBuffer *buf, char c) {
+  if (buffer_reserve(buf, 1)) {
+    buf->data[buf->len++] = c;
+  }
+}
+
+bool json_buffer_write(JSONBuffer *buf, const char *data, size_t len) {
+  // large writes skip the buffer and go out together with what it holds
+  if (buf->fd >= 0 && buf->ok && buf->cap - buf->len < len &&
+      len >= buf->cap / 2) {
+#ifdef _WIN32
+    buf->ok = json_buffer_flush(buf) && fd_write(buf->fd, data, len);
+#else
+    struct iovec iov[2] = {{buf->data, buf->len}, {(void *)data, len}};
+    struct iovec *v = iov;
+    int count = 2;
+
+    while (count > 0) {
+      ssize_t n = writev(buf->fd, v, count);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        buf->ok = false;
+        break;
+      }
+
+      // resume after a short write
+      for (; count > 0 && (size_t)n >= v->iov_len; v++, count--) {
+        n -= v->iov_len;
+      }
+      if (count > 0) {
+        v->iov_base = (char *)v->iov_base + n;
+        v->iov_len -= n;
+      }
+    }
+    buf->len = 0;
+#endif
+    return buf->ok;
+  }
+
+  if (!buffer_reserve(buf, len)) {
+    return false;
+  }
+
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  return true;
+}
+
+static inline bool needs_escape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// length of the run at `s' that can be copied as is
+static inline size_t escape_run(const char *s, size_t len) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    // unsigned v <= 0x1F
+    __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, control), v);
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                   _mm_cmpeq_epi8(v, backslash));
+    int mask = _mm_movemask_epi8(_mm_or_si128(ctrl, special));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  while (i < len && !needs_escape(s[i])) {
+    i++;
+  }
+
+  return i;
+}
+
+static void write_string(JSONBuffer *buf, const char *s, size_t len) {
+  buffer_putc(buf, '"');
+
+  while (len > 0) {
+    size_t run = escape_run(s, len);
+    json_buffer_write(buf, s, run);
+    s += run;
+    len -= run;
+    if (len == 0) {
+      break;
+    }
+
+    unsigned char c = *s++;
+    len--;
+
+    char esc[6] = {'\\', (char)c};
+    size_t n = 2;
+    switch (c) {
+    case '"':
+    case '\\':
+      break;
+    case '\b':
+      esc[1] = 'b';
+      break;
+    case '\f':
+      esc[1] = 'f';
+      break;
+    case '\n':
+      esc[1] = 'n';
+      break;
+    case '\r':
+      esc[1] = 'r';
+      break;
+    case '\t':
+      esc[1] = 't';
+      break;
+    default:
+      memcpy(esc, "\\u00", 4);
+      esc[4] = HEX[c >> 4];
+      esc[5] = HEX[c & 0xF];
+      n = 6;
+      break;
+    }
+    json_buffer_write(buf, esc, n);
+  }
+
+  buffer_putc(buf, '"');
+}
+
+// digits of `value' written two at a time from the back of `dst'
+static size_t format_uint64(char *dst, uint64_t value) {
+  char tmp[20];
+  char *p = tmp + sizeof(tmp);
+
+  while (value >= 100) {
+    p -= 2;
+    memcpy(p, DIGITS2 + value % 100 * 2, 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    p -= 2;
+    memcpy(p, DIGITS2 + value * 2, 2);
+  } else {
+    *--p = (char)('0' + value);
+  }
+
+  size_t len = tmp + sizeof(tmp) - p;
+  memcpy(dst, p, len);
+  return len;
+}
+
+static void write_newline(JSONBuffer *buf, unsigned flags, size_t depth) {
+  if (!(flags & JSON_PRETTY) || !buffer_reserve(buf, 1 + 2 * depth)) {
+    return;
+  }
+
+  buf->data[buf->len++] = '\n';
+  memset(buf->data + buf->len, ' ', 2 * depth);
+  buf->len += 2 * depth;
+}
+
+static void stringify(JSONBuffer *buf, JSON json, unsigned flags,
+                      size_t depth) {
+  char num[JSON_DOUBLE_MAX];
+  size_t len;
+
+  switch (json.type) {
+  case OBJECT: {
+    struct HashMapJSON *map = json.map;
+    if (!map || map->size == 0) {
+      json_buffer_write(buf, "{}", 2);
+      break;
+    }
+
+    buffer_putc(buf, '{');
+    size_t written = 0;
+    for (size_t i = 0; i < map->cap && buf->ok; i++) {
+      BucketJSON *b = &map->values[i];
+      if (!b->key) {
+        continue;
+      }
+
+      if (written++) {
+        buffer_putc(buf, ',');
+      }
+      write_newline(buf, flags, depth + 1);
+      write_string(buf, b->key, b->key_len);
+      json_buffer_write(buf, ": ", flags & JSON_PRETTY ? 2 : 1);
+      stringify(buf, b->value, flags, depth + 1);
+    }
+    write_newline(buf, flags, depth);
+    buffer_putc(buf, '}');
+    break;
+  }
+  case ARRAY: {
+    struct VectorJSON *vec = json.vec;
+    if (!vec || vec->len == 0) {
+      json_buffer_write(buf, "[]", 2);
+      break;
+    }
+
+    buffer_putc(buf, '[');
+    for (size_t i = 0; i < vec->len && buf->ok; i++) {
+      if (i) {
+        buffer_putc(buf, ',');
+      }
+      write_newline(buf, flags, depth + 1);
+      stringify(buf, vec->items[i], flags, depth + 1);
+    }
+    write_newline(buf, flags, depth);
+    buffer_putc(buf, ']');
+    break;
+  }
+  case STRING:
+    write_string(buf, json.str, json.len);
+    break;
+  case NUMBER:
+    len = json_format_double(num, json.d);
+    json_buffer_write(buf, num, len);
+    break;
+  case INTEGER:
+    num[0] = '-';
+    len = json.i < 0 ? 1 + format_uint64(num + 1, 0 - (uint64_t)json.i)
+                     : format_uint64(num, (uint64_t)json.i);
+    json_buffer_write(buf, num, len);
+    break;
+  case UNSIGNED:
+    len = format_uint64(num, json.u);
+    json_buffer_write(buf, num, len);
+    break;
+  case BOOLEAN:
+    json_buffer_write(buf, json.b ? "true" : "false", json.b ? 4 : 5);
+    break;
+  case NIL:
+    json_buffer_write(buf, "null", 4);
+    break;
+  }
+}
+
+bool json_stringify(JSONBuffer *buf, JSON json, unsigned flags) {
+  stringify(buf, json, flags, 0);
+  return buf->ok;
+}
+
+char *json_stringify_alloc(JSON json, unsigned flags, size_t *len) {
+  JSONBuffer buf = json_buffer_new(0);
+
+  json_stringify(&buf, json, flags);
+  buffer_putc(&buf, '\0');
+  if (!buf.ok) {
+    json_buffer_free(&buf);
+    return NULL;
+  }
+
+  if (len) {
+    *len = buf.len - 1;
+  }
+  return buf.data;
+}
@@ -0,0 +1,59 @@
+#include "json.h"
+
+#ifndef STRINGIFY_H
+#define STRINGIFY_H
+
+/**
+ * Output buffer for the serializer. It either grows on the heap, stays
+ * within a caller-supplied array, or is flushed to a file descriptor
+ * whenever it fills up.
+ */
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+  // descriptor the buffer is flushed to, -1 to grow instead
+  int fd;
+  // `data' belongs to the caller and is never grown or freed
+  bool fixed;
+  // unset once a write failed or a fixed buffer ran out of space, every
+  // later write is dropped
+  bool ok;
+} JSONBuffer;
+
+enum JSONStringifyFlags {
+  // newlines and two-space indentation instead of the compact form
+  JSON_PRETTY = 1 << 0,
+};
+
+// 0 picks a default capacity
+JSONBuffer json_buffer_new(size_t cap);
+JSONBuffer json_buffer_fixed(char *data, size_t cap);
+JSONBuffer json_buffer_fd(int fd, size_t cap);
+
+bool json_buffer_write(JSONBuffer *buf, const char *data, size_t len);
+// writes out whatever a descriptor buffer holds
+bool json_buffer_flush(JSONBuffer *buf);
+// flushes a descriptor buffer and frees any memory the buffer owns
+void json_buffer_free(JSONBuffer *buf);
+
+/**
+ * Appends the text of `json' to `buf'. `flags' are `JSONStringifyFlags'.
+ * Doubles are written with the shortest digits that read back exactly.
+ * Returns `buf->ok'.
+ *
+ * Members are written in the order of their map. Objects of more than
+ * `HASHMAP_SMALL_MAX' members are hash tables, whose order follows the hash
+ * seed drawn when the process starts, so the same document can be written
+ * with its members in a different order by every run. Call `json_hash_seed'
+ * with a fixed seed before parsing for byte-identical output across runs.
+ */
+bool json_stringify(JSONBuffer *buf, JSON json, unsigned flags);
+
+/**
+ * Text of `json' as a NUL-terminated malloc'd string, NULL on failure. `len'
+ * may be NULL.
+ */
+char *json_stringify_alloc(JSON json, unsigned flags, size_t *len);
+
+#endif
@@ -0,0 +1,338 @@
+#include "tape.h"
+#include "validate.h"
+
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+} TapeFrame;
+
+static inline uint64_t tape_word(TapeType type, uint64_t payload) {
+  return (uint64_t)type << 56 | payload;
+}
+
+static inline uint64_t tape_payload(JSONTapeIter it) {
+  return it.tape->words[it.pos] & TAPE_PAYLOAD_MASK;
+}
+
+// true when the next structural character is the colon after an object key
+static inline bool tape_is_key(Parser *p) {
+  return p->index_pos < p->index.len &&
+         p->source[p->index.positions[p->index_pos]] == ':';
+}
+
+// records why `tape' was rejected, for it and for `json_last_error'
+static JSONTape tape_fail(JSONTape tape, JSONErrorCode code, size_t offset) {
+  tape.ok = false;
+  tape.error = (JSONError){code, offset};
+  json_set_last_error(tape.error);
+  return tape;
+}
+
+JSONTape json_parse_tape(const char *source) {
+  return json_parse_tape_n(source, strlen(source));
+}
+
+JSONTape json_parse_tape_n(const char *source, size_t len) {
+  Parser p = {.source = source, .len = len};
+  JSONTape tape = {0};
+
+  Validator v;
+  validate_begin(&v, source, p.len, false);
+  if (!scanner_index(&p.index, source, p.len)) {
+    scanner_index_free(&p.index);
+    return tape_fail(tape, p.index.error.code, p.index.error.offset);
+  }
+  if (!validate_index(&v, p.index.positions, 0, p.index.len) ||
+      !validate_end(&v)) {
+    scanner_index_free(&p.index);
+    return tape_fail(tape, v.error.code, v.error.offset);
+  }
+
+  // every index entry is at most two words (numbers), and the decoded strings
+  // never outgrow the source plus a length and a NUL per string
+  size_t words_cap = 2 * p.index.len + 2;
+  size_t strings_cap = p.len + 5 * p.index.len;
+  // container words hold word indexes in 32 bits
+  if (words_cap > UINT32_MAX) {
+    scanner_index_free(&p.index);
+    return tape_fail(tape, JSON_ERROR_TOO_LARGE, 0);
+  }
+  tape.words = malloc(words_cap * sizeof(uint64_t) + strings_cap);
+  TapeFrame *frames = malloc((p.index.len + 1) * sizeof(TapeFrame));
+  if (!tape.words || !frames) {
+    free(tape.words);
+    free(frames);
+    scanner_index_free(&p.index);
+    return tape_fail((JSONTape){0}, JSON_ERROR_MEMORY, 0);
+  }
+  tape.strings = (char *)(tape.words + words_cap);
+
+  uint64_t *w = tape.words;
+  size_t n = 1;
+  size_t depth = 0;
+  bool ok = true;
+  size_t start = 0;
+
+  Token t;
+  while (ok && (t = scan_token(&p), t.type != TOK_NONE)) {
+    // keys are not elements of their object
+    if (depth > 0 && t.type != TOK_BRACE_RIGHT &&
+        t.type != TOK_BRACKET_RIGHT && t.type != TOK_COLON &&
+        t.type != TOK_COMMA && !(t.type == TOK_STRING && tape_is_key(&p))) {
+      frames[depth - 1].count++;
+    }
+
+    switch (t.type) {
+    case TOK_WHITESPACE:
+    case TOK_COLON:
+    case TOK_COMMA:
+      break;
+    case TOK_BRACE_LEFT:
+    case TOK_BRACKET_LEFT:
+      frames[depth++] = (TapeFrame){.start = (uint32_t)n};
+      w[n++] = tape_word(
+          t.type == TOK_BRACE_LEFT ? TAPE_OBJECT_START : TAPE_ARRAY_START, 0);
+      break;
+    case TOK_BRACE_RIGHT:
+    case TOK_BRACKET_RIGHT: {
+      TapeType start =
+          t.type == TOK_BRACE_RIGHT ? TAPE_OBJECT_START : TAPE_ARRAY_START;
+      if (depth == 0 || w[frames[depth - 1].start] >> 56 != start) {
+        ok = false;
+        break;
+      }
+
+      TapeFrame f = frames[--depth];
+      uint64_t count = f.count < TAPE_COUNT_MAX ? f.count : TAPE_COUNT_MAX;
+      w[f.start] = tape_word(start, count << 32 | (n + 1));
+      w[n++] = tape_word(start == TAPE_OBJECT_START ? TAPE_OBJECT_END
+                                                    : TAPE_ARRAY_END,
+                         f.start);
+      break;
+    }
+    case TOK_STRING: {
+      char *dst = tape.strings + tape.strings_len + sizeof(uint32_t);
+      uint32_t len = (uint32_t)(t.escaped ? json_unescape(dst, t.str, t.len)
+                                          : (memcpy(dst, t.str, t.len), t.len));
+      memcpy(dst - sizeof(uint32_t), &len, sizeof(uint32_t));
+      dst[len] = '\0';
+
+      w[n++] = tape_word(TAPE_STRING, tape.strings_len);
+      tape.strings_len += sizeof(uint32_t) + len + 1;
+      break;
+    }
+    case TOK_NUMBER:
+      w[n++] = tape_word(TAPE_NUMBER, 0);
+      memcpy(&w[n++], &t.d, sizeof(double));
+      break;
+    case TOK_INTEGER:
+    case TOK_UNSIGNED:
+      w[n++] = tape_word(t.type == TOK_INTEGER ? TAPE_INT64 : TAPE_UINT64, 0);
+      w[n++] = t.u;
+      break;
+    case TOK_BOOLEAN:
+      w[n++] = tape_word(t.b ? TAPE_TRUE : TAPE_FALSE, 0);
+      break;
+    case TOK_NULL:
+      w[n++] = tape_word(TAPE_NULL, 0);
+      break;
+    case TOK_NONE:
+      ok = false;
+      break;
+    }
+    start = p.index_pos;
+  }
+
+  // the validator leaves bare words to `scan_scalar', so stopping before the
+  // end means one was neither a number nor a literal
+  size_t offset = start < p.index.len ? p.index.positions[start] : 0;
+  free(frames);
+  scanner_index_free(&p.index);
+
+  w[0] = tape_word(TAPE_ROOT, n);
+  w[n] = tape_word(TAPE_ROOT, 0);
+  tape.len = n + 1;
+  if (!ok || depth != 0 || n <= 1 || start < p.index.len) {
+    return tape_fail(tape, JSON_ERROR_SCALAR, offset);
+  }
+
+  tape.ok = true;
+  json_set_last_error(tape.error);
+  return tape;
+}
+
+void json_tape_free(JSONTape *tape) {
+  free(tape->words);
+  *tape = (JSONTape){0};
+}
+
+JSONTapeIter json_tape_root(const JSONTape *tape) {
+  return (JSONTapeIter){.tape = tape, .pos = 1};
+}
+
+TapeType json_tape_type(JSONTapeIter it) {
+  return (TapeType)(it.tape->words[it.pos] >> 56);
+}
+
+JSONTapeIter json_tape_next(JSONTapeIter it) {
+  switch (json_tape_type(it)) {
+  case TAPE_OBJECT_START:
+  case TAPE_ARRAY_START:
+    it.pos = tape_payload(it) & 0xFFFFFFFF;
+    break;
+  case TAPE_NUMBER:
+  case TAPE_INT64:
+  case TAPE_UINT64:
+    it.pos += 2;
+    break;
+  default:
+    it.pos++;
+    break;
+  }
+
+  return it;
+}
+
+JSONTapeIter json_tape_child(JSONTapeIter it) {
+  it.pos++;
+  return it;
+}
+
+bool json_tape_at_end(JSONTapeIter it) {
+  TapeType type = json_tape_type(it);
+  return type == TAPE_OBJECT_END || type == TAPE_ARRAY_END ||
+         type == TAPE_ROOT;
+}
+
+size_t json_tape_count(JSONTapeIter it) { return tape_payload(it) >> 32; }
+
+const char *json_tape_string(JSONTapeIter it, size_t *len) {
+  const char *str = it.tape->strings + tape_payload(it);
+
+  uint32_t n;
+  memcpy(&n, str, sizeof(uint32_t));
+  if (len) {
+    *len = n;
+  }
+
+  return str + sizeof(uint32_t);
+}
+
+double json_tape_number(JSONTapeIter it) {
+  switch (json_tape_type(it)) {
+  case TAPE_INT64:
+    return (double)json_tape_int64(it);
+  case TAPE_UINT64:
+    return (double)json_tape_uint64(it);
+  default: {
+    double d;
+    memcpy(&d, &it.tape->words[it.pos + 1], sizeof(double));
+    return d;
+  }
+  }
+}
+
+int64_t json_tape_int64(JSONTapeIter it) {
+  return (int64_t)it.tape->words[it.pos + 1];
+}
+
+uint64_t json_tape_uint64(JSONTapeIter it) {
+  return it.tape->words[it.pos + 1];
+}
+
+bool json_tape_bool(JSONTapeIter it) {
+  return json_tape_type(it) == TAPE_TRUE;
+}
+
+JSONTapeIter json_tape_find(JSONTapeIter it, const char *key, size_t len) {
+  for (it = json_tape_child(it); !json_tape_at_end(it);) {
+    size_t key_len;
+    const char *k = json_tape_string(it, &key_len);
+
+    it = json_tape_next(it);
+    if (key_len == len && memcmp(k, key, len) == 0) {
+      return it;
+    }
+
+    it = json_tape_next(it);
+  }
+
+  return it;
+}
+
+JSON json_tape_to_json(JSONTapeIter it, Arena *arena) {
+  switch (json_tape_type(it)) {
+  case TAPE_OBJECT_START: {
+    JSON object = {.ok = true, .type = OBJECT};
+    if (!(object.map = hashmap_json_new_cap(arena, json_tape_count(it)))) {
+      return (JSON){.ok = false};
+    }
+    object.map->borrow_keys = true;
+
+    for (it = json_tape_child(it); !json_tape_at_end(it);) {
+      size_t len;
+      const char *key = json_tape_string(it, &len);
+
+      it = json_tape_next(it);
+      JSON value = json_tape_to_json(it, arena);
+      if (!value.ok) {
+        json_free(object);
+        return value;
+      }
+
+      // a duplicate key replaces the value, a missing one failed to grow
+      size_t size = object.map->size;
+      hashmap_json_set_n(object.map, key, len, value);
+      if (object.map->size == size &&
+          !hashmap_json_find_n(object.map, key, len)) {
+        json_free(value);
+        json_free(object);
+        return (JSON){.ok = false};
+      }
+      it = json_tape_next(it);
+    }
+
+    return object;
+  }
+  case TAPE_ARRAY_START: {
+    JSON array = {.ok = true, .type = ARRAY};
+    if (!(array.vec = vector_json_new_in(arena))) {
+      return (JSON){.ok = false};
+    }
+
+    for (it = json_tape_child(it); !json_tape_at_end(it);
+         it = json_tape_next(it)) {
+      JSON value = json_tape_to_json(it, arena);
+      size_t len = array.vec->len;
+      if (value.ok) {
+        vector_json_push(array.vec, value);
+      }
+      if (array.vec->len == len) {
+        json_free(value);
+        json_free(array);
+        return (JSON){.ok = false};
+      }
+    }
+
+    return array;
+  }
+  case TAPE_STRING: {
+    size_t len;
+    const char *str = json_tape_string(it, &len);
+    return (JSON){.ok = true, .type = STRING, .str = str, .len = len};
+  }
+  case TAPE_NUMBER:
+    return (JSON){.ok = true, .type = NUMBER, .d = json_tape_number(it)};
+  case TAPE_INT64:
+    return (JSON){.ok = true, .type = INTEGER, .i = json_tape_int64(it)};
+  case TAPE_UINT64:
+    return (JSON){.ok = true, .type = UNSIGNED, .u = json_tape_uint64(it)};
+  case TAPE_TRUE:
+  case TAPE_FALSE:
+    return (JSON){.ok = true, .type = BOOLEAN, .b = json_tape_bool(it)};
+  case TAPE_NULL:
+    return (JSON){.ok = true, .type = NIL};
+  default:
+    return (JSON){.ok = false};
+  }
+}
@@ -0,0 +1,99 @@
+#include "json.h"
+#include <stdint.h>
+
+#ifndef TAPE_H
+#define TAPE_H
+
+/**
+ * Flat document representation: one contiguous array of 64-bit words, the
+ * type tag in the top byte and a 56-bit payload below it.
+ *
+ * - root words wrap the document, their payload is the index of the other one
+ * - container starts hold the index just past their end word, with the
+ *   element count in bits 32-55, ends hold the index of their start word
+ * - strings hold an offset into the string buffer, where every string is
+ *   stored as a 32-bit length, its bytes and a NUL terminator
+ * - numbers are followed by a second word with the bits of the double, or of
+ *   the int64/uint64 for integers
+ *
+ * Object members are stored as a string word followed by the value.
+ */
+typedef enum {
+  TAPE_ROOT = 'r',
+  TAPE_OBJECT_START = '{',
+  TAPE_OBJECT_END = '}',
+  TAPE_ARRAY_START = '[',
+  TAPE_ARRAY_END = ']',
+  TAPE_STRING = '"',
+  TAPE_NUMBER = 'd',
+  TAPE_INT64 = 'l',
+  TAPE_UINT64 = 'u',
+  TAPE_TRUE = 't',
+  TAPE_FALSE = 'f',
+  TAPE_NULL = 'n',
+} TapeType;
+
+#define TAPE_PAYLOAD_MASK ((1ULL << 56) - 1)
+#define TAPE_COUNT_MAX 0xFFFFFF
+
+typedef struct {
+  bool ok;
+  uint64_t *words;
+  size_t len;
+  char *strings;
+  size_t strings_len;
+  // why the document was rejected, also left in `json_last_error'
+  JSONError error;
+} JSONTape;
+
+typedef struct {
+  const JSONTape *tape;
+  size_t pos;
+} JSONTapeIter;
+
+/**
+ * Parses the `len' bytes at `source', which need no NUL terminator, into a
+ * tape. The words and the string buffer share a single allocation sized from
+ * the structural index, released by `json_tape_free'. Fails with
+ * `JSON_ERROR_TOO_LARGE' for documents that may need more than 4G words,
+ * about 2G values.
+ */
+JSONTape json_parse_tape_n(const char *source, size_t len);
+
+// same as `json_parse_tape_n' for a NUL-terminated `source'
+JSONTape json_parse_tape(const char *source);
+void json_tape_free(JSONTape *tape);
+
+JSONTapeIter json_tape_root(const JSONTape *tape);
+TapeType json_tape_type(JSONTapeIter it);
+
+// iterator to the value after `it', jumping over containers in one step
+JSONTapeIter json_tape_next(JSONTapeIter it);
+// iterator to the first element of a container, or to its end word
+JSONTapeIter json_tape_child(JSONTapeIter it);
+// true when `it' reached the end word of its container
+bool json_tape_at_end(JSONTapeIter it);
+
+// element count of a container, saturates at TAPE_COUNT_MAX
+size_t json_tape_count(JSONTapeIter it);
+const char *json_tape_string(JSONTapeIter it, size_t *len);
+// value of any number, integers converted to the nearest double
+double json_tape_number(JSONTapeIter it);
+int64_t json_tape_int64(JSONTapeIter it);
+uint64_t json_tape_uint64(JSONTapeIter it);
+bool json_tape_bool(JSONTapeIter it);
+
+/**
+ * Value of member `key' of the object at `it'. Returns an iterator at the
+ * object's end word when the key is missing.
+ */
+JSONTapeIter json_tape_find(JSONTapeIter it, const char *key, size_t len);
+
+/**
+ * Builds the `JSON' tree for the value at `it'. Strings point into the tape's
+ * string buffer, so the tape must outlive the tree. `arena' may be NULL. The
+ * result is not ok when an allocation failed.
+ */
+JSON json_tape_to_json(JSONTapeIter it, Arena *arena);
+
+#endif
@@ -0,0 +1,51 @@
+// Batches of documents with bad ones among them.
+#include "batch.h"
+#include "test.h"
+#include <string.h>
+
+typedef struct {
+  char seen[512];
+  size_t len;
+  size_t next;
+} Seen;
+
+// "text" of every document, "!" for the failed ones
+static void collect(void *ctx, size_t index, JSON value) {
+  Seen *seen = ctx;
+  CHECK(index == seen->next, "document %zu delivered as %zu", seen->next,
+        index);
+  seen->next = index + 1;
+
+  int n = snprintf(seen->seen + seen->len, sizeof(seen->seen) - seen->len,
+                   "%s%s", seen->len ? " " : "",
+                   value.ok ? test_text(value) : "!");
+  if (n > 0) {
+    seen->len += (size_t)n;
+  }
+}
+
+static void check(const char *text, size_t threads, const char *want) {
+  Seen seen = {{0}, 0, 0};
+  size_t count =
+      json_parse_many(text, strlen(text), threads, 0, collect, &seen);
+  CHECK(count == seen.next, "batch returns %zu for %zu documents", count,
+        seen.next);
+  // bad documents do not stop the batch
+  CHECK(json_last_error().code == JSON_OK, "batch of %s stopped: %s", text,
+        json_error_string(json_last_error().code));
+  CHECK(!strcmp(seen.seen, want), "batch(%zu) of %s gives %s, want %s",
+        threads, text, seen.seen, want);
+}
+
+void test_batch_suite(void) {
+  for (size_t threads = 1; threads <= 4; threads *= 2) {
+    check("{\"a\":1}\n[2]\n\"s\"\n", threads, "{\"a\":1} [2] \"s\"");
+    check("1 2 3", threads, "1 2 3");
+    check("[1][2]{}", threads, "[1] [2] {}");
+    check("{\"a\":1}\n[\"bad\x01\"]\n[3]\n", threads, "{\"a\":1} ! [3]");
+    check("[1]\n[\"\\q\"]\n[\"\xff\"]\n[4]\n", threads, "[1] ! ! [4]");
+    check("[1]\n\"open\n[3]\n", threads, "[1] ! [3]");
+    check("[1]\n[2,]\n[3]\n", threads, "[1] ! [3]");
+    check("[1]\n{\"a\" 1}\n[3]\n", threads, "[1] ! [3]");
+  }
+}
@@ -0,0 +1,194 @@
+// Documents decoded straight into structs, through each of the ways a schema
+// looks up its field names.
+#include "bind.h"
+#include "test.h"
+#include <string.h>
+
+typedef struct {
+  double lat;
+  double lon;
+} Point;
+
+DEFINE_SCHEMA(Point, point, JSON_FIELD(Point, lat, JSON_BIND_DOUBLE),
+              JSON_FIELD(Point, lon, JSON_BIND_DOUBLE))
+
+typedef struct {
+  int64_t id;
+  uint64_t count;
+  bool active;
+  double score;
+  StringView name;
+  Point home;
+  JSONBindArray tags;
+  JSONBindArray stops;
+} Record;
+
+DEFINE_SCHEMA(Record, record, JSON_FIELD(Record, id, JSON_BIND_INT64),
+              JSON_FIELD(Record, count, JSON_BIND_UINT64),
+              JSON_FIELD(Record, active, JSON_BIND_BOOL),
+              JSON_FIELD(Record, score, JSON_BIND_DOUBLE),
+              JSON_FIELD(Record, name, JSON_BIND_STRING),
+              JSON_FIELD_OBJECT(Record, home, point),
+              JSON_FIELD_ARRAY(Record, tags, JSON_BIND_STRING),
+              JSON_FIELD_ARRAY_OF(Record, stops, point))
+
+// the same fields without slots for a perfect hash, searched one by one
+static JSONSchema record_linear = {
+    .fields = record_fields,
+    .len = sizeof(record_fields) / sizeof(JSONField),
+    .size = sizeof(Record),
+};
+
+// names whose length and first and last 8 bytes are all the same
+typedef struct {
+  int64_t a;
+  int64_t b;
+  int64_t c;
+} Middle;
+
+DEFINE_SCHEMA(Middle, middle,
+              JSON_FIELD_AS(Middle, a, "customer_a_address", JSON_BIND_INT64),
+              JSON_FIELD_AS(Middle, b, "customer_b_address", JSON_BIND_INT64),
+              JSON_FIELD_AS(Middle, c, "customer_c_address", JSON_BIND_INT64))
+
+static const char FULL[] =
+    "{\"id\": -7, \"count\": 18446744073709551615, \"active\": true,"
+    " \"score\": 2.5, \"name\": \"ann\", \"home\": {\"lat\": 1.5, \"lon\": -2},"
+    " \"extra\": {\"deep\": [1, {\"x\": [true, null]}], \"s\": \"q\\n\"},"
+    " \"tags\": [\"x\", \"y\\u0021\"],"
+    " \"stops\": [{\"lat\": 1, \"lon\": 2}, {\"lon\": 4, \"lat\": 3}],"
+    " \"n\\u0061me\": \"bob\"}";
+
+typedef struct {
+  const char *text;
+  JSONErrorCode code;
+  size_t offset;
+} BindReject;
+
+// each with an arena, so only the values themselves are wrong
+static const BindReject REJECT[] = {
+    {"{\"id\": 1.5}", JSON_ERROR_TYPE, 7},
+    {"{\"id\": \"1\"}", JSON_ERROR_TYPE, 7},
+    {"{\"id\": 18446744073709551615}", JSON_ERROR_TYPE, 7},
+    {"{\"count\": -1}", JSON_ERROR_TYPE, 10},
+    {"{\"active\": 1}", JSON_ERROR_TYPE, 11},
+    {"{\"score\": true}", JSON_ERROR_TYPE, 10},
+    {"{\"name\": {\"a\": 1}}", JSON_ERROR_TYPE, 9},
+    {"{\"home\": [1]}", JSON_ERROR_TYPE, 9},
+    {"{\"tags\": [1]}", JSON_ERROR_TYPE, 10},
+    {"{\"stops\": [{\"lat\": \"n\"}]}", JSON_ERROR_TYPE, 19},
+    {"[1]", JSON_ERROR_TYPE, 0},
+    // a mismatched container is still checked
+    {"{\"name\": [1,]}", JSON_ERROR_UNEXPECTED, 12},
+    // and so is anything skipped
+    {"{\"extra\": {\"a\": [1,]}}", JSON_ERROR_UNEXPECTED, 19},
+    {"{\"id\": 1} 2", JSON_ERROR_TRAILING, 10},
+};
+
+static bool is(StringView s, const char *want) {
+  return s.len == strlen(want) && !memcmp(s.str, want, s.len);
+}
+
+static void check_full(JSONSchema *schema, JSONSchemaLookup lookup) {
+  Arena *arena = arena_new(0);
+  Record r;
+  memset(&r, 0, sizeof(r));
+  JSONError error = json_bind(schema, &r, FULL, strlen(FULL), arena);
+  CHECK(error.code == JSON_OK, "full record: %s at %zu",
+        json_error_string(error.code), error.offset);
+  CHECK(atomic_load(&schema->lookup) == lookup, "looked up through %d, want %d",
+        (int)atomic_load(&schema->lookup), (int)lookup);
+
+  CHECK(r.id == -7 && r.count == UINT64_MAX && r.active && r.score == 2.5,
+        "scalars %lld %llu %d %g", (long long)r.id,
+        (unsigned long long)r.count, r.active, r.score);
+  // the escaped key is the last `name'
+  CHECK(is(r.name, "bob"), "name %.*s", (int)r.name.len, r.name.str);
+  CHECK(r.home.lat == 1.5 && r.home.lon == -2, "home %g %g", r.home.lat,
+        r.home.lon);
+
+  StringView *tags = r.tags.items;
+  CHECK(r.tags.len == 2 && is(tags[0], "x") && is(tags[1], "y!"),
+        "%zu tags", r.tags.len);
+  Point *stops = r.stops.items;
+  CHECK(r.stops.len == 2 && stops[0].lat == 1 && stops[0].lon == 2 &&
+            stops[1].lat == 3 && stops[1].lon == 4,
+        "%zu stops", r.stops.len);
+  arena_free(arena);
+}
+
+// missing and null fields keep what was there, the last duplicate wins
+static void check_defaults(void) {
+  Record r = {.id = 42, .count = 7, .score = 0.5, .name = {"def", 3}};
+  const char *text = "{\"id\": null, \"score\": 1, \"score\": 3,"
+                     " \"home\": {\"lat\": 9}, \"tags\": []}";
+  r.home.lon = 8;
+  JSONError error = json_bind_record(&r, text, strlen(text), NULL);
+  CHECK(error.code == JSON_OK, "defaults: %s at %zu",
+        json_error_string(error.code), error.offset);
+  CHECK(r.id == 42 && r.count == 7 && !r.active && r.score == 3 &&
+            is(r.name, "def") && r.home.lat == 9 && r.home.lon == 8 &&
+            r.tags.len == 0,
+        "defaults %lld %llu %g", (long long)r.id, (unsigned long long)r.count,
+        r.score);
+}
+
+// strings point into the source unless they have to be decoded
+static void check_arena(void) {
+  Record r;
+  memset(&r, 0, sizeof(r));
+  const char *text = "{\"name\": \"plain\"}";
+  JSONError error = json_bind_record(&r, text, strlen(text), NULL);
+  CHECK(error.code == JSON_OK && r.name.str == text + 10,
+        "plain string without an arena: %s", json_error_string(error.code));
+
+  const char *needs[] = {"{\"name\": \"a\\nb\"}", "{\"tags\": [\"a\"]}",
+                         "{\"stops\": [{\"lat\": 1}]}"};
+  for (size_t i = 0; i < sizeof(needs) / sizeof(needs[0]); i++) {
+    error = json_bind_record(&r, needs[i], strlen(needs[i]), NULL);
+    CHECK(error.code == JSON_ERROR_MEMORY, "%s without an arena: %s",
+          needs[i], json_error_string(error.code));
+  }
+
+  Arena *arena = arena_new(0);
+  error = json_bind_record(&r, needs[0], strlen(needs[0]), arena);
+  CHECK(error.code == JSON_OK && is(r.name, "a\nb"),
+        "escaped string in an arena: %s", json_error_string(error.code));
+  arena_free(arena);
+}
+
+static void check_reject(const BindReject *c) {
+  Arena *arena = arena_new(0);
+  Record r;
+  memset(&r, 0, sizeof(r));
+  JSONError error = json_bind_record(&r, c->text, strlen(c->text), arena);
+  CHECK(error.code == c->code && error.offset == c->offset,
+        "%s: %s at %zu, want %s at %zu", c->text, json_error_string(error.code),
+        error.offset, json_error_string(c->code), c->offset);
+  arena_free(arena);
+}
+
+static void check_middle(void) {
+  const char *text = "{\"customer_b_address\": 2, \"customer_a_address\": 1,"
+                     " \"customer_d_address\": 4, \"customer_c_address\": 3}";
+  Middle m = {0, 0, 0};
+  JSONError error = json_bind_middle(&m, text, strlen(text), NULL);
+  CHECK(error.code == JSON_OK && m.a == 1 && m.b == 2 && m.c == 3,
+        "names differing in the middle: %s, %lld %lld %lld",
+        json_error_string(error.code), (long long)m.a, (long long)m.b,
+        (long long)m.c);
+  CHECK(atomic_load(&middle_schema.lookup) == JSON_SCHEMA_HASH,
+        "names differing in the middle looked up through %d",
+        (int)atomic_load(&middle_schema.lookup));
+}
+
+void test_bind_suite(void) {
+  check_full(&record_schema, JSON_SCHEMA_SIGNATURE);
+  check_full(&record_linear, JSON_SCHEMA_LINEAR);
+  check_middle();
+  check_defaults();
+  check_arena();
+  for (size_t i = 0; i < sizeof(REJECT) / sizeof(REJECT[0]); i++) {
+    check_reject(&REJECT[i]);
+  }
+}
@@ -0,0 +1,53 @@
+// Errors of `json_parse_file' for files that cannot be parsed.
+#include "file.h"
+#include "test.h"
+
+void test_file_suite(void) {
+  JSONFile file = json_parse_file("build/no-such-file.json");
+  JSONError error = json_last_error();
+  CHECK(!file.json.ok && error.code == JSON_ERROR_IO,
+        "missing file: %s at %zu", json_error_string(error.code), error.offset);
+  json_file_close(&file);
+
+  const char *path = "build/test-empty.json";
+  FILE *f = fopen(path, "wb");
+  CHECK(f != NULL, "cannot create %s", path);
+  if (!f) {
+    return;
+  }
+  fclose(f);
+
+  file = json_parse_file(path);
+  error = json_last_error();
+  CHECK(!file.json.ok && error.code == JSON_ERROR_EOF && error.offset == 0,
+        "empty file: %s at %zu", json_error_string(error.code), error.offset);
+  json_file_close(&file);
+
+  path = "build/test-doc.json";
+  f = fopen(path, "wb");
+  if (f) {
+    fputs("{\"a\": [1, 2, \"x\"]}\n", f);
+    fclose(f);
+  }
+
+  file = json_parse_file(path);
+  CHECK(file.json.ok && file.json.type == OBJECT, "file %s rejected", path);
+  json_file_close(&file);
+
+  // a directory opens but cannot be mapped
+  file = json_parse_file("build");
+  error = json_last_error();
+  CHECK(!file.json.ok && error.code == JSON_ERROR_IO,
+        "directory: %s at %zu", json_error_string(error.code), error.offset);
+  json_file_close(&file);
+
+  JSONMap map;
+  CHECK(json_map_file(&map, "build/test-empty.json", true) == JSON_ERROR_EOF,
+        "empty file maps");
+  CHECK(json_map_file(&map, path, false) == JSON_OK && map.len == 19,
+        "%s does not map", path);
+  json_unmap_file(&map);
+
+  remove(path);
+  remove("build/test-empty.json");
+}
@@ -0,0 +1,104 @@
+// Frozen copies read back as the trees they were made from.
+#include "frozen.h"
+#include "test.h"
+#include <string.h>
+
+static const char *DOCS[] = {
+    "null",
+    "true",
+    "-12",
+    "18446744073709551615",
+    "0.1",
+    "\"\"",
+    "\"a\\u0000b\"",
+    "[]",
+    "{}",
+    "[1, [2, [3, []]], {\"a\": {}}]",
+    "{\"a\": 1, \"b\": [true, false, null], \"c\": {\"d\": \"e\"},"
+    " \"\": -1.5e300, \"\\u00e9\": \"\\ud83d\\ude00\"}",
+    // past the small object limits of maps and frozen objects
+    "{\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5,"
+    " \"k6\": 6, \"k7\": 7, \"k8\": 8, \"k9\": 9, \"k10\": 10, \"k11\": 11,"
+    " \"k12\": {\"x\": [0, {\"y\": \"z\"}]}, \"k13\": \"s\", \"k14\": null}",
+};
+
+// `v' holds what `json' does, through the lookups of its frozen copy
+static bool frozen_same(JSONFrozenValue v, JSON json) {
+  if (!json_frozen_ok(v) || json_frozen_type(v) != json.type) {
+    return false;
+  }
+
+  switch (json.type) {
+  case OBJECT:
+    if (json_frozen_len(v) != json.map->size) {
+      return false;
+    }
+    for (size_t i = 0; i < json.map->cap; i++) {
+      BucketJSON *b = &json.map->values[i];
+      if (b->key &&
+          !frozen_same(json_frozen_get_n(v, b->key, b->key_len), b->value)) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < json_frozen_len(v); i++) {
+      StringView key;
+      JSONFrozenValue member = json_frozen_member(v, i, &key);
+      if (json_frozen_get_n(v, key.str, key.len).node != member.node) {
+        return false;
+      }
+    }
+    return !json_frozen_ok(json_frozen_get(v, "no such key"));
+  case ARRAY:
+    if (json_frozen_len(v) != json.vec->len) {
+      return false;
+    }
+    for (size_t i = 0; i < json.vec->len; i++) {
+      if (!frozen_same(json_frozen_at(v, i), json.vec->items[i])) {
+        return false;
+      }
+    }
+    return !json_frozen_ok(json_frozen_at(v, json.vec->len));
+  case STRING: {
+    size_t len;
+    const char *str = json_frozen_string(v, &len);
+    return str && len == json.len && !memcmp(str, json.str, len) &&
+           !str[len];
+  }
+  case NUMBER: {
+    double d;
+    return json_frozen_double(v, &d) && d == json.d;
+  }
+  case INTEGER: {
+    int64_t i;
+    return json_frozen_int64(v, &i) && i == json.i;
+  }
+  case UNSIGNED: {
+    uint64_t u;
+    return json_frozen_uint64(v, &u) && u == json.u;
+  }
+  case BOOLEAN:
+    return json_frozen_bool(v) == json.b;
+  case NIL:
+    return true;
+  }
+
+  return false;
+}
+
+static void check_frozen(const char *text, JSON json) {
+  JSONFrozen *frozen = json_freeze(json);
+  CHECK(frozen != NULL, "%s does not freeze", text);
+  if (frozen) {
+    CHECK(frozen_same(json_frozen_root(frozen), json),
+          "frozen %s reads differently", text);
+    json_frozen_free(frozen);
+  }
+}
+
+void test_frozen_suite(void) {
+  for (size_t i = 0; i < sizeof(DOCS) / sizeof(DOCS[0]); i++) {
+    JSON json = test_parse(DOCS[i]);
+    check_frozen(DOCS[i], json);
+    json_free(json);
+  }
+}
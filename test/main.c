@@ -0,0 +1,72 @@
+// Correctness tests of the parser and the formats built on it. Built and run
+// by `make test', exits with 1 when any check failed.
+#include "test.h"
+#include "stringify.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+size_t test_checks;
+size_t test_failures;
+
+void test_check(bool ok, const char *file, int line, const char *fmt, ...) {
+  test_checks++;
+  if (ok) {
+    return;
+  }
+
+  test_failures++;
+  fprintf(stderr, "%s:%d: ", file, line);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+JSON test_parse(const char *text) {
+  JSON json = json_parse(text);
+  if (!json.ok) {
+    fprintf(stderr, "test document does not parse: %s\n", text);
+    exit(2);
+  }
+
+  return json;
+}
+
+const char *test_text(JSON json) {
+  static char *text;
+  free(text);
+  text = json_stringify_alloc(json, 0, NULL);
+  return text ? text : "(null)";
+}
+
+int main(void) {
+  static const struct {
+    const char *name;
+    void (*run)(void);
+  } SUITES[] = {
+      {"stream", test_stream_suite},
+      {"batch", test_batch_suite},
+      {"file", test_file_suite},
+      {"query", test_query_suite},
+      {"parse", test_parse_suite},
+      {"parser", test_parser_suite},
+      {"bind", test_bind_suite},
+      {"snapshot", test_snapshot_suite},
+      {"parallel", test_parallel_suite},
+      {"stats", test_stats_suite},
+      {"frozen", test_frozen_suite},
+      {"patch", test_patch_suite},
+  };
+
+  for (size_t i = 0; i < sizeof(SUITES) / sizeof(SUITES[0]); i++) {
+    size_t checks = test_checks;
+    size_t failures = test_failures;
+    SUITES[i].run();
+    printf("%-10s %5zu checks, %zu failed\n", SUITES[i].name,
+           test_checks - checks, test_failures - failures);
+  }
+
+  pool_trim();
+  return test_failures ? 1 : 0;
+}
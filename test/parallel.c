@@ -0,0 +1,52 @@
+// Arrays split across workers parse as they do on one thread.
+#include "batch.h"
+#include "patch.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+void test_parallel_suite(void) {
+  // large enough for the workers to take over
+  size_t count = JSON_PARALLEL_MIN / 8;
+  size_t cap = count * 24 + 2;
+  char *text = malloc(cap);
+  size_t len = 0;
+  text[len++] = '[';
+  for (size_t i = 0; i < count; i++) {
+    len += (size_t)snprintf(text + len, cap - len,
+                            "%s{\"i\":%zu,\"s\":\"%zx\"}", i ? "," : "", i, i);
+    if (len + 32 > cap) {
+      break;
+    }
+  }
+  text[len++] = ']';
+
+  JSON serial = json_parse_n(text, len, NULL, 0);
+  for (size_t threads = 1; threads <= 4; threads *= 2) {
+    Arena *arena = arena_new(0);
+    JSON parallel = json_parse_parallel(text, len, arena, 0, threads);
+    CHECK(parallel.ok && json_equal(serial, parallel),
+          "parallel parse on %zu threads differs", threads);
+    arena_free(arena);
+
+    parallel = json_parse_parallel(text, len, NULL, 0, threads);
+    CHECK(parallel.ok && json_equal(serial, parallel),
+          "parallel parse on %zu threads without an arena differs", threads);
+    json_free(parallel);
+  }
+
+  // a bad element far into the array reports as the serial parse does
+  text[len - 100] = '\x01';
+  json_free(json_parse_n(text, len, NULL, 0));
+  JSONError want = json_last_error();
+  JSON parallel = json_parse_parallel(text, len, NULL, 0, 4);
+  JSONError error = json_last_error();
+  CHECK(!parallel.ok && want.code != JSON_OK && error.code == want.code &&
+            error.offset == want.offset,
+        "parallel error %s at %zu, serial %s at %zu",
+        json_error_string(error.code), error.offset,
+        json_error_string(want.code), want.offset);
+
+  json_free(serial);
+  free(text);
+}
@@ -0,0 +1,331 @@
+// Accept/reject corpus in the manner of JSONTestSuite: every document goes
+// through `json_parse_n', `json_validate', the tape and the push parser, which
+// must agree on the verdict and, for rejects, on the error and its offset.
+#include "patch.h"
+#include "stream.h"
+#include "stringify.h"
+#include "tape.h"
+#include "test.h"
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *text;
+  size_t len;
+} Case;
+
+typedef struct {
+  const char *text;
+  size_t len;
+  JSONErrorCode code;
+  size_t offset;
+} Reject;
+
+#define T(s) s, sizeof(s) - 1
+
+static const Case ACCEPT[] = {
+    {T("0")},
+    {T("-0")},
+    {T("1e5")},
+    {T("-1.5E-3")},
+    {T("0.25e+2")},
+    {T("123456789012345678901234567890")},
+    {T("18446744073709551615")},
+    {T("-9223372036854775808")},
+    {T("true")},
+    {T("false")},
+    {T("null")},
+    {T("\"\"")},
+    {T(" \t\r\n\"x\" \t\r\n")},
+    {T("[]")},
+    {T("{}")},
+    {T("[[]]")},
+    {T("[1,[2,[3,[4]]]]")},
+    {T("{\"a\":{\"b\":{\"c\":[]}}}")},
+    {T("{\"\":0}")},
+    {T("{\"a\":1,\"a\":2}")},
+    {T("[1, 2.5, -3e2, true, false, null, \"s\", {}, []]")},
+    {T("[\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]")},
+    {T("[\"\\u0000\\u001f\\u00e9\\uFFFF\"]")},
+    {T("[\"\\ud83d\\ude00\"]")},
+    // lone surrogates are well-formed escapes, JSON does not pair them
+    {T("[\"\\ud800\"]")},
+    {T("[\"\\udc00\\ud800\"]")},
+    {T("[\"\x7f\"]")},
+    {T("[\"\xc2\x80\xdf\xbf\"]")},
+    {T("[\"\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80\xef\xbf\xbf\"]")},
+    {T("[\"\xf0\x90\x80\x80\xf4\x8f\xbf\xbf\"]")},
+    {T("[\"\xe2\x82\xac\", \"\xf0\x9f\x98\x80\"]")},
+    {T("{\"\xc3\xa9t\xc3\xa9\":\"\xe6\x97\xa5\xe6\x9c\xac\"}")},
+    {T("[\"a\\\\\"]")},
+    {T("[\"\\\\\\\"\"]")},
+    {T("[\"]\", \"}\", \"{\", \"[\", \",\", \":\"]")},
+    {T("{\"k\" : [ 1 , { \"l\" : null } ] }")},
+    {T("[1e308, 1e-308, 2.2250738585072014e-308]")},
+};
+
+static const Reject REJECT[] = {
+    {T(""), JSON_ERROR_EOF, 0},
+    {T("   "), JSON_ERROR_EOF, 3},
+    {T("["), JSON_ERROR_EOF, 1},
+    {T("[1,"), JSON_ERROR_EOF, 3},
+    {T("{\"a\""), JSON_ERROR_EOF, 4},
+    {T("{\"a\":"), JSON_ERROR_EOF, 5},
+    {T("{"), JSON_ERROR_EOF, 1},
+    {T("[1 true]"), JSON_ERROR_UNEXPECTED, 3},
+    {T("[\"\",]"), JSON_ERROR_UNEXPECTED, 4},
+    {T("[,1]"), JSON_ERROR_UNEXPECTED, 1},
+    {T("[1,,2]"), JSON_ERROR_UNEXPECTED, 3},
+    {T("{\"a\":}"), JSON_ERROR_UNEXPECTED, 5},
+    {T("{\"a\" 1}"), JSON_ERROR_UNEXPECTED, 5},
+    {T("{\"a\":1,}"), JSON_ERROR_UNEXPECTED, 7},
+    {T("{1:2}"), JSON_ERROR_UNEXPECTED, 1},
+    {T("{\"a\"::1}"), JSON_ERROR_UNEXPECTED, 5},
+    {T("[}"), JSON_ERROR_UNEXPECTED, 1},
+    {T("{]"), JSON_ERROR_UNEXPECTED, 1},
+    {T("[1}"), JSON_ERROR_UNEXPECTED, 2},
+    {T("]"), JSON_ERROR_UNEXPECTED, 0},
+    {T(":"), JSON_ERROR_UNEXPECTED, 0},
+    {T("1]"), JSON_ERROR_TRAILING, 1},
+    {T("[][]"), JSON_ERROR_TRAILING, 2},
+    {T("{} {}"), JSON_ERROR_TRAILING, 3},
+    {T("1 2"), JSON_ERROR_TRAILING, 2},
+    {T("\"a\" \"b\""), JSON_ERROR_TRAILING, 4},
+    {T("[\"\t\"]"), JSON_ERROR_CONTROL, 2},
+    {T("[\"a\nb\"]"), JSON_ERROR_CONTROL, 3},
+    {T("[\"\x1f\"]"), JSON_ERROR_CONTROL, 2},
+    {T("[\"\\x\"]"), JSON_ERROR_ESCAPE, 2},
+    {T("[\"\\u12\"]"), JSON_ERROR_ESCAPE, 2},
+    {T("[\"\\u00G0\"]"), JSON_ERROR_ESCAPE, 2},
+    {T("[\"\\\x00\"]"), JSON_ERROR_ESCAPE, 2},
+    // at the first byte that cannot start or continue a sequence
+    {T("[\"\xff\"]"), JSON_ERROR_UTF8, 2},
+    {T("[\"\x80\"]"), JSON_ERROR_UTF8, 2},
+    {T("[\"\xc0\xaf\"]"), JSON_ERROR_UTF8, 2},
+    {T("[\"\xc2\"]"), JSON_ERROR_UTF8, 3},
+    {T("[\"\xe0\x80\xaf\"]"), JSON_ERROR_UTF8, 3},
+    {T("[\"\xf5\x80\x80\x80\"]"), JSON_ERROR_UTF8, 2},
+    {T("[\"\xf4\x90\x80\x80\"]"), JSON_ERROR_UTF8, 3},
+    {T("\"abc"), JSON_ERROR_UNTERMINATED_STRING, 0},
+    {T("[1, \"abc]"), JSON_ERROR_UNTERMINATED_STRING, 4},
+    {T("[-]"), JSON_ERROR_SCALAR, 1},
+    {T("[01]"), JSON_ERROR_SCALAR, 1},
+    {T("[1.]"), JSON_ERROR_SCALAR, 1},
+    {T("[.5]"), JSON_ERROR_SCALAR, 1},
+    {T("[1e]"), JSON_ERROR_SCALAR, 1},
+    {T("[+1]"), JSON_ERROR_SCALAR, 1},
+    {T("[0x10]"), JSON_ERROR_SCALAR, 1},
+    {T("[True]"), JSON_ERROR_SCALAR, 1},
+    {T("[nul]"), JSON_ERROR_SCALAR, 1},
+    {T("[nulll]"), JSON_ERROR_SCALAR, 1},
+    {T("[Infinity]"), JSON_ERROR_SCALAR, 1},
+    {T("[NaN]"), JSON_ERROR_SCALAR, 1},
+    {T("['a']"), JSON_ERROR_SCALAR, 1},
+};
+
+#undef T
+
+static const char *code_name(JSONErrorCode code) {
+  return json_error_string(code);
+}
+
+static void ignore(void *ctx, StringView key, JSON value) {}
+
+// runs `text' through the push parser, `chunk' bytes at a time
+static JSONError stream_error(const char *text, size_t len, size_t chunk) {
+  JSONStream *s = json_stream_new(0, ignore, NULL);
+  for (size_t i = 0; i < len; i += chunk) {
+    size_t n = len - i < chunk ? len - i : chunk;
+    if (!json_stream_feed(s, text + i, n)) {
+      break;
+    }
+  }
+
+  JSONError error = {JSON_OK, 0};
+  if (!json_stream_finish(s)) {
+    error = s->error;
+  }
+
+  json_stream_free(s);
+  return error;
+}
+
+// the error of the tape, whose tree must equal `json' when it is accepted
+static JSONError tape_error(const char *text, size_t len, JSON json) {
+  JSONTape tape = json_parse_tape_n(text, len);
+  JSONError error = tape.error;
+  CHECK(error.code == json_last_error().code &&
+            error.offset == json_last_error().offset,
+        "tape of %s leaves another last error", text);
+  if (tape.ok) {
+    JSON tree = json_tape_to_json(json_tape_root(&tape), NULL);
+    CHECK(tree.ok && json_equal(tree, json), "tape of %s builds %s", text,
+          test_text(tree));
+    json_free(tree);
+  }
+
+  json_tape_free(&tape);
+  return error;
+}
+
+static void check_accept(const Case *c) {
+  const char *t = c->text;
+  JSON json = json_parse_n(t, c->len, NULL, 0);
+  CHECK(json.ok, "parse rejects %s: %s at %zu", t,
+        code_name(json_last_error().code), json_last_error().offset);
+  json_free(json);
+
+  Arena *arena = arena_new(0);
+  json = json_parse_n(t, c->len, arena, JSON_ZERO_COPY);
+  CHECK(json.ok, "zero-copy parse rejects %s", t);
+  arena_free(arena);
+
+  JSONError error = json_validate(t, c->len);
+  CHECK(error.code == JSON_OK, "validate rejects %s: %s at %zu", t,
+        code_name(error.code), error.offset);
+
+  // the stringified tree parses back into the same one
+  json = json_parse_n(t, c->len, NULL, 0);
+  error = tape_error(t, c->len, json);
+  CHECK(error.code == JSON_OK, "tape rejects %s: %s at %zu", t,
+        code_name(error.code), error.offset);
+  char *text = json_stringify_alloc(json, JSON_PRETTY, NULL);
+  JSON back = json_parse(text);
+  CHECK(back.ok && json_equal(back, json), "%s reads back as %s", t, text);
+  json_free(back);
+  free(text);
+  json_free(json);
+
+  for (size_t chunk = 1; chunk <= c->len; chunk *= 3) {
+    error = stream_error(t, c->len, chunk);
+    CHECK(error.code == JSON_OK, "stream(%zu) rejects %s: %s at %zu", chunk,
+          t, code_name(error.code), error.offset);
+  }
+}
+
+static bool same_error(JSONError error, const Reject *r) {
+  return error.code == r->code && error.offset == r->offset;
+}
+
+static void check_reject(const Reject *r) {
+  const char *t = r->text;
+  JSON json = json_parse_n(t, r->len, NULL, 0);
+  JSONError error = json_last_error();
+  CHECK(!json.ok && same_error(error, r), "parse %s: %s at %zu, want %s at %zu",
+        t, code_name(error.code), error.offset, code_name(r->code), r->offset);
+  json_free(json);
+
+  error = json_validate(t, r->len);
+  CHECK(same_error(error, r), "validate %s: %s at %zu, want %s at %zu", t,
+        code_name(error.code), error.offset, code_name(r->code), r->offset);
+  error = tape_error(t, r->len, (JSON){.ok = false});
+  CHECK(same_error(error, r), "tape %s: %s at %zu, want %s at %zu", t,
+        code_name(error.code), error.offset, code_name(r->code), r->offset);
+
+  // the stream takes concatenated documents
+  if (r->code == JSON_ERROR_TRAILING && r->text[r->offset] != ']' &&
+      r->text[r->offset] != '}') {
+    return;
+  }
+
+  size_t len = r->len ? r->len : 1;
+  for (size_t chunk = 1; chunk <= len; chunk *= 3) {
+    error = stream_error(t, r->len, chunk);
+    CHECK(same_error(error, r), "stream(%zu) %s: %s at %zu, want %s at %zu",
+          chunk, t, code_name(error.code), error.offset, code_name(r->code),
+          r->offset);
+  }
+}
+
+static void check_depth(void) {
+  size_t depth = JSON_MAX_DEPTH + 1;
+  char *text = malloc(2 * depth);
+  memset(text, '[', depth);
+  memset(text + depth, ']', depth);
+
+  Reject r = {text, 2 * depth, JSON_ERROR_DEPTH, JSON_MAX_DEPTH};
+  check_reject(&r);
+
+  Case c = {text + 1, 2 * depth - 2};
+  check_accept(&c);
+  free(text);
+}
+
+static void check_values(void) {
+  JSON json = test_parse("[-0, 9223372036854775807, 9223372036854775808,"
+                         " 18446744073709551616, 1.5,"
+                         " \"\\u00e9\\ud83d\\ude00\", \"a\\u0000b\"]");
+  JSON *v = json.vec->items;
+  CHECK(v[0].type == INTEGER && v[0].i == 0, "-0 is %s", test_text(v[0]));
+  CHECK(v[1].type == INTEGER && v[1].i == INT64_MAX, "INT64_MAX is %s",
+        test_text(v[1]));
+  CHECK(v[2].type == UNSIGNED && v[2].u == (uint64_t)INT64_MAX + 1,
+        "INT64_MAX + 1 is %s", test_text(v[2]));
+  CHECK(v[3].type == NUMBER && v[3].d == 18446744073709551616.0,
+        "UINT64_MAX + 1 is %s", test_text(v[3]));
+  CHECK(v[4].type == NUMBER && v[4].d == 1.5, "1.5 is %s", test_text(v[4]));
+  CHECK(v[5].type == STRING && v[5].len == 6 &&
+            !memcmp(v[5].str, "\xc3\xa9\xf0\x9f\x98\x80", 6),
+        "escaped string is %s", test_text(v[5]));
+  CHECK(v[6].type == STRING && v[6].len == 3 && !memcmp(v[6].str, "a\0b", 3),
+        "escaped NUL is %s", test_text(v[6]));
+  json_free(json);
+
+  json = test_parse("{\"a\": [1, {\"b\": null}], \"c\": \"d\"}");
+  CHECK(!strcmp(test_text(json), "{\"a\":[1,{\"b\":null}],\"c\":\"d\"}"),
+        "stringified as %s", test_text(json));
+  json_free(json);
+}
+
+// inputs the fast paths hand to the slow one, read the same whatever the
+// locale says the decimal point is
+static void check_slow_numbers(void) {
+  static const char *const LOCALES[] = {"de_DE.UTF-8", "fr_FR.UTF-8",
+                                        "de_DE", "fr_FR"};
+  for (size_t i = 0; i < sizeof(LOCALES) / sizeof(LOCALES[0]); i++) {
+    if (setlocale(LC_NUMERIC, LOCALES[i])) {
+      break;
+    }
+  }
+
+  JSON json = test_parse("[1.2345678901234567890123, 9007199254740993.0,"
+                         " 2.4703282292062328e-324, 1e-400, 7e-10000000]");
+  JSON *v = json.vec->items;
+  CHECK(v[0].d == 1.2345678901234567890123, "long fraction is %s",
+        test_text(v[0]));
+  CHECK(v[1].d == 9007199254740992.0, "halfway is %s", test_text(v[1]));
+  CHECK(v[2].d == 4.9406564584124654e-324, "smallest subnormal is %s",
+        test_text(v[2]));
+  CHECK(v[3].d == 0 && v[4].d == 0, "underflow is %s and %s", test_text(v[3]),
+        test_text(v[4]));
+  json_free(json);
+
+  // past the digits that are kept exactly, a dropped 1 still rounds up
+  size_t zeros = 900;
+  char *text = malloc(zeros + 32);
+  int len = sprintf(text, "9007199254740993");
+  memset(text + len, '0', zeros);
+  len += (int)zeros;
+  len += sprintf(text + len, "1e-%zu", zeros + 1);
+  json = json_parse_n(text, (size_t)len, NULL, 0);
+  CHECK(json.ok && json.type == NUMBER && json.d == 9007199254740994.0,
+        "halfway and a bit is %s", test_text(json));
+  json_free(json);
+  free(text);
+
+  setlocale(LC_NUMERIC, "C");
+}
+
+void test_parse_suite(void) {
+  for (size_t i = 0; i < sizeof(ACCEPT) / sizeof(ACCEPT[0]); i++) {
+    check_accept(&ACCEPT[i]);
+  }
+  for (size_t i = 0; i < sizeof(REJECT) / sizeof(REJECT[0]); i++) {
+    check_reject(&REJECT[i]);
+  }
+
+  check_depth();
+  check_values();
+  check_slow_numbers();
+}
@@ -0,0 +1,145 @@
+// Parsers kept from one document to the next: their depth limit, their
+// errors, and the buffers they reuse.
+#include "patch.h"
+#include "test.h"
+#include <string.h>
+
+typedef struct {
+  const char *text;
+  // `JSON_OK' when the document parses
+  JSONErrorCode code;
+  size_t offset;
+} ParserCase;
+
+// against a parser limited to 3 levels
+static const ParserCase DEPTH[] = {
+    {"[[[1]]]", JSON_OK, 0},
+    {"{\"a\":[{\"b\":1}]}", JSON_OK, 0},
+    {"[[[[1]]]]", JSON_ERROR_DEPTH, 3},
+    {"{\"a\":[{\"b\":[1]}]}", JSON_ERROR_DEPTH, 11},
+    {"[1, [2, [3, {}]]]", JSON_ERROR_DEPTH, 12},
+    // the limit is checked before the rest of the document
+    {"[[[[1]]", JSON_ERROR_DEPTH, 3},
+};
+
+// rejected documents of every stage, each followed by a good one
+static const ParserCase REUSE[] = {
+    {"[1,", JSON_ERROR_EOF, 3},
+    {"{\"a\":1,\"b\" 2}", JSON_ERROR_UNEXPECTED, 11},
+    {"{\"a\":{\"b\":[1,tru]}}", JSON_ERROR_SCALAR, 13},
+    {"[\"\\x\"]", JSON_ERROR_ESCAPE, 2},
+    {"{\"k\":\"v\"} 1", JSON_ERROR_TRAILING, 10},
+};
+
+static const char GOOD[] = "{\"k\":[1,{\"x\":\"y\"},[true,null]],\"n\":-2.5}";
+
+static void check_case(JSONParser *parser, const ParserCase *c, Arena *arena) {
+  JSON json = json_parser_parse(parser, c->text, strlen(c->text), arena, 0);
+  JSONError last = json_last_error();
+  if (c->code == JSON_OK) {
+    CHECK(json.ok && parser->error.code == JSON_OK, "%s: %s at %zu", c->text,
+          json_error_string(parser->error.code), parser->error.offset);
+  } else {
+    CHECK(!json.ok && parser->error.code == c->code &&
+              parser->error.offset == c->offset,
+          "%s: %s at %zu, want %s at %zu", c->text,
+          json_error_string(parser->error.code), parser->error.offset,
+          json_error_string(c->code), c->offset);
+  }
+  CHECK(last.code == parser->error.code && last.offset == parser->error.offset,
+        "%s: last error %s at %zu, parser has %s at %zu", c->text,
+        json_error_string(last.code), last.offset,
+        json_error_string(parser->error.code), parser->error.offset);
+  if (!arena) {
+    json_free(json);
+  }
+}
+
+static void check_depth(void) {
+  JSONParser *parser = json_parser_new(3);
+  for (size_t i = 0; i < sizeof(DEPTH) / sizeof(DEPTH[0]); i++) {
+    check_case(parser, &DEPTH[i], NULL);
+  }
+  json_parser_free(parser);
+
+  // 0 and anything past it are `JSON_MAX_DEPTH'
+  size_t depth = JSON_MAX_DEPTH + 1;
+  char text[2 * (JSON_MAX_DEPTH + 1)];
+  memset(text, '[', depth);
+  memset(text + depth, ']', depth);
+  size_t limits[] = {0, JSON_MAX_DEPTH * 2};
+  for (size_t i = 0; i < 2; i++) {
+    parser = json_parser_new(limits[i]);
+    JSON json = json_parser_parse(parser, text + 1, 2 * depth - 2, NULL, 0);
+    CHECK(json.ok, "%zu levels with max_depth %zu: %s", depth - 1, limits[i],
+          json_error_string(parser->error.code));
+    json_free(json);
+    json = json_parser_parse(parser, text, 2 * depth, NULL, 0);
+    CHECK(!json.ok && parser->error.code == JSON_ERROR_DEPTH &&
+              parser->error.offset == JSON_MAX_DEPTH,
+          "%zu levels with max_depth %zu: %s at %zu", depth, limits[i],
+          json_error_string(parser->error.code), parser->error.offset);
+    json_parser_free(parser);
+  }
+}
+
+static void check_reuse(void) {
+  JSONParser *parser = json_parser_new(0);
+  JSON want = test_parse(GOOD);
+  const ParserCase good = {GOOD, JSON_OK, 0};
+
+  for (size_t i = 0; i < sizeof(REUSE) / sizeof(REUSE[0]); i++) {
+    check_case(parser, &REUSE[i], NULL);
+
+    JSON json = json_parser_parse(parser, GOOD, strlen(GOOD), NULL, 0);
+    CHECK(json.ok && json_equal(json, want), "after %s: %s", REUSE[i].text,
+          json.ok ? test_text(json) : json_error_string(parser->error.code));
+    json_free(json);
+    check_case(parser, &good, NULL);
+  }
+
+  json_free(want);
+  json_parser_free(parser);
+}
+
+// once the largest and deepest document was seen, the index and the stacks
+// are neither grown nor moved
+static void check_bookkeeping(void) {
+  JSONParser *parser = json_parser_new(0);
+  Arena *arena = arena_new(0);
+  const char *small = "[{\"a\":[1]}]";
+  JSON json = json_parser_parse(parser, GOOD, strlen(GOOD), arena, 0);
+
+  const uint32_t *positions = parser->index.positions;
+  size_t index_cap = parser->index.cap;
+  const void *keys = parser->keys->items;
+  size_t keys_cap = parser->keys->cap;
+  const void *vec_ctx = parser->vec_ctx->items;
+  size_t vec_ctx_cap = parser->vec_ctx->cap;
+
+  bool ok = json.ok;
+  for (int i = 0; i < 100; i++) {
+    arena_reset(arena);
+    const char *text = i % 3 ? GOOD : i % 2 ? small : REUSE[i % 5].text;
+    json = json_parser_parse(parser, text, strlen(text), arena, 0);
+    ok &= json.ok || text == REUSE[i % 5].text;
+  }
+  CHECK(ok, "repeated documents did not parse");
+  CHECK(parser->index.positions == positions && parser->index.cap == index_cap,
+        "index grew from %zu to %zu", index_cap, parser->index.cap);
+  CHECK(parser->keys->items == keys && parser->keys->cap == keys_cap,
+        "key stack grew from %zu to %zu", keys_cap, parser->keys->cap);
+  CHECK(parser->vec_ctx->items == vec_ctx &&
+            parser->vec_ctx->cap == vec_ctx_cap,
+        "context stack grew from %zu to %zu", vec_ctx_cap,
+        parser->vec_ctx->cap);
+
+  arena_free(arena);
+  json_parser_free(parser);
+}
+
+void test_parser_suite(void) {
+  check_depth();
+  check_reuse();
+  check_bookkeeping();
+}
@@ -0,0 +1,205 @@
+// RFC 6902 appendix A and RFC 7396 appendix A, applied in place without and
+// with an arena, and as a new version sharing the old one.
+#include "intern.h"
+#include "patch.h"
+#include "test.h"
+#include <string.h>
+
+typedef struct {
+  const char *target;
+  const char *patch;
+  // the result, NULL when the patch fails with `code' at `offset'
+  const char *want;
+  JSONErrorCode code;
+  size_t offset;
+} PatchCase;
+
+static const PatchCase RFC6902[] = {
+    // A.1 to A.5
+    {"{\"foo\": \"bar\"}",
+     "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\"}]",
+     "{\"baz\": \"qux\", \"foo\": \"bar\"}"},
+    {"{\"foo\": [\"bar\", \"baz\"]}",
+     "[{\"op\": \"add\", \"path\": \"/foo/1\", \"value\": \"qux\"}]",
+     "{\"foo\": [\"bar\", \"qux\", \"baz\"]}"},
+    {"{\"baz\": \"qux\", \"foo\": \"bar\"}",
+     "[{\"op\": \"remove\", \"path\": \"/baz\"}]", "{\"foo\": \"bar\"}"},
+    {"{\"foo\": [\"bar\", \"qux\", \"baz\"]}",
+     "[{\"op\": \"remove\", \"path\": \"/foo/1\"}]",
+     "{\"foo\": [\"bar\", \"baz\"]}"},
+    {"{\"baz\": \"qux\", \"foo\": \"bar\"}",
+     "[{\"op\": \"replace\", \"path\": \"/baz\", \"value\": \"boo\"}]",
+     "{\"baz\": \"boo\", \"foo\": \"bar\"}"},
+    // A.6 and A.7
+    {"{\"foo\": {\"bar\": \"baz\", \"waldo\": \"fred\"},"
+     " \"qux\": {\"corge\": \"grault\"}}",
+     "[{\"op\": \"move\", \"from\": \"/foo/waldo\", \"path\": \"/qux/thud\"}]",
+     "{\"foo\": {\"bar\": \"baz\"},"
+     " \"qux\": {\"corge\": \"grault\", \"thud\": \"fred\"}}"},
+    {"{\"foo\": [\"all\", \"grass\", \"cows\", \"eat\"]}",
+     "[{\"op\": \"move\", \"from\": \"/foo/1\", \"path\": \"/foo/3\"}]",
+     "{\"foo\": [\"all\", \"cows\", \"eat\", \"grass\"]}"},
+    // A.8 and A.9
+    {"{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}",
+     "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"qux\"},"
+     " {\"op\": \"test\", \"path\": \"/foo/1\", \"value\": 2}]",
+     "{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}"},
+    {"{\"baz\": \"qux\"}",
+     "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"bar\"}]", NULL,
+     JSON_ERROR_TEST, 0},
+    // A.10 and A.11
+    {"{\"foo\": \"bar\"}",
+     "[{\"op\": \"add\", \"path\": \"/child\","
+     " \"value\": {\"grandchild\": {}}}]",
+     "{\"foo\": \"bar\", \"child\": {\"grandchild\": {}}}"},
+    {"{\"foo\": \"bar\"}",
+     "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\","
+     " \"xyz\": 123}]",
+     "{\"foo\": \"bar\", \"baz\": \"qux\"}"},
+    // A.12, A.13 keeps the last of the duplicate `op' members
+    {"{\"foo\": \"bar\"}",
+     "[{\"op\": \"add\", \"path\": \"/baz/bat\", \"value\": \"qux\"}]", NULL,
+     JSON_ERROR_PATH, 0},
+    {"{\"foo\": \"bar\"}",
+     "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\","
+     " \"op\": \"remove\"}]",
+     NULL, JSON_ERROR_PATH, 0},
+    // A.14 to A.16
+    {"{\"/\": 9, \"~1\": 10}",
+     "[{\"op\": \"test\", \"path\": \"/~01\", \"value\": 10}]",
+     "{\"/\": 9, \"~1\": 10}"},
+    {"{\"/\": 9, \"~1\": 10}",
+     "[{\"op\": \"test\", \"path\": \"/~01\", \"value\": \"10\"}]", NULL,
+     JSON_ERROR_TEST, 0},
+    {"{\"foo\": [\"bar\"]}",
+     "[{\"op\": \"add\", \"path\": \"/foo/-\", \"value\": [\"abc\", \"def\"]}]",
+     "{\"foo\": [\"bar\", [\"abc\", \"def\"]]}"},
+    // beyond the appendix: copy, the root, and errors by operation index
+    {"{\"a\": {\"b\": [1]}}",
+     "[{\"op\": \"copy\", \"from\": \"/a\", \"path\": \"/c\"},"
+     " {\"op\": \"add\", \"path\": \"/c/b/0\", \"value\": 0}]",
+     "{\"a\": {\"b\": [1]}, \"c\": {\"b\": [0, 1]}}"},
+    {"{\"a\": 1}", "[{\"op\": \"replace\", \"path\": \"\", \"value\": [2]}]",
+     "[2]"},
+    {"{\"a\": 1}",
+     "[{\"op\": \"test\", \"path\": \"/a\", \"value\": 1.0},"
+     " {\"op\": \"remove\", \"path\": \"/nope\"}]",
+     NULL, JSON_ERROR_PATH, 1},
+    {"{\"a\": [1]}",
+     "[{\"op\": \"add\", \"path\": \"/a/2\", \"value\": 3}]", NULL,
+     JSON_ERROR_PATH, 0},
+    {"{\"a\": {}}",
+     "[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/a/b\"}]", NULL,
+     JSON_ERROR_PATCH, 0},
+    {"{}", "[{\"op\": \"jump\", \"path\": \"/a\"}]", NULL, JSON_ERROR_PATCH, 0},
+    {"{}", "[{\"op\": \"add\", \"path\": \"/a\"}]", NULL, JSON_ERROR_PATCH, 0},
+    {"{}", "{\"op\": \"add\"}", NULL, JSON_ERROR_PATCH, 0},
+};
+
+static const PatchCase RFC7396[] = {
+    {"{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+    {"{\"a\":\"b\"}", "{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}"},
+    {"{\"a\":\"b\"}", "{\"a\":null}", "{}"},
+    {"{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}", "{\"b\":\"c\"}"},
+    {"{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+    {"{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":[\"b\"]}"},
+    {"{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}",
+     "{\"a\":{\"b\":\"d\"}}"},
+    {"{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}", "{\"a\":[1]}"},
+    {"[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]"},
+    {"{\"a\":\"b\"}", "[\"c\"]", "[\"c\"]"},
+    {"{\"a\":\"foo\"}", "null", "null"},
+    {"{\"a\":\"foo\"}", "\"bar\"", "\"bar\""},
+    {"{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}"},
+    {"[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}"},
+    {"{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}"},
+};
+
+typedef JSONError (*Apply)(JSON *target, JSON patch, Arena *arena,
+                           unsigned flags);
+
+static bool same(JSON json, const char *text) {
+  JSON want = test_parse(text);
+  bool equal = json_equal(json, want);
+  json_free(want);
+  return equal;
+}
+
+static void check(const char *name, Apply apply, const PatchCase *c) {
+  JSON patch = test_parse(c->patch);
+
+  // in place, released with `json_free'
+  JSON target = test_parse(c->target);
+  JSONError error = apply(&target, patch, NULL, 0);
+  if (c->want) {
+    CHECK(error.code == JSON_OK && same(target, c->want),
+          "%s %s to %s: %s, got %s", name, c->patch, c->target,
+          json_error_string(error.code), test_text(target));
+  } else {
+    CHECK(error.code == c->code && error.offset == c->offset,
+          "%s %s to %s: %s at %zu, want %s at %zu", name, c->patch, c->target,
+          json_error_string(error.code), error.offset,
+          json_error_string(c->code), c->offset);
+  }
+  json_free(target);
+
+  // in place in an arena, keys and strings borrowed from the source
+  Arena *arena = arena_new(0);
+  target = json_parse_ex(c->target, arena, JSON_ZERO_COPY);
+  error = apply(&target, patch, arena, 0);
+  CHECK(c->want ? error.code == JSON_OK && same(target, c->want)
+                : error.code == c->code,
+        "%s %s to %s in an arena: %s, got %s", name, c->patch, c->target,
+        json_error_string(error.code), test_text(target));
+
+  // a new version, the old one must not change
+  arena_reset(arena);
+  JSON old = json_parse_arena(c->target, arena);
+  target = old;
+  error = apply(&target, patch, arena, JSON_PATCH_SHARE);
+  CHECK(c->want ? error.code == JSON_OK && same(target, c->want)
+                : error.code == c->code && target.map == old.map,
+        "%s %s to %s shared: %s, got %s", name, c->patch, c->target,
+        json_error_string(error.code), test_text(target));
+  CHECK(same(old, c->target), "%s %s changed the shared %s into %s", name,
+        c->patch, c->target, test_text(old));
+  arena_free(arena);
+
+  json_free(patch);
+}
+
+// maps that borrow interned keys get keys of their own before they change
+static void check_interned(void) {
+  const char *text = "{\"a\": {\"b\": 1, \"c\": 2}, \"d\": [{\"e\": 3}]}";
+  JSONInterner *interner = json_interner_new();
+  JSON target = json_parse_interned(text, strlen(text), NULL, 0, interner);
+
+  JSON patch = test_parse("{\"a\": {\"b\": null, \"f\": 4}, \"g\": 5}");
+  JSONError error = json_merge_patch(&target, patch, NULL, 0);
+  json_free(patch);
+  patch = test_parse("[{\"op\": \"add\", \"path\": \"/d/0/h\", \"value\": 6},"
+                     " {\"op\": \"move\", \"from\": \"/a/c\","
+                     " \"path\": \"/i\"}]");
+  if (error.code == JSON_OK) {
+    error = json_patch(&target, patch, NULL, 0);
+  }
+  json_free(patch);
+
+  CHECK(error.code == JSON_OK &&
+            same(target, "{\"a\": {\"f\": 4}, \"d\": [{\"e\": 3, \"h\": 6}],"
+                         " \"g\": 5, \"i\": 2}"),
+        "interned document patched into %s", test_text(target));
+  json_free(target);
+  json_interner_free(interner);
+}
+
+void test_patch_suite(void) {
+  for (size_t i = 0; i < sizeof(RFC6902) / sizeof(RFC6902[0]); i++) {
+    check("patch", json_patch, &RFC6902[i]);
+  }
+  for (size_t i = 0; i < sizeof(RFC7396) / sizeof(RFC7396[0]); i++) {
+    check("merge", json_merge_patch, &RFC7396[i]);
+  }
+
+  check_interned();
+}
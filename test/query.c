@@ -0,0 +1,193 @@
+// RFC 6901 section 5 pointers and the JSONPath subset, on trees and through
+// cursors.
+#include "patch.h"
+#include "query.h"
+#include "test.h"
+#include <string.h>
+
+static const char RFC6901[] =
+    "{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2,"
+    " \"e^f\": 3, \"g|h\": 4, \"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7,"
+    " \"m~n\": 8}";
+
+typedef struct {
+  const char *expr;
+  // compact text of every match, separated by spaces, NULL when the
+  // expression does not compile
+  const char *want;
+} QueryCase;
+
+// the only match is the whole document
+static const char ROOT[] = "(root)";
+
+static const QueryCase POINTERS[] = {
+    {"", ROOT},
+    {"/foo", "[\"bar\",\"baz\"]"},
+    {"/foo/0", "\"bar\""},
+    {"/", "0"},
+    {"/a~1b", "1"},
+    {"/c%d", "2"},
+    {"/e^f", "3"},
+    {"/g|h", "4"},
+    {"/i\\j", "5"},
+    {"/k\"l", "6"},
+    {"/ ", "7"},
+    {"/m~0n", "8"},
+    // not there
+    {"/foo/2", ""},
+    {"/foo/-", ""},
+    {"/foo/01", ""},
+    {"/foo/-1", ""},
+    {"/m~01", ""},
+    {"/a/b", ""},
+    {"/foo/0/x", ""},
+    // not pointers
+    {"foo", NULL},
+    {"/m~2n", NULL},
+    {"/m~", NULL},
+};
+
+static const QueryCase PATHS[] = {
+    {"$", ROOT},
+    {"$.foo[1]", "\"baz\""},
+    {"$.foo[-1]", "\"baz\""},
+    {"$.foo[-3]", ""},
+    {"$['a/b']", "1"},
+    {"$.foo[*]", "\"bar\" \"baz\""},
+    {"$..[0]", "\"bar\""},
+    {"$.nope", ""},
+    {"$[", NULL},
+};
+
+static void append(char *out, size_t cap, JSON json) {
+  size_t len = strlen(out);
+  snprintf(out + len, cap - len, "%s%s", len ? " " : "", test_text(json));
+}
+
+static void on_match(void *ctx, JSONCursor match) {
+  JSON json = json_cursor_value(match, NULL, 0);
+  append(ctx, 512, json);
+  json_free(json);
+}
+
+static void check(JSON *root, JSONDoc *doc, const QueryCase *c) {
+  JSONQuery *q = json_query_compile(c->expr, strlen(c->expr));
+  if (!c->want) {
+    CHECK(!q, "%s compiles", c->expr);
+    json_query_free(q);
+    return;
+  }
+
+  if (c->want == ROOT) {
+    CHECK(q && json_query_first(q, root) == root, "%s is not the root",
+          c->expr);
+    json_query_free(q);
+    return;
+  }
+
+  CHECK(q != NULL, "%s does not compile", c->expr);
+  if (!q) {
+    return;
+  }
+
+  struct VectorJSONPTR *out = vector_jsonp_new();
+  size_t found = json_query_run(q, root, out);
+  char tree[512] = "";
+  for (size_t i = 0; i < out->len; i++) {
+    append(tree, sizeof(tree), *out->items[i]);
+  }
+  CHECK(found == out->len && !strcmp(tree, c->want), "%s on the tree: %s",
+        c->expr, tree);
+  size_t out_len = out->len;
+  vector_jsonp_free(out);
+
+  char lazy[512] = "";
+  found = json_query_each(q, json_doc_root(doc), on_match, lazy);
+  CHECK(found == out_len && !strcmp(lazy, c->want), "%s on cursors: %s",
+        c->expr, lazy);
+
+  JSON *first = json_query_first(q, root);
+  CHECK(*c->want ? first != NULL : first == NULL, "first match of %s",
+        c->expr);
+  json_query_free(q);
+}
+
+// objects past `HASHMAP_SMALL_MAX' members, where cursors keep document order
+static void check_large(void) {
+  const char *text = "{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,"
+                     "\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10}";
+  JSON root = test_parse(text);
+  JSONDoc doc;
+  json_doc_open(&doc, text, strlen(text));
+
+  JSONQuery *q = json_query_compile("$.*", 3);
+  struct VectorJSONPTR *out = vector_jsonp_new();
+  size_t found = json_query_run(q, &root, out);
+  int64_t sum = 0;
+  for (size_t i = 0; i < out->len; i++) {
+    sum += out->items[i]->i;
+  }
+  CHECK(found == 11 && sum == 55, "$.* finds %zu members adding to %lld",
+        found, (long long)sum);
+  vector_jsonp_free(out);
+
+  char lazy[512] = "";
+  json_query_each(q, json_doc_root(&doc), on_match, lazy);
+  CHECK(!strcmp(lazy, "0 1 2 3 4 5 6 7 8 9 10"), "$.* on cursors: %s", lazy);
+  json_query_free(q);
+
+  json_doc_close(&doc);
+  json_free(root);
+}
+
+// the last of repeated keys, on trees and cursors alike
+static void check_duplicates(void) {
+  const char *text = "{\"a\": 1, \"b\": {\"a\": 2}, \"a\": 3}";
+  JSON root = test_parse(text);
+  JSONDoc doc;
+  json_doc_open(&doc, text, strlen(text));
+
+  static const QueryCase CASES[] = {
+      {"/a", "3"},
+      {"$.a", "3"},
+      {"$..a", "3 2"},
+  };
+  for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+    JSONQuery *q = json_query_compile(CASES[i].expr, strlen(CASES[i].expr));
+    char lazy[512] = "";
+    json_query_each(q, json_doc_root(&doc), on_match, lazy);
+    CHECK(!strcmp(lazy, CASES[i].want), "%s on duplicates: %s", CASES[i].expr,
+          lazy);
+    JSON *first = json_query_first(q, &root);
+    CHECK(first && first->type == INTEGER && first->i == 3,
+          "%s on the duplicates' tree", CASES[i].expr);
+    json_query_free(q);
+  }
+
+  JSONCursor a = json_cursor_find(json_doc_root(&doc), "a", 1);
+  JSON value = json_cursor_value(a, NULL, 0);
+  CHECK(value.type == INTEGER && value.i == 3, "cursor finds a = %s",
+        test_text(value));
+  json_free(value);
+
+  json_doc_close(&doc);
+  json_free(root);
+}
+
+void test_query_suite(void) {
+  JSON root = test_parse(RFC6901);
+  JSONDoc doc;
+  CHECK(json_doc_open(&doc, RFC6901, strlen(RFC6901)), "doc does not open");
+
+  for (size_t i = 0; i < sizeof(POINTERS) / sizeof(POINTERS[0]); i++) {
+    check(&root, &doc, &POINTERS[i]);
+  }
+  for (size_t i = 0; i < sizeof(PATHS) / sizeof(PATHS[0]); i++) {
+    check(&root, &doc, &PATHS[i]);
+  }
+
+  json_doc_close(&doc);
+  json_free(root);
+  check_large();
+  check_duplicates();
+}
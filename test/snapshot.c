@@ -0,0 +1,175 @@
+// Snapshots read back as the trees they were written from.
+#include "patch.h"
+#include "snapshot.h"
+#include "test.h"
+#include <string.h>
+
+static const char *DOCS[] = {
+    "null",
+    "true",
+    "-12",
+    "18446744073709551615",
+    "0.1",
+    "\"\"",
+    "\"a\\u0000b\"",
+    "[]",
+    "{}",
+    "[1, [2, [3, []]], {\"a\": {}}]",
+    "{\"a\": 1, \"b\": [true, false, null], \"c\": {\"d\": \"e\"},"
+    " \"\": -1.5e300, \"\\u00e9\": \"\\ud83d\\ude00\"}",
+    // past the small object limits of maps and snapshots
+    "{\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5,"
+    " \"k6\": 6, \"k7\": 7, \"k8\": 8, \"k9\": 9, \"k10\": 10, \"k11\": 11,"
+    " \"k12\": {\"x\": [0, {\"y\": \"z\"}]}, \"k13\": \"s\", \"k14\": null}",
+};
+
+// `v' holds what `json' does, through the lookups of its snapshot
+static bool snap_same(JSONSnapValue v, JSON json) {
+  if (!json_snapshot_ok(v) || json_snapshot_type(v) != json.type) {
+    return false;
+  }
+
+  switch (json.type) {
+  case OBJECT:
+    if (json_snapshot_len(v) != json.map->size) {
+      return false;
+    }
+    for (size_t i = 0; i < json.map->cap; i++) {
+      BucketJSON *b = &json.map->values[i];
+      if (b->key &&
+          !snap_same(json_snapshot_get_n(v, b->key, b->key_len), b->value)) {
+        return false;
+      }
+    }
+    return !json_snapshot_ok(json_snapshot_get(v, "no such key"));
+  case ARRAY:
+    if (json_snapshot_len(v) != json.vec->len) {
+      return false;
+    }
+    for (size_t i = 0; i < json.vec->len; i++) {
+      if (!snap_same(json_snapshot_at(v, i), json.vec->items[i])) {
+        return false;
+      }
+    }
+    return !json_snapshot_ok(json_snapshot_at(v, json.vec->len));
+  case STRING: {
+    size_t len;
+    const char *str = json_snapshot_string(v, &len);
+    return str && len == json.len && !memcmp(str, json.str, len) &&
+           !str[len];
+  }
+  case NUMBER: {
+    double d;
+    return json_snapshot_double(v, &d) && d == json.d;
+  }
+  case INTEGER: {
+    int64_t i;
+    return json_snapshot_int64(v, &i) && i == json.i;
+  }
+  case UNSIGNED: {
+    uint64_t u;
+    return json_snapshot_uint64(v, &u) && u == json.u;
+  }
+  case BOOLEAN:
+    return json_snapshot_bool(v) == json.b;
+  case NIL:
+    return true;
+  }
+
+  return false;
+}
+
+static void check_snapshot(const char *text, JSON json) {
+  JSONBuffer buf = json_buffer_new(0);
+  CHECK(json_snapshot_write(&buf, json), "snapshot of %s not written", text);
+
+  // the buffer's memory comes from malloc, aligned enough for the image
+  JSONSnapshot snap = json_snapshot_load(buf.data, buf.len);
+  CHECK(snap.ok, "snapshot of %s does not load", text);
+  if (snap.ok) {
+    JSONSnapValue root = json_snapshot_root(&snap);
+    CHECK(snap_same(root, json), "snapshot of %s reads differently", text);
+
+    Arena *arena = arena_new(0);
+    JSON back = json_snapshot_value(root, arena);
+    CHECK(json_equal(back, json), "snapshot of %s rebuilds as %s", text,
+          test_text(back));
+    arena_free(arena);
+    json_snapshot_close(&snap);
+  }
+
+  const char *path = "build/test.snap";
+  CHECK(json_snapshot_save(json, path), "snapshot of %s not saved", text);
+  snap = json_snapshot_open(path);
+  CHECK(snap.ok && snap_same(json_snapshot_root(&snap), json),
+        "saved snapshot of %s reads differently", text);
+  json_snapshot_close(&snap);
+  remove(path);
+
+  // images cut short or of another version are rejected
+  if (buf.len > 8) {
+    snap = json_snapshot_load(buf.data, buf.len - 8);
+    CHECK(!snap.ok, "snapshot of %s cut short loads", text);
+    char saved = buf.data[4];
+    buf.data[4] ^= 0x55;
+    snap = json_snapshot_load(buf.data, buf.len);
+    CHECK(!snap.ok, "snapshot of %s with a bad header loads", text);
+    buf.data[4] = saved;
+  }
+
+  json_buffer_free(&buf);
+}
+
+// the same members added in another order, past and below
+// `HASHMAP_SMALL_MAX', give the same image with members in key order
+static void check_canonical(void) {
+  const char *forward = "{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,"
+                        "\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,"
+                        "\"k10\":{\"b\":1,\"a\":2,\"ab\":3}}";
+  const char *backward = "{\"k10\":{\"ab\":3,\"a\":2,\"b\":1},\"k9\":9,"
+                         "\"k8\":8,\"k7\":7,\"k6\":6,\"k5\":5,\"k4\":4,"
+                         "\"k3\":3,\"k2\":2,\"k1\":1,\"k0\":0}";
+  JSON a = test_parse(forward);
+  JSON b = test_parse(backward);
+  JSONBuffer buf_a = json_buffer_new(0);
+  JSONBuffer buf_b = json_buffer_new(0);
+  bool written =
+      json_snapshot_write(&buf_a, a) && json_snapshot_write(&buf_b, b);
+  CHECK(written && buf_a.len == buf_b.len &&
+            !memcmp(buf_a.data, buf_b.data, buf_a.len),
+        "members in another order give another image");
+
+  JSONSnapshot snap = json_snapshot_load(buf_a.data, buf_a.len);
+  JSONSnapValue root = json_snapshot_root(&snap);
+  const char *want[] = {"k0", "k1", "k10", "k2", "k3", "k4",
+                        "k5", "k6", "k7",  "k8", "k9"};
+  bool sorted = json_snapshot_len(root) == 11;
+  for (size_t i = 0; sorted && i < 11; i++) {
+    StringView key;
+    json_snapshot_member(root, i, &key);
+    sorted = key.len == strlen(want[i]) && !memcmp(key.str, want[i], key.len);
+  }
+  JSONSnapValue inner = json_snapshot_get(root, "k10");
+  StringView keys[3];
+  for (size_t i = 0; i < 3; i++) {
+    json_snapshot_member(inner, i, &keys[i]);
+  }
+  CHECK(sorted && keys[0].len == 1 && keys[0].str[0] == 'a' &&
+            keys[1].len == 2 && keys[2].len == 1 && keys[2].str[0] == 'b',
+        "members are not in key order");
+  json_snapshot_close(&snap);
+
+  json_buffer_free(&buf_a);
+  json_buffer_free(&buf_b);
+  json_free(a);
+  json_free(b);
+}
+
+void test_snapshot_suite(void) {
+  for (size_t i = 0; i < sizeof(DOCS) / sizeof(DOCS[0]); i++) {
+    JSON json = test_parse(DOCS[i]);
+    check_snapshot(DOCS[i], json);
+    json_free(json);
+  }
+  check_canonical();
+}
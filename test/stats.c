@@ -0,0 +1,120 @@
+// Counters of stats.h. The suite runs in both builds: `build/test_stats' has
+// them compiled in, and without `JSON_STATS' they must all read zero.
+#include "batch.h"
+#include "stats.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char DOC[] = "{\"a\": [1, 2.5, \"s\", true, null], \"b\": {}}";
+
+static JSONStats parse_stats(const char *text, size_t len) {
+  json_free(json_parse_n(text, len, NULL, 0));
+  return json_stats_last();
+}
+
+static bool same_tokens(const JSONStats *a, const JSONStats *b) {
+  return !memcmp(a->tokens, b->tokens, sizeof(a->tokens));
+}
+
+static void check_disabled(void) {
+  JSONStats s = parse_stats(DOC, strlen(DOC));
+  JSONStats zero = {0};
+  CHECK(!memcmp(&s, &zero, sizeof(s)), "counters without JSON_STATS");
+  s = json_stats_total();
+  CHECK(!memcmp(&s, &zero, sizeof(s)), "totals without JSON_STATS");
+}
+
+static void check_document(void) {
+  JSONStats s = parse_stats(DOC, strlen(DOC));
+  static const uint64_t TOKENS[JSON_STATS_TOKENS] = {
+      [TOK_BRACE_LEFT] = 2, [TOK_BRACE_RIGHT] = 2, [TOK_BRACKET_LEFT] = 1,
+      [TOK_BRACKET_RIGHT] = 1, [TOK_COLON] = 2, [TOK_COMMA] = 5,
+      [TOK_STRING] = 3, [TOK_NUMBER] = 1, [TOK_INTEGER] = 1,
+      [TOK_BOOLEAN] = 1, [TOK_NULL] = 1,
+  };
+  for (size_t i = 0; i < JSON_STATS_TOKENS; i++) {
+    CHECK(s.tokens[i] == TOKENS[i], "%llu tokens of type %zu, want %llu",
+          (unsigned long long)s.tokens[i], i,
+          (unsigned long long)TOKENS[i]);
+  }
+  CHECK(s.documents == 1 && s.bytes_scanned == strlen(DOC) &&
+            s.max_depth == 2 && s.maps == 2 && s.map_entries == 2,
+        "%llu documents, %llu bytes, depth %llu, %llu maps of %llu entries",
+        (unsigned long long)s.documents, (unsigned long long)s.bytes_scanned,
+        (unsigned long long)s.max_depth, (unsigned long long)s.maps,
+        (unsigned long long)s.map_entries);
+
+  // the totals add up every parse since the reset
+  json_stats_reset();
+  parse_stats(DOC, strlen(DOC));
+  parse_stats("[1]", 3);
+  JSONStats total = json_stats_total();
+  CHECK(total.documents == 2 && total.tokens[TOK_INTEGER] == 2 &&
+            total.bytes_scanned == strlen(DOC) + 3,
+        "totals of %llu documents", (unsigned long long)total.documents);
+}
+
+static void ignore(void *ctx, size_t index, JSON value) {}
+
+// the workers' counters end up in those of the whole batch
+static void check_many(void) {
+  const char *docs[] = {"{\"a\": [1, 2]}", "[\"b\", {\"c\": null}]", "3.5"};
+  JSONStats want = {0};
+  char text[128] = "";
+  for (size_t i = 0; i < 3; i++) {
+    JSONStats s = parse_stats(docs[i], strlen(docs[i]));
+    json_stats_merge(&want, &s);
+    strcat(text, docs[i]);
+    strcat(text, "\n");
+  }
+
+  for (size_t threads = 1; threads <= 4; threads *= 2) {
+    json_parse_many(text, strlen(text), threads, 0, ignore, NULL);
+    JSONStats s = json_stats_last();
+    CHECK(s.documents == 3 && same_tokens(&s, &want) &&
+              s.max_depth == want.max_depth,
+          "batch on %zu threads: %llu documents, %llu strings", threads,
+          (unsigned long long)s.documents,
+          (unsigned long long)s.tokens[TOK_STRING]);
+  }
+}
+
+static void check_parallel(void) {
+  size_t cap = JSON_PARALLEL_MIN + 64;
+  char *text = malloc(cap);
+  size_t len = 0;
+  text[len++] = '[';
+  for (size_t i = 0; len < JSON_PARALLEL_MIN; i++) {
+    len += (size_t)snprintf(text + len, cap - len, "%s[%zu,\"x\"]",
+                            i ? "," : "", i % 1000);
+  }
+  text[len++] = ']';
+
+  JSONStats want = parse_stats(text, len);
+  for (size_t threads = 2; threads <= 4; threads *= 2) {
+    Arena *arena = arena_new(0);
+    JSON json = json_parse_parallel(text, len, arena, 0, threads);
+    JSONStats s = json_stats_last();
+    CHECK(json.ok && s.documents == 1 && same_tokens(&s, &want) &&
+              s.bytes_scanned == want.bytes_scanned &&
+              s.max_depth == want.max_depth,
+          "parallel on %zu threads: %llu documents, %llu commas, want %llu",
+          threads, (unsigned long long)s.documents,
+          (unsigned long long)s.tokens[TOK_COMMA],
+          (unsigned long long)want.tokens[TOK_COMMA]);
+    arena_free(arena);
+  }
+  free(text);
+}
+
+void test_stats_suite(void) {
+  if (!JSON_STATS_ENABLED) {
+    check_disabled();
+    return;
+  }
+
+  check_document();
+  check_many();
+  check_parallel();
+}
@@ -0,0 +1,93 @@
+// The push parser at emit depths above 0, on concatenated documents and on
+// errors after the first document, fed whole and a byte at a time.
+#include "stream.h"
+#include "test.h"
+#include <string.h>
+
+typedef struct {
+  // "key=value" of every emitted value, separated by spaces
+  char seen[512];
+  size_t len;
+} Seen;
+
+static void collect(void *ctx, StringView key, JSON value) {
+  Seen *seen = ctx;
+  const char *text = test_text(value);
+  int n = snprintf(seen->seen + seen->len, sizeof(seen->seen) - seen->len,
+                   "%s%.*s=%s", seen->len ? " " : "", (int)key.len,
+                   key.str ? key.str : "", text);
+  if (n > 0) {
+    seen->len += (size_t)n;
+  }
+}
+
+// runs `text' at `depth' in chunks of `chunk' bytes, false on any error
+static bool run(const char *text, size_t depth, size_t chunk, Seen *seen,
+                JSONError *error) {
+  JSONStream *s = json_stream_new(depth, collect, seen);
+  size_t len = strlen(text);
+  bool ok = true;
+  for (size_t i = 0; ok && i < len; i += chunk) {
+    ok = json_stream_feed(s, text + i, len - i < chunk ? len - i : chunk);
+  }
+
+  ok = json_stream_finish(s) && ok;
+  *error = s->error;
+  json_stream_free(s);
+  return ok;
+}
+
+static void check(const char *text, size_t depth, const char *want) {
+  size_t chunks[] = {1, 2, 7, strlen(text) ? strlen(text) : 1};
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    Seen seen = {{0}, 0};
+    JSONError error;
+    bool ok = run(text, depth, chunks[i], &seen, &error);
+    CHECK(ok, "stream(%zu) rejects %s: %s at %zu", chunks[i], text,
+          json_error_string(error.code), error.offset);
+    CHECK(!strcmp(seen.seen, want), "stream(%zu) of %s emits %s, want %s",
+          chunks[i], text, seen.seen, want);
+  }
+}
+
+static void check_error(const char *text, size_t depth, JSONErrorCode code,
+                        size_t offset) {
+  for (size_t chunk = 1; chunk <= strlen(text); chunk *= 2) {
+    Seen seen = {{0}, 0};
+    JSONError error;
+    bool ok = run(text, depth, chunk, &seen, &error);
+    CHECK(!ok && error.code == code && error.offset == offset,
+          "stream(%zu) %s: %s at %zu, want %s at %zu", chunk, text,
+          json_error_string(error.code), error.offset, json_error_string(code),
+          offset);
+  }
+}
+
+void test_stream_suite(void) {
+  check("{\"a\": 1, \"b\": [true, null]}", 0,
+        "={\"a\":1,\"b\":[true,null]}");
+  check("{\"a\": 1, \"b\": [true, null]}", 1, "a=1 b=[true,null]");
+  // values above the emit depth are dropped
+  check("{\"a\": 1, \"b\": [true, null]}", 2, "=true =null");
+  check("[{\"k\": \"v\"}, 2, \"x\"]", 1, "={\"k\":\"v\"} =2 =\"x\"");
+  check("[[1, 2], [3]]", 2, "=1 =2 =3");
+  check("{\"a\\nb\": \"\\u00e9\"}", 1, "a\nb=\"\xc3\xa9\"");
+
+  // concatenated and newline-delimited documents
+  check("1 2 3", 0, "=1 =2 =3");
+  check("{\"a\":1}\n{\"a\":2}\n", 0, "={\"a\":1} ={\"a\":2}");
+  check("[1][2]\"s\"{}", 0, "=[1] =[2] =\"s\" ={}");
+  check("true false null", 0, "=true =false =null");
+  check("[1,2]\n[3]", 1, "=1 =2 =3");
+
+  // offsets count every byte fed, across documents
+  check_error("[1]\n[2,]", 0, JSON_ERROR_UNEXPECTED, 7);
+  check_error("{\"a\":1}{\"b\"}", 0, JSON_ERROR_UNEXPECTED, 11);
+  check_error("[1] [\"\\q\"]", 0, JSON_ERROR_ESCAPE, 6);
+  check_error("[1] [\"\xc3\"]", 0, JSON_ERROR_UTF8, 7);
+  check_error("[1] [tru]", 0, JSON_ERROR_SCALAR, 5);
+  check_error("{\"a\": [1, 2}", 1, JSON_ERROR_UNEXPECTED, 11);
+  check_error("[1, 2", 1, JSON_ERROR_EOF, 5);
+  check_error("[1] \"ab", 0, JSON_ERROR_UNTERMINATED_STRING, 4);
+  check_error("[1],", 0, JSON_ERROR_TRAILING, 3);
+}
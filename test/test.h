@@ -0,0 +1,35 @@
+#include "json.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifndef TEST_H
+#define TEST_H
+
+extern size_t test_checks;
+extern size_t test_failures;
+
+// records a check, printing `fmt' and where it was made when it failed
+void test_check(bool ok, const char *file, int line, const char *fmt, ...);
+
+#define CHECK(cond, ...) test_check((cond), __FILE__, __LINE__, __VA_ARGS__)
+
+// parses `text', which must be valid, without an arena
+JSON test_parse(const char *text);
+
+// compact text of `json', in a buffer that is reused by the next call
+const char *test_text(JSON json);
+
+void test_stream_suite(void);
+void test_batch_suite(void);
+void test_file_suite(void);
+void test_query_suite(void);
+void test_parse_suite(void);
+void test_parser_suite(void);
+void test_bind_suite(void);
+void test_snapshot_suite(void);
+void test_parallel_suite(void);
+void test_stats_suite(void);
+void test_frozen_suite(void);
+void test_patch_suite(void);
+
+#endif
@@ -0,0 +1,83 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifndef THREAD_H
+#define THREAD_H
+
+typedef void (*ThreadFn)(void *arg);
+
+typedef struct {
+  ThreadFn fn;
+  void *arg;
+} ThreadStart;
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE Thread;
+
+static DWORD WINAPI thread_trampoline(LPVOID data) {
+  ThreadStart start = *(ThreadStart *)data;
+  free(data);
+  start.fn(start.arg);
+  return 0;
+}
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t Thread;
+
+static void *thread_trampoline(void *data) {
+  ThreadStart start = *(ThreadStart *)data;
+  free(data);
+  start.fn(start.arg);
+  return NULL;
+}
+#endif
+
+static inline bool thread_start(Thread *thread, ThreadFn fn, void *arg) {
+  ThreadStart *start = malloc(sizeof(ThreadStart));
+  if (!start) {
+    return false;
+  }
+
+  start->fn = fn;
+  start->arg = arg;
+
+#ifdef _WIN32
+  *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+  if (*thread == NULL) {
+#else
+  if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+#endif
+    free(start);
+    return false;
+  }
+
+  return true;
+}
+
+static inline void thread_join(Thread thread) {
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+// number of online CPUs, at least 1
+static inline size_t thread_cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (size_t)n : 1;
+#endif
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "file.h"
+#include "snapshot.h"
+#include "stringify.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Converts between JSON text and snapshots:
+ *
+ *   json_snapshot pack <in.json> <out.snap>
+ *   json_snapshot unpack <in.snap> [out.json]
+ *
+ * `unpack' writes to standard output when no output file is given.
+ */
+
+static int pack(const char *in, const char *out) {
+  JSONFile file = json_parse_file(in);
+  if (!file.json.ok) {
+    JSONError error = json_last_error();
+    fprintf(stderr, "[ERROR]: Could not parse %s: %s at offset %zu\n", in,
+            json_error_string(error.code), error.offset);
+    json_file_close(&file);
+    return 1;
+  }
+
+  bool ok = json_snapshot_save(file.json, out);
+  json_file_close(&file);
+  if (!ok) {
+    fprintf(stderr, "[ERROR]: Could not write %s\n", out);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int unpack(const char *in, const char *out) {
+  JSONSnapshot snap = json_snapshot_open(in);
+  if (!snap.ok) {
+    fprintf(stderr, "[ERROR]: %s is no snapshot\n", in);
+    return 1;
+  }
+
+  Arena *arena = arena_new(0);
+  JSON json = arena ? json_snapshot_value(json_snapshot_root(&snap), arena)
+                    : (JSON){.ok = false};
+  if (!json.ok) {
+    fprintf(stderr, "[ERROR]: %s is damaged\n", in);
+    arena_free(arena);
+    json_snapshot_close(&snap);
+    return 1;
+  }
+
+  FILE *f = out ? fopen(out, "w") : stdout;
+  bool ok = f != NULL;
+  if (ok) {
+    JSONBuffer buf = json_buffer_fd(fileno(f), 0);
+    ok = json_stringify(&buf, json, 0) && json_buffer_write(&buf, "\n", 1) &&
+         json_buffer_flush(&buf);
+    json_buffer_free(&buf);
+  }
+  if (out && f && fclose(f) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "[ERROR]: Could not write %s\n", out ? out : "output");
+  }
+
+  arena_free(arena);
+  json_snapshot_close(&snap);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 4 && strcmp(argv[1], "pack") == 0) {
+    return pack(argv[2], argv[3]);
+  }
+  if ((argc == 3 || argc == 4) && strcmp(argv[1], "unpack") == 0) {
+    return unpack(argv[2], argc == 4 ? argv[3] : NULL);
+  }
+
+  fprintf(stderr, "usage: %s pack <in.json> <out.snap>\n"
+                  "       %s unpack <in.snap> [out.json]\n",
+          argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,246 @@
+#include "validate.h"
+#include "number.h"
+
+const char *json_error_string(JSONErrorCode code) {
+  switch (code) {
+  case JSON_OK:
+    return "no error";
+  case JSON_ERROR_EOF:
+    return "unexpected end of input";
+  case JSON_ERROR_UTF8:
+    return "invalid UTF-8";
+  case JSON_ERROR_CONTROL:
+    return "unescaped control character in string";
+  case JSON_ERROR_ESCAPE:
+    return "invalid escape sequence";
+  case JSON_ERROR_UNTERMINATED_STRING:
+    return "unterminated string";
+  case JSON_ERROR_SCALAR:
+    return "invalid number or literal";
+  case JSON_ERROR_UNEXPECTED:
+    return "unexpected token";
+  case JSON_ERROR_TRAILING:
+    return "trailing characters after the document";
+  case JSON_ERROR_DEPTH:
+    return "nesting too deep";
+  case JSON_ERROR_TOO_LARGE:
+    return "document too large";
+  case JSON_ERROR_MEMORY:
+    return "out of memory";
+  case JSON_ERROR_TYPE:
+    return "value does not match the schema";
+  case JSON_ERROR_PATCH:
+    return "invalid patch operation";
+  case JSON_ERROR_PATH:
+    return "patch path not found";
+  case JSON_ERROR_TEST:
+    return "patch test failed";
+  case JSON_ERROR_IO:
+    return "cannot read file";
+  }
+
+  return "unknown error";
+}
+
+static inline bool validate_fail(Validator *v, JSONErrorCode code,
+                                 size_t offset) {
+  v->error = (JSONError){code, offset};
+  return false;
+}
+
+// index entries by their first byte
+enum {
+  CLASS_SCALAR,
+  CLASS_STRING,
+  CLASS_OBJECT_OPEN,
+  CLASS_ARRAY_OPEN,
+  CLASS_OBJECT_CLOSE,
+  CLASS_ARRAY_CLOSE,
+  CLASS_COLON,
+  CLASS_COMMA,
+  CLASSES
+};
+
+static const uint8_t CLASS[256] = {
+    ['"'] = CLASS_STRING,      ['{'] = CLASS_OBJECT_OPEN,
+    ['['] = CLASS_ARRAY_OPEN,  ['}'] = CLASS_OBJECT_CLOSE,
+    [']'] = CLASS_ARRAY_CLOSE, [':'] = CLASS_COLON,
+    [','] = CLASS_COMMA,
+};
+
+// transitions that are not plain states
+enum {
+  STEP_ERROR = 0,
+  STEP_OPEN_OBJECT = VALIDATE_STATES,
+  STEP_OPEN_ARRAY,
+  STEP_CLOSE,
+};
+
+#define VALUE_STEPS(after)                                                    \
+  [CLASS_SCALAR] = after, [CLASS_STRING] = after,                             \
+  [CLASS_OBJECT_OPEN] = STEP_OPEN_OBJECT, [CLASS_ARRAY_OPEN] = STEP_OPEN_ARRAY
+
+// next state by the current one and the class of the entry, `STEP_ERROR'
+// anywhere the grammar does not allow the entry
+static const uint8_t STEPS[VALIDATE_STATES][CLASSES] = {
+    [VALIDATE_ROOT] = {VALUE_STEPS(VALIDATE_END)},
+    [VALIDATE_ARRAY_FIRST] = {VALUE_STEPS(VALIDATE_ARRAY_NEXT),
+                              [CLASS_ARRAY_CLOSE] = STEP_CLOSE},
+    [VALIDATE_ARRAY_VALUE] = {VALUE_STEPS(VALIDATE_ARRAY_NEXT)},
+    [VALIDATE_ARRAY_NEXT] = {[CLASS_COMMA] = VALIDATE_ARRAY_VALUE,
+                             [CLASS_ARRAY_CLOSE] = STEP_CLOSE},
+    [VALIDATE_OBJECT_FIRST] = {[CLASS_STRING] = VALIDATE_OBJECT_COLON,
+                               [CLASS_OBJECT_CLOSE] = STEP_CLOSE},
+    [VALIDATE_OBJECT_KEY] = {[CLASS_STRING] = VALIDATE_OBJECT_COLON},
+    [VALIDATE_OBJECT_COLON] = {[CLASS_COLON] = VALIDATE_OBJECT_VALUE},
+    [VALIDATE_OBJECT_VALUE] = {VALUE_STEPS(VALIDATE_OBJECT_NEXT)},
+    [VALIDATE_OBJECT_NEXT] = {[CLASS_COMMA] = VALIDATE_OBJECT_KEY,
+                              [CLASS_OBJECT_CLOSE] = STEP_CLOSE},
+};
+
+// state after a value that starts in each state
+static const uint8_t AFTER[VALIDATE_STATES] = {
+    [VALIDATE_ROOT] = VALIDATE_END,
+    [VALIDATE_ARRAY_FIRST] = VALIDATE_ARRAY_NEXT,
+    [VALIDATE_ARRAY_VALUE] = VALIDATE_ARRAY_NEXT,
+    [VALIDATE_OBJECT_VALUE] = VALIDATE_OBJECT_NEXT,
+};
+
+static inline bool is_delimiter(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' ||
+         (CLASS[(uint8_t)c] != CLASS_SCALAR);
+}
+
+// a literal or number at `start', which has to run up to a delimiter. Anything
+// after it would be an entry of its own. Numbers are not converted
+static bool validate_scalar(Validator *v, size_t start) {
+  const char *s = v->source + start;
+  size_t rest = v->len - start;
+  size_t len;
+  switch (*s) {
+  case 't':
+    len = rest >= 4 && !memcmp(s, "true", 4) ? 4 : 0;
+    break;
+  case 'f':
+    len = rest >= 5 && !memcmp(s, "false", 5) ? 5 : 0;
+    break;
+  case 'n':
+    len = rest >= 4 && !memcmp(s, "null", 4) ? 4 : 0;
+    break;
+  default:
+    len = number_length(s, rest);
+    break;
+  }
+
+  if (len == 0 || (len < rest && !is_delimiter(s[len]))) {
+    return validate_fail(v, JSON_ERROR_SCALAR, start);
+  }
+
+  return true;
+}
+
+// feeds the entry `first', its first byte, at `pos' through the state and
+// depth kept by the caller, so they can stay in registers
+static inline bool validate_step(Validator *v, uint8_t *state, size_t *depth,
+                                 char first, size_t pos) {
+  uint8_t c = CLASS[(uint8_t)first];
+  uint8_t next = STEPS[*state][c];
+  if (next >= VALIDATE_ROOT && next < VALIDATE_STATES) {
+    if (c == CLASS_SCALAR && v->check_scalars && !validate_scalar(v, pos)) {
+      return false;
+    }
+    *state = next;
+    return true;
+  }
+
+  switch (next) {
+  case STEP_OPEN_OBJECT:
+  case STEP_OPEN_ARRAY:
+    if (*depth == v->max_depth) {
+      return validate_fail(v, JSON_ERROR_DEPTH, pos);
+    }
+    v->stack[(*depth)++] = AFTER[*state];
+    *state = next == STEP_OPEN_OBJECT ? VALIDATE_OBJECT_FIRST
+                                      : VALIDATE_ARRAY_FIRST;
+    return true;
+  case STEP_CLOSE:
+    *state = v->stack[--*depth];
+    return true;
+  default:
+    return validate_fail(v,
+                         *state == VALIDATE_END ? JSON_ERROR_TRAILING
+                                                : JSON_ERROR_UNEXPECTED,
+                         pos);
+  }
+}
+
+void validate_begin(Validator *v, const char *source, size_t len,
+                    bool check_scalars) {
+  v->source = source;
+  v->len = len;
+  v->state = VALIDATE_ROOT;
+  v->depth = 0;
+  v->max_depth = JSON_MAX_DEPTH;
+  v->check_scalars = check_scalars;
+  v->error = (JSONError){JSON_OK, 0};
+}
+
+bool validate_index(Validator *v, const uint32_t *positions, size_t from,
+                    size_t to) {
+  uint8_t state = v->state;
+  size_t depth = v->depth;
+  bool ok = true;
+  for (size_t i = from; ok && i < to; i++) {
+    size_t pos = positions[i];
+    ok = validate_step(v, &state, &depth, v->source[pos], pos);
+  }
+
+  v->state = state;
+  v->depth = depth;
+  return ok;
+}
+
+bool validate_token(Validator *v, char first, size_t offset) {
+  uint8_t state = v->state;
+  bool ok = validate_step(v, &state, &v->depth, first, offset);
+  v->state = state;
+  return ok;
+}
+
+bool validate_end(Validator *v) {
+  if (v->state != VALIDATE_END) {
+    return validate_fail(v, JSON_ERROR_EOF, v->len);
+  }
+
+  return true;
+}
+
+static bool validate_block(void *ctx, size_t base, uint64_t bits) {
+  Validator *v = ctx;
+  uint8_t state = v->state;
+  size_t depth = v->depth;
+  bool ok = true;
+  for (; ok && bits; bits &= bits - 1) {
+    size_t pos = base + __builtin_ctzll(bits);
+    ok = validate_step(v, &state, &depth, v->source[pos], pos);
+  }
+
+  v->state = state;
+  v->depth = depth;
+  return ok;
+}
+
+JSONError json_validate(const char *source, size_t len) {
+  Validator v;
+  validate_begin(&v, source, len, true);
+
+  JSONError error = scanner_each(source, len, validate_block, &v);
+  if (error.code != JSON_OK) {
+    return error;
+  }
+  if (v.error.code == JSON_OK) {
+    validate_end(&v);
+  }
+
+  return v.error;
+}
@@ -0,0 +1,70 @@
+#include "json.h"
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+// what the grammar allows next. 0 is left for errors in the transition table
+typedef enum {
+  VALIDATE_ROOT = 1,
+  // after `['
+  VALIDATE_ARRAY_FIRST,
+  // after `,' in an array
+  VALIDATE_ARRAY_VALUE,
+  VALIDATE_ARRAY_NEXT,
+  // after `{'
+  VALIDATE_OBJECT_FIRST,
+  // after `,' in an object
+  VALIDATE_OBJECT_KEY,
+  VALIDATE_OBJECT_COLON,
+  VALIDATE_OBJECT_VALUE,
+  VALIDATE_OBJECT_NEXT,
+  // the root value is complete
+  VALIDATE_END,
+  VALIDATE_STATES
+} ValidateState;
+
+/**
+ * RFC 8259 grammar checker fed one index entry at a time. The scanner already
+ * rejects bad strings, what is left is the order of the entries and, when
+ * asked to, the bare words.
+ */
+typedef struct {
+  const char *source;
+  size_t len;
+  ValidateState state;
+  size_t depth;
+  // `JSON_MAX_DEPTH' unless lowered after `validate_begin'
+  size_t max_depth;
+  // the state to return to when each open container closes
+  uint8_t stack[JSON_MAX_DEPTH];
+  // bare words are checked to be numbers or literals. The parser leaves it
+  // unset, since it scans them anyway
+  bool check_scalars;
+  JSONError error;
+} Validator;
+
+void validate_begin(Validator *v, const char *source, size_t len,
+                    bool check_scalars);
+
+// feeds entries `from' up to `to' of `positions', false at the first error
+bool validate_index(Validator *v, const uint32_t *positions, size_t from,
+                    size_t to);
+
+/**
+ * Feeds one token by its first byte, for parsers that see tokens instead of
+ * an index. `offset' is where an error is reported. Begin `v' without
+ * `check_scalars', bare words are left to the caller.
+ */
+bool validate_token(Validator *v, char first, size_t offset);
+
+// checks that the document is complete, false with `v->error' set if not
+bool validate_end(Validator *v);
+
+/**
+ * Checks that the `len' bytes at `source' are exactly one JSON value, with
+ * valid UTF-8, strings, escapes, numbers and literals, without allocating
+ * anything or building any tree. Returns `JSON_OK' or the first error.
+ */
+JSONError json_validate(const char *source, size_t len);
+
+#endif
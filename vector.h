@@ -1,3 +1,4 @@
+#include "arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -8,54 +9,86 @@
   struct Vector##Name {                                                        \
     size_t len;                                                                \
     size_t cap;                                                                \
+    Arena *arena;                                                              \
     type *items;                                                               \
   };                                                                           \
                                                                                \
-  struct Vector##Name *vector_##name##_new() {                                 \
-    struct Vector##Name *v = malloc(sizeof(struct Vector##Name));              \
+  static inline struct Vector##Name *vector_##name##_new_in(Arena *arena) {    \
+    struct Vector##Name *v = mem_alloc(arena, sizeof(struct Vector##Name));    \
     if (!v) {                                                                  \
       return NULL;                                                             \
     }                                                                          \
                                                                                \
     v->len = 0;                                                                \
     v->cap = 32;                                                               \
-    v->items = calloc(v->cap, sizeof(type));                                   \
+    v->arena = arena;                                                          \
+    v->items = mem_calloc(arena, v->cap, sizeof(type));                        \
     if (!v->items) {                                                           \
-      free(v);                                                                 \
+      mem_free(arena, v);                                                      \
       return NULL;                                                             \
     }                                                                          \
                                                                                \
     return v;                                                                  \
   }                                                                            \
                                                                                \
+  static inline struct Vector##Name *vector_##name##_new() {                   \
+    return vector_##name##_new_in(NULL);                                       \
+  }                                                                            \
+                                                                               \
   static inline void vector_##name##_free(struct Vector##Name *v) {            \
-    if (v) {                                                                   \
-      void (*free_fn)(type) = free_func;                                       \
-      if (free_fn) {                                                           \
-        for (size_t i = 0; i < v->len; i++) {                                  \
-          free_fn(v->items[i]);                                                \
-        }                                                                      \
+    if (!v) {                                                                  \
+      return;                                                                  \
+    }                                                                          \
+                                                                               \
+    void (*free_fn)(type) = free_func;                                         \
+    if (free_fn) {                                                             \
+      for (size_t i = 0; i < v->len; i++) {                                    \
+        free_fn(v->items[i]);                                                  \
       }                                                                        \
     }                                                                          \
                                                                                \
-    free(v->items);                                                            \
-    free(v);                                                                   \
+    mem_free(v->arena, v->items);                                              \
+    mem_free(v->arena, v);                                                     \
   }                                                                            \
                                                                                \
   static inline void vector_##name##_push(struct Vector##Name *v,              \
                                           type value) {                        \
     if (v->len >= v->cap) {                                                    \
-      v->cap *= 2;                                                             \
-      type *new_items = realloc(v->items, sizeof(type) * v->cap);              \
+      size_t new_cap = v->cap * 2;                                             \
+      type *new_items = mem_realloc(v->arena, v->items, sizeof(type) * v->cap, \
+                                    sizeof(type) * new_cap);                   \
       if (!new_items) {                                                        \
         return;                                                                \
       }                                                                        \
       v->items = new_items;                                                    \
+      v->cap = new_cap;                                                        \
+      JSON_STATS_ADD(vector_resizes, 1);                                       \
     }                                                                          \
                                                                                \
     v->items[v->len++] = value;                                                \
   }                                                                            \
                                                                                \
+  /* a copy of `v' in `arena' holding the same items */                        \
+  static inline struct Vector##Name *vector_##name##_clone(                    \
+      struct Vector##Name *v, Arena *arena) {                                  \
+    struct Vector##Name *copy = mem_alloc(arena, sizeof(struct Vector##Name)); \
+    if (!copy) {                                                               \
+      return NULL;                                                             \
+    }                                                                          \
+                                                                               \
+    copy->len = v->len;                                                        \
+    copy->cap = v->len ? v->len : 1;                                           \
+    copy->arena = arena;                                                       \
+    copy->items = mem_alloc(arena, copy->cap * sizeof(type));                  \
+    if (!copy->items) {                                                        \
+      mem_free(arena, copy);                                                   \
+      return NULL;                                                             \
+    }                                                                          \
+                                                                               \
+    memcpy(copy->items, v->items, v->len * sizeof(type));                      \
+    return copy;                                                               \
+  }                                                                            \
+                                                                               \
   static inline type *vector_##name##_pop(struct Vector##Name *v) {            \
     if (v->len == 0) {                                                         \
       return NULL;                                                             \
@@ -64,18 +97,62 @@
     return &v->items[--v->len];                                                \
   }                                                                            \
                                                                                \
-  static inline type vector_##name##_at(struct Vector##Name *v,                \
-                                        size_t index) {                        \
-    if (index > v->len - 1) {                                                  \
-      return v->items[v->len - 1];                                             \
+  /* inserts `value' before element `index', or at the end when it is `len'.   \
+   * Returns false when out of range or memory */                              \
+  static inline bool vector_##name##_insert(struct Vector##Name *v,            \
+                                            size_t index, type value) {        \
+    size_t len = v->len;                                                       \
+    if (index > len) {                                                         \
+      return false;                                                            \
     }                                                                          \
                                                                                \
-    if (index >= 0) {                                                          \
-      return v->items[index];                                                  \
+    vector_##name##_push(v, value);                                            \
+    if (v->len == len) {                                                       \
+      return false;                                                            \
     }                                                                          \
                                                                                \
-    size_t _index = v->len - index - 1;                                        \
-    return v->items[_index < 0 ? 0 : _index];                                  \
+    memmove(&v->items[index + 1], &v->items[index],                            \
+            (len - index) * sizeof(type));                                     \
+    v->items[index] = value;                                                   \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* takes element `index' out, into `out' if set */                           \
+  static inline bool vector_##name##_remove(struct Vector##Name *v,            \
+                                            size_t index, type *out) {         \
+    if (index >= v->len) {                                                     \
+      return false;                                                            \
+    }                                                                          \
+                                                                               \
+    if (out) {                                                                 \
+      *out = v->items[index];                                                  \
+    }                                                                          \
+    v->len--;                                                                  \
+    memmove(&v->items[index], &v->items[index + 1],                            \
+            (v->len - index) * sizeof(type));                                  \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* element `index', counted from the end when negative. NULL when it is      \
+   * out of range */                                                           \
+  static inline type *vector_##name##_find(struct Vector##Name *v,             \
+                                           ptrdiff_t index) {                  \
+    if (index < 0) {                                                           \
+      index += (ptrdiff_t)v->len;                                              \
+    }                                                                          \
+                                                                               \
+    if (index < 0 || (size_t)index >= v->len) {                                \
+      return NULL;                                                             \
+    }                                                                          \
+                                                                               \
+    return &v->items[index];                                                   \
+  }                                                                            \
+                                                                               \
+  /* an index out of range returns a zeroed value */                           \
+  static inline type vector_##name##_at(struct Vector##Name *v,                \
+                                        ptrdiff_t index) {                     \
+    type *item = vector_##name##_find(v, index);                               \
+    return item ? *item : (type){0};                                           \
   }                                                                            \
                                                                                \
   static inline void vector_##name##_print(                                    \